@@ -0,0 +1,78 @@
+%
+% This program is free software: you can redistribute it and/or modify
+% it under the terms of the GNU General Public License as published by
+% the Free Software Foundation, either version 3 of the License, or
+% (at your option) any later version.
+% 
+% This program is distributed in the hope that it will be useful,
+% but WITHOUT ANY WARRANTY; without even the implied warranty of
+% MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+% GNU General Public License for more details.
+% 
+% You should have received a copy of the GNU General Public License
+% along with this program.  If not, see <http://www.gnu.org/licenses/>.
+%
+
+% Assembles a file striped across several drives (--stripe_kib) from its parts, see record/file_writer.h.
+% <file>.idx holds "n_bytes N", "stripe_bytes N", "n_parts N", then one line "stripe offset length part_path part_offset" per stripe.
+% Parts are looked up at the path the recorder wrote them to, then next to the index.
+function assemble_stripes(idx_filepath, out_filepath)
+
+    fi = fopen(idx_filepath, 'r');
+    if fi < 0
+        error('Cannot open %s.', idx_filepath);
+    end
+    n_bytes = sscanf(fgetl(fi), 'n_bytes %lu');
+    fgetl(fi);
+    fgetl(fi);
+    
+    [idx_folder, ~, ~] = fileparts(idx_filepath);
+    
+    fo = fopen(out_filepath, 'wb');
+    if fo < 0
+        fclose(fi);
+        error('Cannot create %s.', out_filepath);
+    end
+    
+    n_bytes_assembled = 0;
+    line = fgetl(fi);
+    while ischar(line)
+        if ~isempty(line)
+            % the path may contain spaces, the part offset is the last field
+            [stripe, rest] = strtok(line);
+            [offset, rest] = strtok(rest);
+            [len, rest] = strtok(rest);
+            rest = strtrim(rest);
+            last = find(rest == ' ', 1, 'last');
+            part_path = rest(1:last-1);
+            part_offset = str2double(rest(last+1:end));
+            offset = str2double(offset);
+            len = str2double(len);
+            
+            fp = fopen(part_path, 'rb');
+            if fp < 0
+                [~, part_name, part_ext] = fileparts(part_path);
+                fp = fopen(fullfile(idx_folder, [part_name, part_ext]), 'rb');
+            end
+            if fp < 0
+                fclose(fi);
+                fclose(fo);
+                error('Cannot open stripe %s of %s.', stripe, part_path);
+            end
+            fseek(fp, part_offset, 'bof');
+            data = fread(fp, len, 'uint8=>uint8');
+            fclose(fp);
+            
+            fseek(fo, offset, 'bof');
+            fwrite(fo, data, 'uint8');
+            n_bytes_assembled = n_bytes_assembled + numel(data);
+        end
+        line = fgetl(fi);
+    end
+    fclose(fi);
+    fclose(fo);
+    
+    if n_bytes_assembled ~= n_bytes
+        error('Stripes of %s cover %d of %d bytes.', idx_filepath, n_bytes_assembled, n_bytes);
+    end
+end
@@ -28,4 +28,7 @@ function [filenames, seq_file] = get_all_filenames(folderpath)
     % separate seq file
     seq_file = filenames(end);
     filenames(end) = [];
+    
+    % parts of striped files are read through their <file>.idx
+    filenames(~cellfun(@isempty, regexp({filenames.name}, '\.part\d+$'))) = [];
 end
\ No newline at end of file
@@ -26,6 +26,10 @@ classdef measurement_file
         
         sys_param_cpy
         
+        % parsed file header, empty for raw files without header
+        header
+        index
+        
         complex_samples
     end
     
@@ -41,29 +45,192 @@ classdef measurement_file
             
             obj.full_filepath = strcat(obj.folder,"/",obj.name);
             
+            % striped file, assembled once into a temporary file which is then read like any other
+            if endsWith(obj.name, '.idx')
+                obj.name = extractBefore(obj.name, strlength(obj.name) - 3);
+                idx_filepath = obj.full_filepath;
+                obj.full_filepath = string(tempname) + "_" + obj.name;
+                lib_data_usrp.assemble_stripes(char(idx_filepath), char(obj.full_filepath));
+                d = dir(obj.full_filepath);
+                obj.bytes = d.bytes;
+            end
+            
             obj.sys_param_cpy = sys_param;
             
+            [obj.header, obj.index] = lib_data_usrp.measurement_file.read_header(obj.full_filepath);
+            
             obj.complex_samples = obj.read_samples();
         end
         
         function complex_samples = read_samples(obj)
-            complex_samples = lib_data_usrp.read_complex_binary(obj.full_filepath, obj.sys_param_cpy.data_type, 0, 0);
             
-            % channels are concatenated
-            n_complex_samples = numel(complex_samples);
-            n_complex_samples_per_channel = n_complex_samples/obj.sys_param_cpy.n_rx_channels;
-            
-            % separate into channels
-            complex_samples = reshape(complex_samples, n_complex_samples_per_channel, obj.sys_param_cpy.n_rx_channels);
+            % raw file, channels are concatenated
+            if isempty(obj.header)
+                complex_samples = lib_data_usrp.read_complex_binary(obj.full_filepath, obj.sys_param_cpy.data_type, 0, 0);
+                
+                n_complex_samples = numel(complex_samples);
+                n_complex_samples_per_channel = n_complex_samples/obj.sys_param_cpy.n_rx_channels;
+                
+                % separate into channels
+                complex_samples = reshape(complex_samples, n_complex_samples_per_channel, obj.sys_param_cpy.n_rx_channels);
+            % file with header, each channel is padded
+            else
+                h = obj.header;
+                n_complex_samples_per_channel = h.n_measurements*h.measurement_length;
+                complex_samples = zeros(n_complex_samples_per_channel, h.n_channels);
+                for ch=1:1:h.n_channels
+                    f = fopen(obj.full_filepath, 'rb');
+                    fseek(f, h.header_bytes + (ch-1)*h.channel_stride, 'bof');
+                    t = fread(f, [2, n_complex_samples_per_channel], h.matlab_type);
+                    fclose(f);
+                    complex_samples(:,ch) = (t(1,:) + t(2,:)*1i).';
+                end
+            end
             
-            % sanity check
-            len = obj.sys_param_cpy.ch_measurement_per_sec;
-            len = len * obj.sys_param_cpy.ch_measurement_len;
-            len = len * obj.sys_param_cpy.ch_measurement_save_period_sec;
+            % sanity check, the schedule is set at runtime and recorded in the header
+            if isempty(obj.header)
+                len = obj.sys_param_cpy.ch_measurement_per_sec;
+                len = len * obj.sys_param_cpy.ch_measurement_len;
+                len = len * obj.sys_param_cpy.ch_measurement_save_period_sec;
+            else
+                if obj.header.measurement_length ~= obj.sys_param_cpy.ch_measurement_len || obj.header.measurements_per_sec ~= obj.sys_param_cpy.ch_measurement_per_sec
+                    warning('sys_param schedule differs from file header, using file header.');
+                end
+                len = obj.header.measurements_per_sec;
+                len = len * obj.header.measurement_length;
+                len = len * obj.header.save_period_sec;
+            end
             if len ~= numel(complex_samples(:,1))
                 error('Incorrect number of samples per channel per saved file.');
             end 
         end
+        
+        % random access to measurement k (1-based) of channel ch (1-based), only this measurement is read from disk
+        function complex_samples = read_measurement(obj, k, ch)
+            if isempty(obj.header)
+                error('Random access needs a file with header.');
+            end
+            h = obj.header;
+            f = fopen(obj.full_filepath, 'rb');
+            fseek(f, obj.index.offset(k) + (ch-1)*h.channel_stride, 'bof');
+            t = fread(f, [2, h.measurement_length], h.matlab_type);
+            fclose(f);
+            complex_samples = (t(1,:) + t(2,:)*1i).';
+        end
+    end
+    
+    methods(Static)
+        % layout see record/ch_measurement_format.h
+        function [header, index] = read_header(full_filepath)
+            header = [];
+            index = [];
+            
+            f = fopen(full_filepath, 'rb');
+            if f < 0
+                error('ERROR: Cannot read file with path: %s', full_filepath);
+            end
+            
+            magic = fread(f, [1, 8], 'uint8=>char');
+            if ~strcmp(deblank(magic), 'CHSOUND')
+                fclose(f);
+                return;
+            end
+            
+            header.version              = fread(f, 1, 'uint32');
+            header.header_bytes         = fread(f, 1, 'uint32');
+            header.index_offset         = fread(f, 1, 'uint64');
+            header.file_bytes           = fread(f, 1, 'uint64');
+            header.n_channels           = fread(f, 1, 'uint32');
+            header.n_bytes_per_item     = fread(f, 1, 'uint32');
+            header.data_type            = deblank(fread(f, [1, 8], 'uint8=>char'));
+            header.samp_rate            = fread(f, 1, 'uint64');
+            header.n_samples_per_period = fread(f, 1, 'uint32');
+            header.measurement_length   = fread(f, 1, 'uint32');
+            header.measurements_per_sec = fread(f, 1, 'uint32');
+            header.save_period_sec      = fread(f, 1, 'uint32');
+            header.n_measurements       = fread(f, 1, 'uint64');
+            header.channel_stride       = fread(f, 1, 'uint64');
+            header.file_number          = fread(f, 1, 'uint64');
+            header.first_measurement    = fread(f, 1, 'uint64');
+            header.first_tick           = fread(f, 1, 'int64');
+            header.first_time_full_secs = fread(f, 1, 'int64');
+            header.first_time_frac_secs = fread(f, 1, 'double');
+            header.stream_start_tick    = fread(f, 1, 'int64');
+            header.host_time_ns         = fread(f, 1, 'int64');
+            header.seq_name             = deblank(fread(f, [1, 32], 'uint8=>char'));
+            header.seq_length           = fread(f, 1, 'uint64');
+            header.seq_checksum         = fread(f, 1, 'uint64=>uint64');
+            header.storage_format       = 0;
+            header.storage_scale        = 1;
+            if header.version >= 3
+                header.file_prefix      = deblank(fread(f, [1, 48], 'uint8=>char'));
+                header.storage_format   = fread(f, 1, 'uint32');
+                header.storage_scale    = fread(f, 1, 'single');
+            else
+                header.file_prefix      = deblank(fread(f, [1, 56], 'uint8=>char'));
+            end
+            header.codec                = 0;
+            header.codec_param          = 0;
+            if header.version >= 2
+                header.codec            = fread(f, 1, 'uint32');
+                header.codec_param      = fread(f, 1, 'uint32');
+            end
+            header.content              = 0;
+            if header.version >= 4
+                header.content          = fread(f, 1, 'uint32');
+                header.n_tx_channels    = fread(f, 1, 'uint32');
+                header.cir_taps         = fread(f, 1, 'uint32');
+                header.cir_tap_offset   = fread(f, 1, 'int32');
+            end
+            header.gate                 = 0;
+            if header.version >= 5
+                header.gate             = fread(f, 1, 'uint32');
+                header.gate_threshold_db = fread(f, 1, 'single');
+                header.gate_pre         = fread(f, 1, 'uint32');
+                header.gate_post        = fread(f, 1, 'uint32');
+            end
+            header.n_average            = 1;
+            if header.version >= 6
+                header.n_average        = fread(f, 1, 'uint32');
+            end
+            
+            if header.version > 6
+                fclose(f);
+                error('Unknown file version %d.', header.version);
+            end
+            if header.codec ~= 0
+                fclose(f);
+                error('Compressed file, decode with record/ch_measurement_reader.h first.');
+            end
+            if header.content ~= 0
+                fclose(f);
+                error('File contains channel impulse responses, read with record/ch_measurement_reader.h.');
+            end
+            if header.storage_format ~= 0
+                fclose(f);
+                error('File stored as %s, decode with record/ch_measurement_reader.h first.', header.data_type);
+            end
+            
+            switch header.data_type
+                case 'sc16'
+                    header.matlab_type = 'int16';
+                otherwise
+                    header.matlab_type = 'float';
+            end
+            
+            % index entries: tick, offset, n_bytes, flags
+            fseek(f, header.index_offset, 'bof');
+            index.tick = fread(f, header.n_measurements, 'int64', 16);
+            fseek(f, header.index_offset + 8, 'bof');
+            index.offset = fread(f, header.n_measurements, 'uint64', 16);
+            fseek(f, header.index_offset + 16, 'bof');
+            index.n_bytes = fread(f, header.n_measurements, 'uint32', 20);
+            fseek(f, header.index_offset + 20, 'bof');
+            flags = fread(f, header.n_measurements, 'uint32', 20);
+            index.complete = bitand(flags, 1) == 1;
+            index.discarded = bitand(flags, 2) == 2;     % not saved by the window gate, samples are zero
+            fclose(f);
+        end
     end
 end
 
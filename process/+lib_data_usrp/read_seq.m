@@ -13,12 +13,59 @@
 % along with this program.  If not, see <http://www.gnu.org/licenses/>.
 %
 
-function [seq] = read_seq(seq_file, sys_param)
+function [seq, header] = read_seq(seq_file, sys_param)
 
     seq = [];
+    header = [];
 
     full_filepath = strcat(seq_file.folder,"/",seq_file.name);
 
+    % since the header was added, seq.bin holds a single period per channel, see record/seq_format.h
+    f = fopen(full_filepath, 'rb');
+    if f < 0
+        error('Cannot open %s.', full_filepath);
+    end
+    magic = fread(f, [1, 8], 'uint8=>char');
+    if strcmp(deblank(strtok(magic, char(0))), 'CHSEQ')
+        header.version          = fread(f, 1, 'uint32');
+        header.header_bytes     = fread(f, 1, 'uint32');
+        header.n_channels       = fread(f, 1, 'uint32');
+        header.n_bytes_per_item = fread(f, 1, 'uint32');
+        header.data_type        = deblank(strtok(fread(f, [1, 8], 'uint8=>char'), char(0)));
+        header.samp_rate        = fread(f, 1, 'uint64');
+        header.seq_length       = fread(f, 1, 'uint64');
+        header.n_active         = fread(f, 1, 'uint64');
+        header.cyclic_shift     = fread(f, 1, 'uint64');
+        header.type             = fread(f, 1, 'uint32');
+        header.seq_root         = fread(f, 1, 'uint32');
+        header.scale            = fread(f, 1, 'single');
+        fread(f, 1, 'uint32');
+        header.seq_checksum     = fread(f, 1, 'uint64=>uint64');
+        header.seq_name         = deblank(strtok(fread(f, [1, 32], 'uint8=>char'), char(0)));
+
+        if header.version > 1
+            fclose(f);
+            error('Unknown seq file version %d.', header.version);
+        end
+        switch header.data_type
+            case 'sc16'
+                matlab_type = 'int16';
+            otherwise
+                matlab_type = 'single';
+        end
+
+        fseek(f, header.header_bytes, 'bof');
+        t = fread(f, [2, header.seq_length*header.n_channels], matlab_type);
+        fclose(f);
+        seq = reshape(complex(t(1,:), t(2,:)), header.seq_length, header.n_channels);
+        if header.seq_length ~= sys_param.seq_len
+            warning('seq.bin has a period of %d samples, sys_param.seq_len is %d.', header.seq_length, sys_param.seq_len);
+        end
+        return;
+    end
+    fclose(f);
+
+    % older files, all repetitions of the sequence as transmitted
     all_samples = lib_data_usrp.read_complex_binary(full_filepath, sys_param.data_type, 0, 0);
 
     % separate into channels
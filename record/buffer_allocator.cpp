@@ -0,0 +1,226 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <boost/thread/thread.hpp>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <numaif.h>
+
+#include "buffer_allocator.h"
+
+#define ARENA_CHUNK_BYTES       (256ULL*1024ULL*1024ULL)    // minimum size of one arena chunk
+#define ARENA_ALIGNMENT         4096                        // every buffer starts on a page, required for O_DIRECT and SIMD
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT          26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB            (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB            (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define MAX_NUMA_NODES          1024        // size of the nodemask passed to mbind
+
+namespace channelsounder
+{
+static page_size_enum page_size;            // requested page size
+static page_size_enum page_size_used;       // page size of the last mapped chunk, differs on fallback
+static int numa_node;                       // -1 for no binding
+static bool lock;                           // mlock chunks
+
+static char* chunk_start;                   // current arena chunk
+static size_t chunk_size;                   // "
+static size_t chunk_used;                   // bytes handed out from current chunk
+
+static unsigned long long n_chunks;         // number of mapped chunks
+static unsigned long long n_bytes_mapped;   // total size of all chunks
+static unsigned long long n_bytes_requested;// total size of all requests
+static unsigned long long n_buffers;        // number of requests
+static unsigned long long n_bind_failed;    // how often could we not bind to numa_node?
+static unsigned long long n_lock_failed;    // how often could we not lock a chunk?
+static std::chrono::nanoseconds t_startup;  // time spent mapping, binding and pre-faulting
+
+static boost::mutex m_mutex;
+
+static size_t get_page_bytes(const page_size_enum ps);
+static char* map_chunk(const size_t n_bytes);
+
+int init_buffer_allocator(const page_size_enum page_size_arg, const int numa_node_arg, const bool lock_arg){
+    if(numa_node_arg < -1 || numa_node_arg >= MAX_NUMA_NODES){
+        std::cerr << "buffer_allocator: NUMA node " << numa_node_arg << " is out of range, -1 for no binding or 0 to " << MAX_NUMA_NODES - 1 << " is supported" << std::endl;
+        return 0;
+    }
+
+    page_size = page_size_arg;
+    page_size_used = page_size_arg;
+    numa_node = numa_node_arg;
+    lock = lock_arg;
+
+    chunk_start = nullptr;
+    chunk_size = 0;
+    chunk_used = 0;
+
+    n_chunks = 0;
+    n_bytes_mapped = 0;
+    n_bytes_requested = 0;
+    n_buffers = 0;
+    n_bind_failed = 0;
+    n_lock_failed = 0;
+    t_startup = std::chrono::nanoseconds(0);
+
+    return 1;
+}
+
+int parse_page_size(const std::string &str, page_size_enum &page_size_out){
+    if(str == "4k" or str == "4K")
+        page_size_out = PAGES_4KB;
+    else if(str == "2m" or str == "2M")
+        page_size_out = PAGES_2MB;
+    else if(str == "1g" or str == "1G")
+        page_size_out = PAGES_1GB;
+    else
+        return 0;
+    return 1;
+}
+
+int get_numa_node_of_interface(const std::string &iface){
+    std::ifstream fin("/sys/class/net/" + iface + "/device/numa_node");
+    int node = -1;
+    if(!(fin >> node))
+        return -1;
+    return node;
+}
+
+void* allocate_buffer(const size_t n_bytes){
+    boost::mutex::scoped_lock lk(m_mutex);
+
+    const size_t n_bytes_aligned = (n_bytes + ARENA_ALIGNMENT - 1)/ARENA_ALIGNMENT*ARENA_ALIGNMENT;
+
+    // not enough space in current chunk, the remainder is wasted
+    if(chunk_start == nullptr || chunk_used + n_bytes_aligned > chunk_size){
+        char* p = map_chunk(std::max<size_t>(n_bytes_aligned, ARENA_CHUNK_BYTES));
+        if(p == nullptr)
+            return nullptr;
+        chunk_start = p;
+        chunk_used = 0;
+    }
+
+    void* ret = static_cast<void*>(chunk_start + chunk_used);
+    chunk_used += n_bytes_aligned;
+
+    n_buffers++;
+    n_bytes_requested += n_bytes;
+
+    return ret;
+}
+
+void show_debug_information_buffer_allocator(){
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Buffer allocator:" << std::endl;
+    std::cout << "page_size requested in bytes: " << get_page_bytes(page_size) << std::endl;
+    std::cout << "page_size used in bytes: " << get_page_bytes(page_size_used) << std::endl;
+    std::cout << "numa_node: " << numa_node << std::endl;
+    std::cout << "lock: " << lock << std::endl;
+    std::cout << "n_chunks: " << n_chunks << std::endl;
+    std::cout << "n_bytes_mapped: " << n_bytes_mapped << std::endl;
+    std::cout << "n_buffers: " << n_buffers << std::endl;
+    std::cout << "n_bytes_requested: " << n_bytes_requested << std::endl;
+    std::cout << "n_bind_failed: " << n_bind_failed << std::endl;
+    std::cout << "n_lock_failed: " << n_lock_failed << std::endl;
+    std::cout << "Startup time (map, bind, pre-fault) in ms: " << std::chrono::duration_cast<std::chrono::microseconds>(t_startup).count()/1000.0 << std::endl;
+    std::cout << "--------------------------" << std::endl;
+}
+
+static size_t get_page_bytes(const page_size_enum ps){
+    switch(ps){
+        case PAGES_2MB:
+            return 2ULL*1024ULL*1024ULL;
+        case PAGES_1GB:
+            return 1024ULL*1024ULL*1024ULL;
+        default:
+            return 4096;
+    }
+}
+
+static char* map_chunk(const size_t n_bytes){
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    void* p = MAP_FAILED;
+    size_t n_bytes_chunk = 0;
+
+    // try explicit hugepages first
+    if(page_size != PAGES_4KB){
+        const size_t page_bytes = get_page_bytes(page_size);
+        n_bytes_chunk = (n_bytes + page_bytes - 1)/page_bytes*page_bytes;
+        const int flags_huge = (page_size == PAGES_2MB) ? MAP_HUGE_2MB : MAP_HUGE_1GB;
+        p = mmap(nullptr, n_bytes_chunk, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | flags_huge, -1, 0);
+        if(p != MAP_FAILED)
+            page_size_used = page_size;
+        else
+            std::cerr << "buffer_allocator: No hugepages available, falling back to regular pages." << std::endl;
+    }
+
+    // regular pages, ask for transparent hugepages
+    if(p == MAP_FAILED){
+        n_bytes_chunk = (n_bytes + ARENA_ALIGNMENT - 1)/ARENA_ALIGNMENT*ARENA_ALIGNMENT;
+        p = mmap(nullptr, n_bytes_chunk, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED){
+            std::cerr << "buffer_allocator: mmap failed." << std::endl;
+            return nullptr;
+        }
+        madvise(p, n_bytes_chunk, MADV_HUGEPAGE);
+        page_size_used = PAGES_4KB;
+    }
+
+    // bind before the first touch so the pages are faulted in on the right node
+    if(numa_node >= 0){
+        unsigned long nodemask[MAX_NUMA_NODES/(8*sizeof(unsigned long))] = {0};
+        const unsigned long bits_per_word = 8*sizeof(unsigned long);
+        nodemask[numa_node/bits_per_word] = 1UL << (numa_node % bits_per_word);
+        if(syscall(SYS_mbind, p, n_bytes_chunk, MPOL_BIND, nodemask, sizeof(nodemask)*8, MPOL_MF_STRICT | MPOL_MF_MOVE) != 0){
+            std::cerr << "buffer_allocator: mbind to NUMA node " << numa_node << " failed." << std::endl;
+            n_bind_failed++;
+        }
+    }
+
+    // pre-fault, mlock faults in all pages by itself
+    if(lock == false || mlock(p, n_bytes_chunk) != 0){
+        if(lock == true){
+            std::cerr << "buffer_allocator: mlock failed, check ulimit -l." << std::endl;
+            n_lock_failed++;
+        }
+        const size_t page_bytes = get_page_bytes(page_size_used);
+        volatile char* c = static_cast<volatile char*>(p);
+        for(size_t i = 0; i < n_bytes_chunk; i += page_bytes)
+            c[i] = 0;
+    }
+
+    n_chunks++;
+    n_bytes_mapped += n_bytes_chunk;
+    chunk_size = n_bytes_chunk;
+
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    t_startup += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1);
+
+    return static_cast<char*>(p);
+}
+}
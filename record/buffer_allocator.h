@@ -0,0 +1,105 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_BUFFER_ALLOCATOR_H
+#define CHANNELSOUNDER_BUFFER_ALLOCATOR_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <new>
+
+namespace channelsounder
+{
+enum page_size_enum{
+    PAGES_4KB,                  // regular pages, transparent hugepages are requested via madvise
+    PAGES_2MB,                  // explicit hugepages, must be reserved in /sys/kernel/mm/hugepages
+    PAGES_1GB                   // "
+};
+
+/*!
+ * Inits unit internally. Must be called before any other unit is initialized.
+ * All pipeline buffers are carved out of large arena chunks which are mapped, bound, locked and pre-faulted here and never released.
+ *
+ * page_size_arg                page size of the arena chunks, falls back to PAGES_4KB if no hugepages are available
+ * numa_node_arg                NUMA node the memory is bound to, ideally the node of the NIC, -1 for no binding, nodes up to 1023 are supported
+ * lock_arg                     if true, chunks are locked into RAM with mlock
+ * return                       1 on success and 0 on failure
+*/
+int init_buffer_allocator(const page_size_enum page_size_arg, const int numa_node_arg, const bool lock_arg);
+
+/*!
+ * Converts a command line string to a page size.
+ *
+ * str                          "4k", "2M" or "1G"
+ * page_size                    set on success
+ * return                       1 on success and 0 on failure
+*/
+int parse_page_size(const std::string &str, page_size_enum &page_size);
+
+/*!
+ * Reads the NUMA node of a network interface from sysfs.
+ *
+ * iface                        name of the interface, e.g. "enp1s0f0"
+ * return                       NUMA node or -1 if unknown
+*/
+int get_numa_node_of_interface(const std::string &iface);
+
+/*!
+ * Returns memory from the arena. Memory is zero, page aligned and pre-faulted.
+ * Not meant for the hot path, call during initialization only.
+ *
+ * n_bytes                      size of requested memory
+ * return                       pointer to memory, nullptr on failure
+*/
+void* allocate_buffer(const size_t n_bytes);
+
+/*!
+ * Shows some stats of the allocator, including the startup time spent mapping and pre-faulting.
+*/
+void show_debug_information_buffer_allocator();
+
+/*!
+ * Allocator for standard containers. Memory is taken from the arena and never returned.
+*/
+template <class T>
+struct buffer_allocator{
+    typedef T value_type;
+
+    buffer_allocator() = default;
+    template <class U> buffer_allocator(const buffer_allocator<U>&) {}
+
+    T* allocate(const size_t n){
+        void* p = allocate_buffer(n*sizeof(T));
+        if(p == nullptr)
+            throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T*, size_t) {}
+};
+
+template <class T, class U>
+bool operator==(const buffer_allocator<T>&, const buffer_allocator<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const buffer_allocator<T>&, const buffer_allocator<U>&) { return false; }
+
+// container for samples of one channel/antenna
+typedef std::vector<char, buffer_allocator<char>> buffer_t;
+}
+ 
+#endif
@@ -0,0 +1,124 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CHANNELSOUNDER_CH_MEASUREMENT_FORMAT_H
+#define CHANNELSOUNDER_CH_MEASUREMENT_FORMAT_H
+
+#include <cstdint>
+
+// layout of ch_measurement_*.bin, all values little endian:
+// [ch_measurement_file_header][ch_measurement_index_entry x n_measurements (x n_channels if compressed)][zero padding to header_bytes][channel 0][channel 1]...
+// raw:         one index entry per measurement, channel c of measurement k starts at index[k].offset + c*channel_stride
+// compressed:  one index entry per measurement and channel, channel c of measurement k is index[c*n_measurements + k], channel_stride is 0
+// cir:         like raw, but each channel of a measurement holds [tx 0 taps][tx 1 taps]... as fc32 instead of the samples
+// gated:       like raw or cir, measurements flagged CH_MEASUREMENT_DISCARDED are holes of a sparse file and read as zeros
+#define CH_MEASUREMENT_FILE_MAGIC       "CHSOUND"
+#define CH_MEASUREMENT_FILE_VERSION     6
+#define CH_MEASUREMENT_FILE_ALIGNMENT   4096        // header_bytes and channel_stride are multiples of this, samples can be read with O_DIRECT
+
+// codecs, version 1 files are always raw
+#define CH_MEASUREMENT_CODEC_RAW        0
+#define CH_MEASUREMENT_CODEC_SC16_DELTA 1           // see sc16_codec.h, codec_param is the keyframe interval
+
+// storage formats of a window, version 1 and 2 files are always native, see storage_format.h
+// a stored value times storage_scale is the value of the native sample (sc16 or fc32)
+#define CH_MEASUREMENT_STORAGE_NATIVE   0           // samples as received, data_type "sc16" or "fc32"
+#define CH_MEASUREMENT_STORAGE_SC12     1           // 12 bit real and imag packed into 3 bytes per complex sample
+#define CH_MEASUREMENT_STORAGE_SC8      2           // [int32 exponent][int8 real, int8 imag]..., value = q*2^exponent*storage_scale, one exponent per window
+#define CH_MEASUREMENT_STORAGE_FP16     3           // IEEE 754 half precision real and imag
+
+// content of a window, version 1 to 3 files always contain samples
+#define CH_MEASUREMENT_CONTENT_SAMPLES  0
+#define CH_MEASUREMENT_CONTENT_CIR      1           // channel impulse response per rx/tx pair, see cir_extraction.h
+
+// flags of an index entry
+#define CH_MEASUREMENT_COMPLETE         0x1         // all samples of the measurement were received, otherwise it contains stale samples
+#define CH_MEASUREMENT_DISCARDED        0x2         // not saved by the window gate, see window_gate.h, since version 5
+
+namespace channelsounder
+{
+struct ch_measurement_file_header{
+    char magic[8];                      // CH_MEASUREMENT_FILE_MAGIC
+    uint32_t version;                   // CH_MEASUREMENT_FILE_VERSION
+    uint32_t header_bytes;              // offset of the first sample
+    uint64_t index_offset;              // offset of the first index entry
+    uint64_t file_bytes;                // total size of the file
+
+    // fifo parameters
+    uint32_t n_channels;                // number of rx channels in this file
+    uint32_t n_bytes_per_item;          // size of one complex sample as received
+    char data_type[8];                  // stored samples, "sc16", "fc32", "sc12", "sc8" or "fp16"
+    uint64_t samp_rate;                 // S/s
+    uint32_t n_samples_per_period;      // number of complex samples between the start of two measurements
+    uint32_t measurement_length;        // number of complex samples per measurement and channel
+    uint32_t measurements_per_sec;
+    uint32_t save_period_sec;
+    uint64_t n_measurements;            // number of measurements and index entries in this file
+    uint64_t channel_stride;            // bytes between the samples of two neighbouring channels
+
+    // time
+    uint64_t file_number;               // number in the file name
+    uint64_t first_measurement;         // absolute number of measurement 0 in device time, first_tick/n_samples_per_period
+    int64_t first_tick;                 // device time of measurement 0 in samples
+    int64_t first_time_full_secs;       // device time of measurement 0 as uhd::time_spec_t
+    double first_time_frac_secs;        // "
+    int64_t stream_start_tick;          // device time of the first sample received by this pipeline
+    int64_t host_time_ns;               // host wall clock when the file was handed to the writer, ns since epoch
+
+    // tx sequence
+    char seq_name[32];                  // e.g. "sine_1mhz", empty if unknown
+    uint64_t seq_length;                // length of one period in complex samples
+    uint64_t seq_checksum;              // FNV-1a over one period of all tx channels as transmitted
+
+    char file_prefix[48];               // 56 characters before version 3
+
+    // since version 3
+    uint32_t storage_format;            // CH_MEASUREMENT_STORAGE_NATIVE etc.
+    float storage_scale;                // stored value times storage_scale is the native sample value
+
+    // since version 2
+    uint32_t codec;                     // CH_MEASUREMENT_CODEC_RAW etc.
+    uint32_t codec_param;               // depends on codec
+
+    // since version 4
+    uint32_t content;                   // CH_MEASUREMENT_CONTENT_SAMPLES or CH_MEASUREMENT_CONTENT_CIR
+    uint32_t n_tx_channels;             // cir: number of tx sequences each window was correlated with
+    uint32_t cir_taps;                  // cir: complex fc32 taps per rx/tx pair
+    int32_t cir_tap_offset;             // cir: delay of tap 0 relative to the start of the tx sequence in samples
+
+    // since version 5
+    uint32_t gate;                      // 1 if only windows around a trigger were saved
+    float gate_threshold_db;            // gate: power of a trigger window relative to full scale, averaged over all channels
+    uint32_t gate_pre;                  // gate: windows saved before each trigger
+    uint32_t gate_post;                 // gate: windows saved after each trigger
+
+    // since version 6
+    uint32_t n_average;                 // windows averaged into each measurement, measurements_per_sec and n_samples_per_period refer to the averages
+    char reserved[220];                 // zero, for future use
+};
+
+struct ch_measurement_index_entry{
+    int64_t tick;                       // device time of the first sample
+    uint64_t offset;                    // offset of the samples of channel 0
+    uint32_t n_bytes;                   // bytes per channel
+    uint32_t flags;                     // CH_MEASUREMENT_COMPLETE etc.
+};
+
+static_assert(sizeof(ch_measurement_file_header) == 512, "file header layout changed");
+static_assert(sizeof(ch_measurement_index_entry) == 24, "index entry layout changed");
+}
+
+#endif
@@ -0,0 +1,351 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CHANNELSOUNDER_CH_MEASUREMENT_READER_H
+#define CHANNELSOUNDER_CH_MEASUREMENT_READER_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ch_measurement_format.h"
+#include "sc16_codec.h"
+#include "storage_format.h"
+
+namespace channelsounder
+{
+/*!
+ * Header-only reader for ch_measurement_*.bin, maps the file and gives random access to single measurements.
+ * Only touched pages are read from disk. A file striped across several drives (--stripe_kib) is opened by its name as well,
+ * its stripes are then assembled in memory from <file>.part<N> as listed in <file>.idx, see file_writer.h.
+ *
+ * ch_measurement_reader r;
+ * if(r.open("../data/ch_measurement_0000000000.bin"))
+ *     const int16_t* iq = r.measurement_as<int16_t>(k, ch);     // raw files stored natively only
+ *     r.decode_measurement(k, ch, iq_out);                      // sc16, raw or compressed
+ *     r.decode_measurement(k, ch, iq_out_float);                // any storage format, native sample values
+ *     const float* taps = r.cir(k, rx, tx);                     // cir files only
+ *     bool saved = r.kept(k);                                   // false if dropped by the window gate
+*/
+class ch_measurement_reader{
+public:
+    ch_measurement_reader() : fd(-1), base(nullptr), n_bytes(0) {}
+    ~ch_measurement_reader(){ close(); }
+
+    ch_measurement_reader(const ch_measurement_reader&) = delete;
+    ch_measurement_reader& operator=(const ch_measurement_reader&) = delete;
+
+    /*!
+     * full_file_path           file to map, or a striped file by its name or its <file>.idx
+     * return                   1 on success and 0 on failure, e.g. if the header is not valid
+    */
+    int open(const std::string &full_file_path){
+        close();
+
+        // striped files only exist as index and parts
+        int ret;
+        if(full_file_path.size() > 4 && full_file_path.compare(full_file_path.size() - 4, 4, ".idx") == 0)
+            ret = assemble_stripes(full_file_path);
+        else if(access(full_file_path.c_str(), F_OK) != 0 && access((full_file_path + ".idx").c_str(), F_OK) == 0)
+            ret = assemble_stripes(full_file_path + ".idx");
+        else
+            ret = map_file(full_file_path);
+        if(ret == 0){
+            close();
+            return 0;
+        }
+
+        const ch_measurement_file_header &h = header();
+        if(memcmp(h.magic, CH_MEASUREMENT_FILE_MAGIC, sizeof(CH_MEASUREMENT_FILE_MAGIC)) != 0
+           || h.version == 0 || h.version > CH_MEASUREMENT_FILE_VERSION
+           || h.file_bytes != n_bytes
+           || h.index_offset + n_index_entries()*sizeof(ch_measurement_index_entry) > h.header_bytes
+           || h.header_bytes + h.n_channels*h.channel_stride > n_bytes
+           || (codec() != CH_MEASUREMENT_CODEC_RAW && (codec() != CH_MEASUREMENT_CODEC_SC16_DELTA || h.codec_param == 0))
+           || storage_format() > CH_MEASUREMENT_STORAGE_FP16
+           || content() > CH_MEASUREMENT_CONTENT_CIR){
+            std::cerr << "ch_measurement_reader: invalid header " << full_file_path << std::endl;
+            close();
+            return 0;
+        }
+
+        return 1;
+    }
+
+    void close(){
+        if(base != nullptr)
+            munmap(const_cast<char*>(base), n_bytes);
+        if(fd >= 0)
+            ::close(fd);
+        fd = -1;
+        base = nullptr;
+        n_bytes = 0;
+    }
+
+    const ch_measurement_file_header& header() const{
+        return *reinterpret_cast<const ch_measurement_file_header*>(base);
+    }
+
+    size_t n_measurements() const{
+        return header().n_measurements;
+    }
+
+    size_t n_channels() const{
+        return header().n_channels;
+    }
+
+    // CH_MEASUREMENT_CODEC_RAW etc.
+    uint32_t codec() const{
+        return (header().version < 2) ? CH_MEASUREMENT_CODEC_RAW : header().codec;
+    }
+
+    // CH_MEASUREMENT_STORAGE_NATIVE etc.
+    uint32_t storage_format() const{
+        return (header().version < 3) ? CH_MEASUREMENT_STORAGE_NATIVE : header().storage_format;
+    }
+
+    // CH_MEASUREMENT_CONTENT_SAMPLES or CH_MEASUREMENT_CONTENT_CIR
+    uint32_t content() const{
+        return (header().version < 4) ? CH_MEASUREMENT_CONTENT_SAMPLES : header().content;
+    }
+
+    // windows averaged into each measurement
+    uint32_t n_average() const{
+        return (header().version < 6) ? 1 : header().n_average;
+    }
+
+    size_t n_index_entries() const{
+        return (codec() == CH_MEASUREMENT_CODEC_RAW) ? header().n_measurements : header().n_measurements*header().n_channels;
+    }
+
+    // false if measurement k was not saved by the window gate, its samples read as zeros
+    bool kept(const size_t k) const{
+        return (index(k).flags & CH_MEASUREMENT_DISCARDED) == 0;
+    }
+
+    // index entry of measurement k, channel 0 for raw files
+    const ch_measurement_index_entry& index(const size_t k, const size_t ch = 0) const{
+        const ch_measurement_index_entry* idx = reinterpret_cast<const ch_measurement_index_entry*>(base + header().index_offset);
+        return (codec() == CH_MEASUREMENT_CODEC_RAW) ? idx[k] : idx[ch*header().n_measurements + k];
+    }
+
+    /*!
+     * k                        number of the measurement within this file, smaller than n_measurements()
+     * ch                       channel, smaller than n_channels()
+     * return                   first byte of the samples, coded if the file is compressed
+    */
+    const char* measurement(const size_t k, const size_t ch) const{
+        if(codec() == CH_MEASUREMENT_CODEC_RAW)
+            return base + index(k).offset + ch*header().channel_stride;
+        return base + index(k, ch).offset;
+    }
+
+    /*!
+     * Decodes a single sc16 measurement, compressed measurements are decoded starting at the last keyframe.
+     *
+     * k                        number of the measurement within this file, smaller than n_measurements()
+     * ch                       channel, smaller than n_channels()
+     * out                      measurement_length complex samples, real and imag interleaved
+     * return                   1 on success and 0 on failure, e.g. for fc32 files or other storage formats
+    */
+    int decode_measurement(const size_t k, const size_t ch, int16_t* out) const{
+        const ch_measurement_file_header &h = header();
+        if(h.n_bytes_per_item != 4 || storage_format() != CH_MEASUREMENT_STORAGE_NATIVE || content() != CH_MEASUREMENT_CONTENT_SAMPLES)
+            return 0;
+
+        if(codec() == CH_MEASUREMENT_CODEC_RAW){
+            memcpy(out, measurement(k, ch), h.measurement_length*h.n_bytes_per_item);
+            return 1;
+        }
+
+        // decode in place, each window is the reference of the next
+        const size_t k0 = k - k % h.codec_param;
+        for(size_t i = k0; i <= k; i++)
+            sc16_decode_window(measurement(i, ch), (i == k0) ? nullptr : out, h.measurement_length, out);
+        return 1;
+    }
+
+    /*!
+     * Decodes a single measurement of any storage format and codec to native sample values, e.g. -32768..32767 for sc16.
+     *
+     * k                        number of the measurement within this file, smaller than n_measurements()
+     * ch                       channel, smaller than n_channels()
+     * out                      measurement_length complex samples, real and imag interleaved
+     * return                   1 on success and 0 on failure
+    */
+    int decode_measurement(const size_t k, const size_t ch, float* out) const{
+        const ch_measurement_file_header &h = header();
+        if(content() != CH_MEASUREMENT_CONTENT_SAMPLES)
+            return 0;
+        if(codec() != CH_MEASUREMENT_CODEC_RAW){
+            std::vector<int16_t> iq(2*h.measurement_length);
+            if(decode_measurement(k, ch, &iq[0]) == 0)
+                return 0;
+            for(size_t i = 0; i < iq.size(); i++)
+                out[i] = iq[i];
+            return 1;
+        }
+
+        const float scale = (storage_format() == CH_MEASUREMENT_STORAGE_NATIVE) ? 1.0f : h.storage_scale;
+        storage_decode_window(storage_format(), h.n_bytes_per_item, scale, measurement(k, ch), h.measurement_length, out);
+        return 1;
+    }
+
+    /*!
+     * k                        number of the measurement within this file, smaller than n_measurements()
+     * ch                       rx channel, smaller than n_channels()
+     * tx                       tx channel, smaller than header().n_tx_channels
+     * return                   header().cir_taps complex taps, real and imag interleaved, tap t has a delay of cir_tap_offset + t samples
+    */
+    const float* cir(const size_t k, const size_t ch, const size_t tx) const{
+        return measurement_as<float>(k, ch) + 2*tx*header().cir_taps;
+    }
+
+    // e.g. int16_t for sc16 and float for fc32, real and imag interleaved
+    template<typename T>
+    const T* measurement_as(const size_t k, const size_t ch) const{
+        return reinterpret_cast<const T*>(measurement(k, ch));
+    }
+
+private:
+    int map_file(const std::string &full_file_path){
+        fd = ::open(full_file_path.c_str(), O_RDONLY);
+        if(fd < 0){
+            std::cerr << "ch_measurement_reader: could not open " << full_file_path << std::endl;
+            return 0;
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ch_measurement_file_header)){
+            std::cerr << "ch_measurement_reader: file too small " << full_file_path << std::endl;
+            return 0;
+        }
+
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED){
+            std::cerr << "ch_measurement_reader: could not map " << full_file_path << std::endl;
+            return 0;
+        }
+        base = static_cast<const char*>(p);
+        n_bytes = st.st_size;
+
+        // access pattern is random
+        madvise(p, n_bytes, MADV_RANDOM);
+        return 1;
+    }
+
+    // <file>.idx: "n_bytes N", "stripe_bytes N", "n_parts N", then one line "stripe offset length part_path part_offset" per stripe
+    int assemble_stripes(const std::string &idx_path){
+        std::ifstream fin(idx_path);
+        std::string key_bytes, key_stripe, key_parts;
+        unsigned long long n_bytes_file = 0, stripe_bytes = 0, n_parts = 0;
+        fin >> key_bytes >> n_bytes_file >> key_stripe >> stripe_bytes >> key_parts >> n_parts;
+        if(!fin || key_bytes != "n_bytes" || key_stripe != "stripe_bytes" || key_parts != "n_parts" || n_bytes_file < sizeof(ch_measurement_file_header)){
+            std::cerr << "ch_measurement_reader: invalid stripe index " << idx_path << std::endl;
+            return 0;
+        }
+
+        void* p = mmap(nullptr, n_bytes_file, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED){
+            std::cerr << "ch_measurement_reader: could not allocate " << n_bytes_file << " bytes for " << idx_path << std::endl;
+            return 0;
+        }
+        base = static_cast<const char*>(p);
+        n_bytes = n_bytes_file;
+
+        // parts are looked up at the path the recorder wrote them to, then next to the index, e.g. after copying all parts into one directory
+        const size_t slash = idx_path.find_last_of('/');
+        const std::string idx_dir = (slash == std::string::npos) ? "" : idx_path.substr(0, slash + 1);
+        std::map<std::string, int> part_fds;
+        unsigned long long n_bytes_assembled = 0;
+        int ret = 1;
+        std::string line;
+        std::getline(fin, line);
+        while(ret == 1 && std::getline(fin, line)){
+            if(line.empty())
+                continue;
+
+            // the path may contain spaces, the part offset is the last field
+            std::istringstream ss(line);
+            unsigned long long k, offset, length;
+            std::string rest;
+            ss >> k >> offset >> length;
+            std::getline(ss, rest);
+            const size_t first = rest.find_first_not_of(' ');
+            const size_t last = rest.find_last_of(' ');
+            if(!ss || first == std::string::npos || last == std::string::npos || last <= first || offset + length > n_bytes){
+                std::cerr << "ch_measurement_reader: invalid stripe " << line << " in " << idx_path << std::endl;
+                ret = 0;
+                break;
+            }
+            const std::string part_path = rest.substr(first, last - first);
+            const unsigned long long part_offset = std::strtoull(rest.c_str() + last + 1, nullptr, 10);
+
+            std::map<std::string, int>::iterator it = part_fds.find(part_path);
+            if(it == part_fds.end()){
+                int part_fd = ::open(part_path.c_str(), O_RDONLY);
+                if(part_fd < 0){
+                    const size_t part_slash = part_path.find_last_of('/');
+                    const std::string part_local = idx_dir + ((part_slash == std::string::npos) ? part_path : part_path.substr(part_slash + 1));
+                    part_fd = ::open(part_local.c_str(), O_RDONLY);
+                }
+                if(part_fd < 0){
+                    std::cerr << "ch_measurement_reader: could not open " << part_path << std::endl;
+                    ret = 0;
+                    break;
+                }
+                it = part_fds.insert(std::make_pair(part_path, part_fd)).first;
+            }
+
+            unsigned long long done = 0;
+            while(done < length){
+                const ssize_t r = pread(it->second, static_cast<char*>(p) + offset + done, length - done, part_offset + done);
+                if(r <= 0){
+                    std::cerr << "ch_measurement_reader: could not read stripe " << k << " from " << part_path << std::endl;
+                    ret = 0;
+                    break;
+                }
+                done += r;
+            }
+            n_bytes_assembled += length;
+        }
+        for(std::map<std::string, int>::iterator it = part_fds.begin(); it != part_fds.end(); ++it)
+            ::close(it->second);
+
+        if(ret == 1 && n_bytes_assembled != n_bytes){
+            std::cerr << "ch_measurement_reader: stripes of " << idx_path << " cover " << n_bytes_assembled << " of " << n_bytes << " bytes" << std::endl;
+            ret = 0;
+        }
+        mprotect(p, n_bytes, PROT_READ);
+        return ret;
+    }
+
+    int fd;
+    const char* base;
+    size_t n_bytes;
+};
+}
+
+#endif
@@ -14,10 +14,13 @@
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <boost/thread/thread.hpp>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cmath>
 #include <complex>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <thread>
 
@@ -27,6 +30,22 @@
 #include "ringbuffer_rx.h"
 #include "ringbuffer_tx.h"
 #include "fifo_ch_measurement.h"
+#include "buffer_allocator.h"
+#include "thread_placement.h"
+#include "file_writer.h"
+#include "compression.h"
+#include "storage_format.h"
+#include "cir_extraction.h"
+#include "shm_publisher.h"
+#include "metrics.h"
+#include "latency_histogram.h"
+#include "event_trace.h"
+#include "virtual_rx_streamer.h"
+#include "window_gate.h"
+#include "window_average.h"
+#include "sequence.h"
+#include "seq_format.h"
+#include "config.h"
 
  // rate is set via cmd line args
 
@@ -52,16 +71,7 @@ constexpr int64_t CLOCK_TIMEOUT = 1000; // 1000mS timeout for external clock loc
 /***********************************************************************
  * Test result variables
  **********************************************************************/
-unsigned long long num_overruns      = 0;
-unsigned long long num_underruns     = 0;
-unsigned long long num_rx_samps      = 0;
-unsigned long long num_tx_samps      = 0;
-unsigned long long num_dropped_samps = 0;
-unsigned long long num_seq_errors    = 0;
-unsigned long long num_seqrx_errors  = 0; // "D"s
-unsigned long long num_late_commands = 0;
-unsigned long long num_timeouts_rx   = 0;
-unsigned long long num_timeouts_tx   = 0;
+// counted per thread, see metrics.h, and summed up for the summary
 
 inline boost::posix_time::time_duration time_delta(
     const boost::posix_time::ptime& ref_time)
@@ -86,14 +96,19 @@ void benchmark_rx_rate(uhd::usrp::multi_usrp::sptr usrp,
     const boost::posix_time::ptime& start_time,
     std::atomic<bool>& burst_timer_elapsed,
     bool elevate_priority,
-    double rx_delay)
+    double rx_delay,
+    bool steered_capture,
+    size_t id)
 {
-    if (elevate_priority) {
+    if (elevate_priority and not channelsounder::has_thread_policy("rx")) {
         uhd::set_thread_priority_safe();
     }
+    channelsounder::apply_thread_placement("rx", id);
+    channelsounder::register_metrics_thread("rx", id);
+    channelsounder::register_trace_thread("rx", id);
 
     // print pre-test summary
-    std::cout << boost::format("[%s] Testing receive rate %f Msps on %u channels") % NOW() % (usrp->get_rx_rate() / 1e6) % rx_stream->get_num_channels() << std::endl;
+    std::cout << boost::format("[%s] Testing receive rate %f Msps on %u channels (pipeline %u)") % NOW() % (usrp->get_rx_rate() / 1e6) % rx_stream->get_num_channels() % id << std::endl;
 
     // setup variables and allocate buffer
     uhd::rx_metadata_t md;
@@ -104,8 +119,15 @@ void benchmark_rx_rate(uhd::usrp::multi_usrp::sptr usrp,
     // ##########################
     unsigned long long n_new_samples = 0;
     
+    // in steered capture the fifo limits the number of samples, so that uhd never writes across the border of a measurement
+    size_t n_samples_max = max_samps_per_packet;
+    
     // return pointers where samples will be written to
-    std::vector<void*> buffs = channelsounder::get_ringbuffer_rx_pointers(0);
+    std::vector<void*> buffs;
+    if (steered_capture)
+        buffs = channelsounder::get_fifo_ch_measurement_pointers(0, 0, n_samples_max, id);
+    else
+        buffs = channelsounder::get_ringbuffer_rx_pointers(0, 0, id);
     
     //std::vector<char> buff(max_samps_per_packet * uhd::convert::get_bytes_per_item(rx_cpu));
     //std::vector<void*> buffs;
@@ -117,6 +139,7 @@ void benchmark_rx_rate(uhd::usrp::multi_usrp::sptr usrp,
     bool had_an_overflow = false;
     uhd::time_spec_t last_time;
     const double rate = usrp->get_rx_rate();
+    long long tick = 0;
 
     uhd::stream_cmd_t cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
     cmd.time_spec  = usrp->get_time_now() + uhd::time_spec_t(rx_delay);
@@ -154,13 +177,22 @@ void benchmark_rx_rate(uhd::usrp::multi_usrp::sptr usrp,
             // ##########################
             // ##########################
             // retuns n_new_samples-many samples for each receive channel
-            n_new_samples = rx_stream->recv(buffs, max_samps_per_packet, md, recv_timeout);
+            const unsigned long long t_recv = channelsounder::latency_clock();
+            n_new_samples = rx_stream->recv(buffs, n_samples_max, md, recv_timeout);
+            channelsounder::record_latency(channelsounder::LATENCY_RX_RECV, channelsounder::latency_clock() - t_recv, id);
             
             // uhd counts samples for each channel
-            num_rx_samps += n_new_samples * rx_stream->get_num_channels();
+            channelsounder::add_metric(channelsounder::METRIC_RX_SAMPLES, n_new_samples * rx_stream->get_num_channels());
+            
+            // device time of the first new sample, used to keep measurements aligned across gaps and pipelines
+            if (n_new_samples > 0)
+                tick = md.time_spec.to_ticks(rate);
             
             // refresh pointers for next call of rx_stream->recv()
-            buffs = channelsounder::get_ringbuffer_rx_pointers(n_new_samples);
+            if (steered_capture)
+                buffs = channelsounder::get_fifo_ch_measurement_pointers(n_new_samples, tick, n_samples_max, id);
+            else
+                buffs = channelsounder::get_ringbuffer_rx_pointers(n_new_samples, tick, id);
             
             //num_rx_samps += rx_stream->recv(buffs, max_samps_per_packet, md, recv_timeout) * rx_stream->get_num_channels();
             // ##########
@@ -188,7 +220,7 @@ void benchmark_rx_rate(uhd::usrp::multi_usrp::sptr usrp,
                                      "(Delta: "
                                   << dropped_samps << " ticks)\n";
                     }
-                    num_dropped_samps += std::max<long>(1, dropped_samps);
+                    channelsounder::add_metric(channelsounder::METRIC_RX_DROPPED_SAMPLES, std::max<long>(1, dropped_samps));
                 }
                 if ((burst_timer_elapsed or stop_called) and md.end_of_burst) {
                     return;
@@ -202,9 +234,11 @@ void benchmark_rx_rate(uhd::usrp::multi_usrp::sptr usrp,
                 // check out_of_sequence flag to see if it was a sequence error or
                 // overflow
                 if (!md.out_of_sequence) {
-                    num_overruns++;
+                    channelsounder::add_metric(channelsounder::METRIC_RX_OVERRUNS, 1);
+                    channelsounder::trace_instant(channelsounder::TRACE_RX_OVERFLOW, md.time_spec.to_ticks(rate), id);
                 } else {
-                    num_seqrx_errors++;
+                    channelsounder::add_metric(channelsounder::METRIC_RX_SEQUENCE_ERRORS, 1);
+                    channelsounder::trace_instant(channelsounder::TRACE_RX_SEQUENCE_ERROR, md.time_spec.to_ticks(rate), id);
                     std::cerr << "[" << NOW() << "] Detected Rx sequence error."
                               << std::endl;
                 }
@@ -213,7 +247,8 @@ void benchmark_rx_rate(uhd::usrp::multi_usrp::sptr usrp,
             case uhd::rx_metadata_t::ERROR_CODE_LATE_COMMAND:
                 std::cerr << "[" << NOW() << "] Receiver error: " << md.strerror()
                           << ", restart streaming..." << std::endl;
-                num_late_commands++;
+                channelsounder::add_metric(channelsounder::METRIC_RX_LATE_COMMANDS, 1);
+                channelsounder::trace_instant(channelsounder::TRACE_RX_LATE_COMMAND, md.time_spec.to_ticks(rate), id);
                 // Radio core will be in the idle state. Issue stream command to restart
                 // streaming.
                 cmd.time_spec  = usrp->get_time_now() + uhd::time_spec_t(0.05);
@@ -227,7 +262,8 @@ void benchmark_rx_rate(uhd::usrp::multi_usrp::sptr usrp,
                 }
                 std::cerr << "[" << NOW() << "] Receiver error: " << md.strerror()
                           << ", continuing..." << std::endl;
-                num_timeouts_rx++;
+                channelsounder::add_metric(channelsounder::METRIC_RX_TIMEOUTS, 1);
+                channelsounder::trace_instant(channelsounder::TRACE_RX_TIMEOUT, tick, id);
                 break;
 
                 // Otherwise, it's an error
@@ -251,11 +287,17 @@ void benchmark_tx_rate(uhd::usrp::multi_usrp::sptr usrp,
     const boost::posix_time::ptime& start_time,
     bool elevate_priority,
     double tx_delay,
+    size_t burst_period,
+    size_t burst_length,
+    size_t burst_guard,
     bool random_nsamps = false)
 {
-    if (elevate_priority) {
+    if (elevate_priority and not channelsounder::has_thread_policy("tx")) {
         uhd::set_thread_priority_safe();
     }
+    channelsounder::apply_thread_placement("tx", 0);
+    channelsounder::register_metrics_thread("tx", 0);
+    unsigned long long num_timeouts_tx = 0;
 
     // print pre-test summary
     std::cout << boost::format("[%s] Testing transmit rate %f Msps on %u channels")
@@ -285,6 +327,58 @@ void benchmark_tx_rate(uhd::usrp::multi_usrp::sptr usrp,
     md.has_time_spec = true;
     md.time_spec     = usrp->get_time_now() + uhd::time_spec_t(tx_delay);
 
+    // ##########################
+    // ##########################
+    // ##########################
+    // one timed burst per measurement window, the window starts burst_guard samples after the burst and is followed by burst_guard samples
+    if (burst_period > 0) {
+        const long long period = burst_period;
+        const long long first_tick = md.time_spec.to_ticks(usrp->get_tx_rate()) + burst_guard;
+        long long m = (first_tick + period - 1)/period;
+        const float timeout = 1.0f + tx_delay;
+        while (not burst_timer_elapsed) {
+            const long long burst_start = m*period - burst_guard;
+            md.has_time_spec = true;
+            md.time_spec = uhd::time_spec_t::from_ticks(burst_start, usrp->get_tx_rate());
+            md.start_of_burst = true;
+            
+            size_t num_burst_samps = 0;
+            buffs = channelsounder::get_ringbuffer_tx_pointers_at(0, burst_start);
+            while (num_burst_samps < burst_length and not burst_timer_elapsed) {
+                const size_t n = std::min(max_samps_per_packet, burst_length - num_burst_samps);
+                md.end_of_burst = (num_burst_samps + n == burst_length);
+                const size_t num_tx_samps_sent_now = tx_stream->send(buffs, n, md, timeout);
+                if (num_tx_samps_sent_now == 0) {
+                    num_timeouts_tx++;
+                    channelsounder::add_metric(channelsounder::METRIC_TX_TIMEOUTS, 1);
+                    if ((num_timeouts_tx % 10000) == 1) {
+                        std::cerr << "[" << NOW() << "] Tx timeouts: " << num_timeouts_tx
+                                  << std::endl;
+                    }
+                    continue;
+                }
+                channelsounder::add_metric(channelsounder::METRIC_TX_SAMPLES, num_tx_samps_sent_now*tx_stream->get_num_channels());
+                num_burst_samps += num_tx_samps_sent_now;
+                buffs = channelsounder::get_ringbuffer_tx_pointers_at(num_tx_samps_sent_now, burst_start + num_burst_samps);
+                md.has_time_spec = false;
+                md.start_of_burst = false;
+            }
+            if (num_burst_samps == burst_length)
+                channelsounder::add_metric(channelsounder::METRIC_TX_BURSTS, 1);
+            m++;
+        }
+        
+        // close a burst cut short
+        md.has_time_spec = false;
+        md.start_of_burst = false;
+        md.end_of_burst = true;
+        tx_stream->send(buffs, 0, md);
+        return;
+    }
+    // ##########
+    // ##########
+    // ##########
+
     if (random_nsamps) {
         std::srand((unsigned int)time(NULL));
         while (not burst_timer_elapsed) {
@@ -295,24 +389,30 @@ void benchmark_tx_rate(uhd::usrp::multi_usrp::sptr usrp,
             usrp->set_time_now(uhd::time_spec_t(0.0));
             while (num_acc_samps < total_num_samps) {
                 // send a single packet
-                num_tx_samps += tx_stream->send(buffs, max_samps_per_packet, md, timeout)* tx_stream->get_num_channels();
+                channelsounder::add_metric(channelsounder::METRIC_TX_SAMPLES, tx_stream->send(buffs, max_samps_per_packet, md, timeout)* tx_stream->get_num_channels());
                 num_acc_samps += std::min(total_num_samps - num_acc_samps, tx_stream->get_max_num_samps());
             }
         }
     } else {
+        size_t num_samps_max = max_samps_per_packet;
+        buffs = channelsounder::get_ringbuffer_tx_pointers(0, num_samps_max);
         while (not burst_timer_elapsed) {
             
             // ##########################
             // ##########################
             // ##########################
+            // a waveform played without loop has ended
+            if (num_samps_max == 0)
+                break;
+            
             // num_tx_samps_sent_now-many samples for each receive channel have been read
-            const size_t num_tx_samps_sent_now = tx_stream->send(buffs, max_samps_per_packet, md);
+            const size_t num_tx_samps_sent_now = tx_stream->send(buffs, num_samps_max, md);
             
             // uhd counts samples for each channel
-            num_tx_samps += num_tx_samps_sent_now*tx_stream->get_num_channels();
+            channelsounder::add_metric(channelsounder::METRIC_TX_SAMPLES, num_tx_samps_sent_now*tx_stream->get_num_channels());
             
             // refresh pointers for next call of tx_stream->send
-            buffs = channelsounder::get_ringbuffer_tx_pointers(num_tx_samps_sent_now);            
+            buffs = channelsounder::get_ringbuffer_tx_pointers(num_tx_samps_sent_now, num_samps_max);
             
             //const size_t num_tx_samps_sent_now = tx_stream->send(buffs, max_samps_per_packet, md) * tx_stream->get_num_channels();
             //num_tx_samps += num_tx_samps_sent_now;
@@ -321,6 +421,7 @@ void benchmark_tx_rate(uhd::usrp::multi_usrp::sptr usrp,
             // ##########
             if (num_tx_samps_sent_now == 0) {
                 num_timeouts_tx++;
+                channelsounder::add_metric(channelsounder::METRIC_TX_TIMEOUTS, 1);
                 if ((num_timeouts_tx % 10000) == 1) {
                     std::cerr << "[" << NOW() << "] Tx timeouts: " << num_timeouts_tx
                               << std::endl;
@@ -337,8 +438,13 @@ void benchmark_tx_rate(uhd::usrp::multi_usrp::sptr usrp,
 
 void benchmark_tx_rate_async_helper(uhd::tx_streamer::sptr tx_stream,
     const boost::posix_time::ptime& start_time,
-    std::atomic<bool>& burst_timer_elapsed)
+    std::atomic<bool>& burst_timer_elapsed,
+    bool bursts = false)
 {
+    channelsounder::apply_thread_placement("tx_async", 0);
+    channelsounder::register_metrics_thread("tx_async", 0);
+    channelsounder::register_trace_thread("tx_async", 0);
+
     // setup variables and allocate buffer
     uhd::async_metadata_t async_md;
     bool exit_flag = false;
@@ -356,17 +462,27 @@ void benchmark_tx_rate_async_helper(uhd::tx_streamer::sptr tx_stream,
 
         // handle the error codes
         switch (async_md.event_code) {
+            // every timed burst is acknowledged
             case uhd::async_metadata_t::EVENT_CODE_BURST_ACK:
+                if (bursts)
+                    break;
                 return;
 
+            case uhd::async_metadata_t::EVENT_CODE_TIME_ERROR:
+                channelsounder::add_metric(channelsounder::METRIC_TX_LATE_BURSTS, 1);
+                channelsounder::trace_instant(channelsounder::TRACE_TX_LATE_BURST, async_md.channel, 0);
+                break;
+
             case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW:
             case uhd::async_metadata_t::EVENT_CODE_UNDERFLOW_IN_PACKET:
-                num_underruns++;
+                channelsounder::add_metric(channelsounder::METRIC_TX_UNDERRUNS, 1);
+                channelsounder::trace_instant(channelsounder::TRACE_TX_UNDERFLOW, async_md.channel, 0);
                 break;
 
             case uhd::async_metadata_t::EVENT_CODE_SEQ_ERROR:
             case uhd::async_metadata_t::EVENT_CODE_SEQ_ERROR_IN_BURST:
-                num_seq_errors++;
+                channelsounder::add_metric(channelsounder::METRIC_TX_SEQUENCE_ERRORS, 1);
+                channelsounder::trace_instant(channelsounder::TRACE_TX_SEQUENCE_ERROR, async_md.channel, 0);
                 break;
 
             default:
@@ -398,6 +514,44 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
     double tx_delay, rx_delay;
     std::string priority;
     bool elevate_priority = false;
+    size_t rx_ring_slots;
+    std::string buffer_pages;
+    int buffer_numa_node;
+    bool steered_capture = false;
+    bool rx_per_mboard = false;
+    std::string thread_placement;
+    std::string writer;
+    size_t writer_queue_depth, writer_chunk_kib;
+    std::string save_paths;
+    size_t stripe_kib;
+    std::string config_file;
+    unsigned int measurements_per_sec, measurement_length, save_period_sec;
+    size_t fifo_buffers;
+    unsigned int flush_windows;
+    std::string codec;
+    size_t compression_threads;
+    std::string storage_format;
+    size_t cir_taps, cir_threads;
+    int cir_tap_offset;
+    std::string shm_name;
+    size_t shm_slots;
+    float gate_threshold_db;
+    size_t gate_pre, gate_post;
+    size_t average_windows;
+    unsigned int metrics_port;
+    double status_interval_sec;
+    std::string trace_file;
+    size_t trace_events;
+    size_t tx_burst_guard;
+    std::string tx_waveform;
+    std::string seq;
+    size_t seq_length;
+    unsigned int seq_root;
+    std::string rx_source;
+    std::string rx_replay_file;
+    double rx_snr_db;
+    size_t num_rx_pipelines = 0;
+    std::vector<uhd::rx_streamer::sptr> virtual_rx_streams;
 
     // setup the program options
     po::options_description desc("Allowed options");
@@ -432,11 +586,66 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
     // NOTE: TX delay defaults to 0.25 seconds to allow the buffer on the device to fill completely
         ("tx_delay", po::value<double>(&tx_delay)->default_value(0.25), "delay before starting TX in seconds")
         ("rx_delay", po::value<double>(&rx_delay)->default_value(0.05), "delay before starting RX in seconds")
+        ("tx_bursts", "transmit timed bursts covering only the measurement windows instead of continuously, the sequence phase follows device time")
+        ("tx_burst_guard", po::value<size_t>(&tx_burst_guard)->default_value(100), "tx samples sent before and after each measurement window with --tx_bursts")
+        ("tx_waveform", po::value<std::string>(&tx_waveform)->default_value(""), "play this file instead of the sequence, mapped and streamed without copies, seq.bin layout or raw samples of --tx_cpu with all samples of one channel after another, empty to transmit the sequence")
+        ("tx_waveform_loop", "start the waveform over at its end instead of stopping")
+        ("tx_waveform_populate", "read the whole waveform into memory before transmitting instead of reading ahead while playing")
         ("priority", po::value<std::string>(&priority)->default_value("high"), "thread priority (high, normal)")
+        ("rx_ring_slots", po::value<size_t>(&rx_ring_slots)->default_value(4), "number of slots in the RX ring buffer, spare slots absorb short stalls of the processing thread")
+        ("buffer_pages", po::value<std::string>(&buffer_pages)->default_value("4k"), "page size of all pipeline buffers (4k, 2M, 1G), hugepages must be reserved beforehand")
+        ("buffer_numa_node", po::value<int>(&buffer_numa_node)->default_value(-1), "bind all pipeline buffers to this NUMA node, ideally the node of the NIC (-1 for no binding)")
+        ("buffer_mlock", "lock all pipeline buffers into RAM")
+        ("steered_capture", "let uhd write measurements directly into the FIFO and samples between measurements into scratch memory, bypasses the RX ring buffer")
+        ("rx_per_mboard", "create one RX streamer, recv thread, ring buffer and FIFO per motherboard, files are named ch_measurement_mb<N>_*")
+        ("rx_source", po::value<std::string>(&rx_source)->default_value("uhd"), "where RX samples come from (uhd, synthetic, replay), synthetic receives the sum of the tx sequence of all tx channels plus noise and replay repeats --rx_replay_file, both in the packets uhd delivers, the device still sets rates and time")
+        ("rx_replay_file", po::value<std::string>(&rx_replay_file)->default_value(""), "recording replayed by --rx_source replay, a seq.bin or raw samples of all channels one after the other")
+        ("rx_snr_db", po::value<double>(&rx_snr_db)->default_value(20.0), "signal to noise ratio of --rx_source synthetic")
+        ("rx_unpaced", "hand out samples of --rx_source synthetic or replay as fast as the pipeline takes them instead of at --rx_rate, to find the highest rate it sustains")
+        ("thread_placement", po::value<std::string>(&thread_placement)->default_value(""), "pin threads to cores and set their scheduling policy, roles are rx, process, save, tx and tx_async, the n-th pipeline uses the n-th core (specify \"rx=2/3:fifo:90,process=4/5,save=6:other\", etc)")
+        ("mlockall", "lock all current and future pages of the process into RAM")
+        ("writer", po::value<std::string>(&writer)->default_value("ofstream"), "backend for saving measurement files (ofstream, io_uring), io_uring writes with O_DIRECT and bypasses the page cache, not available with --flush_windows or --gate_threshold_db")
+        ("writer_queue_depth", po::value<size_t>(&writer_queue_depth)->default_value(8), "number of writes in flight per file for the io_uring backend")
+        ("writer_chunk_kib", po::value<size_t>(&writer_chunk_kib)->default_value(1024), "size of a single write in KiB for the io_uring backend")
+        ("save_paths", po::value<std::string>(&save_paths)->default_value(SAVE_PATH), "output directories for measurement files, ideally one per drive (specify \"/mnt/nvme0/,/mnt/nvme1/\", etc)")
+        ("stripe_kib", po::value<size_t>(&stripe_kib)->default_value(0), "stripe each file across all save_paths in units of this many KiB, 0 to distribute whole files round robin")
+        ("config", po::value<std::string>(&config_file), "read options from this file, one \"option=value\" per line, options on the command line take precedence")
+        ("measurements_per_sec", po::value<unsigned int>(&measurements_per_sec)->default_value(1000), "number of channel measurements per second, rx_rate must be a multiple of it")
+        ("measurement_length", po::value<unsigned int>(&measurement_length)->default_value(500), "number of samples per channel measurement, 256, 500, 512 and 1024 use specialized code")
+        ("save_period_sec", po::value<unsigned int>(&save_period_sec)->default_value(10), "seconds of channel measurements per saved file")
+        ("fifo_buffers", po::value<size_t>(&fifo_buffers)->default_value(4), "number of file buffers per pipeline, a slow disk write drops files only once all of them are waiting")
+        ("flush_windows", po::value<unsigned int>(&flush_windows)->default_value(0), "append every this many measurements to the current file instead of writing whole files, bounds memory and delay to disk, 0 to write whole files")
+        ("codec", po::value<std::string>(&codec)->default_value("raw"), "lossless compression of saved files (raw, sc16_delta), sc16_delta requires --rx_cpu sc16")
+        ("compression_threads", po::value<size_t>(&compression_threads)->default_value(2), "size of the thread pool compressing files, 0 to compress in the save thread")
+        ("storage_format", po::value<std::string>(&storage_format)->default_value("native"), "format of saved windows (native, sc12, sc8, fp16), sc8 uses one exponent per window, converted on capture")
+        ("cir_taps", po::value<size_t>(&cir_taps)->default_value(0), "save this many taps of the channel impulse response per rx/tx pair instead of the samples, 0 to save the samples, requires --tx_rate equal to --rx_rate and --seq zadoff_chu or m_sequence")
+        ("cir_tap_offset", po::value<int>(&cir_tap_offset)->default_value(0), "delay of the first saved tap in samples relative to the start of the tx sequence")
+        ("cir_threads", po::value<size_t>(&cir_threads)->default_value(2), "size of the thread pool correlating windows with the tx sequence, 0 to correlate in the save thread")
+        ("shm_name", po::value<std::string>(&shm_name)->default_value(""), "publish every window live to the shared memory ring <shm_name><pipeline>, e.g. \"/channelsounder_\", read with channelsounder_shm_reader, empty to disable")
+        ("shm_slots", po::value<size_t>(&shm_slots)->default_value(1024), "windows kept in each shared memory ring")
+        ("gate_threshold_db", po::value<float>(&gate_threshold_db), "save only windows around a trigger, a window whose power averaged over all channels reaches this many dB relative to full scale, e.g. -40, requires --fifo_buffers 3 or more")
+        ("gate_pre", po::value<size_t>(&gate_pre)->default_value(10), "windows saved before each trigger of the gate")
+        ("gate_post", po::value<size_t>(&gate_post)->default_value(10), "windows saved after each trigger of the gate")
+        ("seq", po::value<std::string>(&seq)->default_value("sine_1mhz"), "tx sequence (sine_1mhz, one_and_minus_one, zadoff_chu, m_sequence, golay), zadoff_chu, m_sequence and golay are cyclically shifted per tx channel, written with its metadata to seq.bin")
+        ("seq_length", po::value<size_t>(&seq_length)->default_value(0), "complex samples per period of the tx sequence, 0 for the longest length fitting into --measurement_length and dividing the period of the measurements (legacy length for sine_1mhz and one_and_minus_one), m_sequence and golay fill the rest of the period with zeros")
+        ("seq_root", po::value<unsigned int>(&seq_root)->default_value(1), "root index of zadoff_chu, coprime to --seq_length")
+        ("average_windows", po::value<size_t>(&average_windows)->default_value(1), "save the coherent average of this many consecutive windows as one measurement, divides the rate of saved measurements, --measurements_per_sec must be a multiple of it")
+        ("metrics_port", po::value<unsigned int>(&metrics_port)->default_value(0), "serve live counters in the Prometheus text format on 127.0.0.1:<metrics_port>, 0 to disable")
+        ("status_interval_sec", po::value<double>(&status_interval_sec)->default_value(0.0), "print a one-line status with rates, errors and buffer occupancy every this many seconds, 0 to disable")
+        ("trace_file", po::value<std::string>(&trace_file)->default_value(""), "record buffer swaps, worker spans, file and error events of all pipeline threads and write them as a Chrome trace to this file at the end, empty to disable")
+        ("trace_events", po::value<size_t>(&trace_events)->default_value(65536), "events kept per thread for --trace_file, the oldest are overwritten")
     ;
     // clang-format on
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.count("config")) {
+        std::ifstream config_stream(vm["config"].as<std::string>());
+        if (not config_stream) {
+            std::cerr << "ERROR: Cannot read config file \"" << vm["config"].as<std::string>() << "\"." << std::endl;
+            return -1;
+        }
+        po::store(po::parse_config_file(config_stream, desc), vm);
+    }
     po::notify(vm);
 
     // print the help message
@@ -454,6 +663,130 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
         elevate_priority = true;
     }
 
+    // ##########################
+    // ##########################
+    // ##########################
+    // placement of all pipeline threads
+    if (not channelsounder::init_thread_placement(thread_placement)) {
+        return -1;
+    }
+    channelsounder::show_thread_placement(args);
+    if (vm.count("mlockall")) {
+        channelsounder::lock_all_memory();
+    }
+
+    // all pipeline buffers are taken from this allocator
+    channelsounder::page_size_enum page_size;
+    if (not channelsounder::parse_page_size(buffer_pages, page_size)) {
+        std::cerr << "ERROR: Unknown page size \"" << buffer_pages << "\"." << std::endl;
+        return -1;
+    }
+    if (not channelsounder::init_buffer_allocator(page_size, buffer_numa_node, vm.count("buffer_mlock") > 0)) {
+        return -1;
+    }
+
+    // measurement files are saved through this writer
+    channelsounder::writer_backend_enum writer_backend;
+    if (not channelsounder::parse_writer_backend(writer, writer_backend)) {
+        std::cerr << "ERROR: Unknown writer \"" << writer << "\"." << std::endl;
+        return -1;
+    }
+    // piecewise files are written with pwrite through the page cache by the save thread, io_uring would be silently ignored
+    if (writer_backend == channelsounder::WRITER_IO_URING and (flush_windows > 0 or vm.count("gate_threshold_db") > 0)) {
+        std::cerr << "ERROR: --flush_windows and --gate_threshold_db write files piecewise through the page cache, use --writer ofstream." << std::endl;
+        return -1;
+    }
+    std::vector<std::string> save_path_list;
+    boost::split(save_path_list, save_paths, boost::is_any_of("\"',"), boost::token_compress_on);
+    save_path_list.erase(std::remove(save_path_list.begin(), save_path_list.end(), ""), save_path_list.end());
+    if (not channelsounder::init_file_writer(writer_backend, writer_queue_depth, writer_chunk_kib*1024, save_path_list, stripe_kib*1024)) {
+        return -1;
+    }
+
+    // files are compressed between fifo swap and writer
+    uint32_t codec_id;
+    if (not channelsounder::parse_codec(codec, codec_id)) {
+        std::cerr << "ERROR: Unknown codec \"" << codec << "\"." << std::endl;
+        return -1;
+    }
+    channelsounder::init_compression(codec_id, compression_threads);
+
+    // windows are converted when captured, so the fifo buffers only hold the stored format
+    uint32_t storage_format_id;
+    if (not channelsounder::parse_storage_format(storage_format, storage_format_id)) {
+        std::cerr << "ERROR: Unknown storage format \"" << storage_format << "\"." << std::endl;
+        return -1;
+    }
+    channelsounder::init_storage_format(storage_format_id);
+
+    // sequence transmitted by all tx channels
+    uint32_t seq_type;
+    if (not channelsounder::parse_sequence_type(seq, seq_type)) {
+        std::cerr << "ERROR: Unknown sequence \"" << seq << "\"." << std::endl;
+        return -1;
+    }
+
+    // the reference is generated at the tx rate and correlated with windows at the rx rate
+    if (cir_taps > 0) {
+        if (vm.count("rx_rate") == 0 or vm.count("tx_rate") == 0 or tx_rate != rx_rate) {
+            std::cerr << "ERROR: --cir_taps requires --tx_rate equal to --rx_rate." << std::endl;
+            return -1;
+        }
+        // golay pairs only cancel their sidelobes if a and b are received separately, the live correlation sees [a b] as one sequence
+        if (seq_type != SEQ_TYPE_ZADOFF_CHU and seq_type != SEQ_TYPE_M_SEQUENCE) {
+            std::cerr << "ERROR: --cir_taps requires --seq zadoff_chu or m_sequence." << std::endl;
+            return -1;
+        }
+    }
+
+    // windows out of range of the tx are left out of the files
+    if (not channelsounder::init_window_gate(vm.count("gate_threshold_db") > 0, vm.count("gate_threshold_db") ? gate_threshold_db : 0.0f, gate_pre, gate_post)) {
+        return -1;
+    }
+
+    // static channels are saved at a lower rate and higher snr
+    if (not channelsounder::init_window_average(average_windows)) {
+        return -1;
+    }
+
+    // local readers tail the windows without slowing down the recorder
+    if (not channelsounder::init_shm_publisher(shm_name, shm_slots)) {
+        return -1;
+    }
+
+    // live counters of all pipeline threads, read without touching them
+    if (not channelsounder::init_metrics(metrics_port, status_interval_sec)) {
+        return -1;
+    }
+    channelsounder::init_latency_histogram();
+    
+    // flight recorder of the pipeline threads, cheap enough to be left on
+    if (not channelsounder::init_event_trace(trace_file, trace_events)) {
+        return -1;
+    }
+    // ##########
+    // ##########
+    // ##########
+
+    // ##########################
+    // ##########################
+    // ##########################
+    if (vm.count("steered_capture")) {
+        std::cout << "Channelsounder: Using steered capture." << std::endl;
+        steered_capture = true;
+    }
+    if (vm.count("rx_per_mboard")) {
+        std::cout << "Channelsounder: Using one RX pipeline per motherboard." << std::endl;
+        rx_per_mboard = true;
+    }
+    if (rx_source != "uhd" and rx_source != "synthetic" and rx_source != "replay") {
+        std::cerr << "ERROR: Unknown RX source \"" << rx_source << "\"." << std::endl;
+        return -1;
+    }
+    // ##########
+    // ##########
+    // ##########
+
     // Random number of samples?
     if (vm.count("random")) {
         std::cout << "Using random number of samples in send() and recv() calls."
@@ -668,38 +1001,125 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
         // ##########
         // ##########         
         
-        // create a receive streamer
-        uhd::stream_args_t stream_args(rx_cpu, rx_otw);
-        stream_args.channels             = rx_channel_nums;
-        uhd::rx_streamer::sptr rx_stream = usrp->get_rx_stream(stream_args);        
-
         // ##########################
         // ##########################
-        // ##########################        
-        // initialize save and send fifo
-        channelsounder::init_fifo_ch_measurement(rx_stream->get_num_channels(), uhd::convert::get_bytes_per_item(rx_cpu), rx_rate);
-        auto save_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {channelsounder::send_save_ch_measurements(burst_timer_elapsed);});
-        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
-
-        // initialize ring buffer rx
-        channelsounder::init_ringbuffer_rx(rx_stream->get_num_channels(), uhd::convert::get_bytes_per_item(rx_cpu), rx_stream->get_max_num_samps());
-        auto process_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {channelsounder::process_ringbuffer_rx(burst_timer_elapsed);});
-        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+        // ##########################
+        // either all channels in one pipeline or one pipeline per motherboard
+        std::vector<std::vector<size_t>> rx_channel_groups;
+        if (rx_per_mboard) {
+            size_t mboard_first_chan = 0;
+            for (int mb = 0; mb < num_mboards; mb++) {
+                const size_t mboard_num_chans = usrp->get_rx_subdev_spec(mb).size();
+                std::vector<size_t> group;
+                for (size_t ch = 0; ch < rx_channel_nums.size(); ch++) {
+                    if (rx_channel_nums[ch] >= mboard_first_chan and rx_channel_nums[ch] < mboard_first_chan + mboard_num_chans)
+                        group.push_back(rx_channel_nums[ch]);
+                }
+                if (not group.empty())
+                    rx_channel_groups.push_back(group);
+                mboard_first_chan += mboard_num_chans;
+            }
+        } else {
+            rx_channel_groups.push_back(rx_channel_nums);
+        }
+        if (rx_channel_groups.size() > MAX_PIPELINES) {
+            std::cerr << "ERROR: More RX pipelines than MAX_PIPELINES." << std::endl;
+            return -1;
+        }
+
+        // the reference is set once the tx sequence is generated
+        const size_t cir_tx_channels = vm.count("tx_rate") ? tx_channel_nums.size() : 0;
+        if (not channelsounder::init_cir_extraction(cir_taps, cir_tap_offset, cir_tx_channels, measurement_length, cir_threads)) {
+            return -1;
+        }
         // ##########
         // ##########
-        // ##########        
-        
-        auto rx_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {
-            benchmark_rx_rate(usrp,
-                rx_cpu,
-                rx_stream,
-                random_nsamps,
-                start_time,
-                burst_timer_elapsed,
-                elevate_priority,
-                rx_delay);
-        });
-        uhd::set_thread_name(rx_thread, "bmark_rx_stream");
+        // ##########
+
+        for (size_t id = 0; id < rx_channel_groups.size(); id++) {
+            // create a receive streamer
+            uhd::stream_args_t stream_args(rx_cpu, rx_otw);
+            stream_args.channels             = rx_channel_groups[id];
+            uhd::rx_streamer::sptr rx_stream;
+            
+            // ##########################
+            // ##########################
+            // ##########################
+            // or a virtual streamer standing in for the rx of the device
+            if (rx_source == "uhd") {
+                rx_stream = usrp->get_rx_stream(stream_args);
+            } else {
+                channelsounder::virtual_rx_streamer* virtual_rx = new channelsounder::virtual_rx_streamer(rx_channel_groups[id].size(), uhd::convert::get_bytes_per_item(rx_cpu),
+                    usrp->get_rx_rate(), VIRTUAL_RX_MAX_SAMPS, vm.count("rx_unpaced") == 0, VIRTUAL_RX_BUFFER_SEC);
+                rx_stream = uhd::rx_streamer::sptr(virtual_rx);
+                if (rx_source == "synthetic") {
+                    const size_t seq_length_rx = seq_length ? seq_length : channelsounder::get_matching_sequence_length((unsigned long long) rx_rate/measurements_per_sec, measurement_length);
+                    std::vector<std::vector<std::complex<float>>> seq_rx;
+                    size_t n_active, cyclic_shift;
+                    if (not channelsounder::generate_sequence_period(seq_type, seq_length_rx, std::max<size_t>(1, cir_tx_channels), rx_rate, seq_root, seq_rx, n_active, cyclic_shift)
+                        or not virtual_rx->init_synthetic(seq_rx, rx_snr_db)) {
+                        return -1;
+                    }
+                } else if (not virtual_rx->init_replay(rx_replay_file)) {
+                    return -1;
+                }
+                virtual_rx_streams.push_back(rx_stream);
+            }
+            // ##########
+            // ##########
+            // ##########
+
+            // ##########################
+            // ##########################
+            // ##########################
+            // initialize save and send fifo
+            std::string file_prefix = "ch_measurement_";
+            if (rx_per_mboard)
+                file_prefix = str(boost::format("ch_measurement_mb%u_") % id);
+            if (not channelsounder::init_fifo_ch_measurement(rx_stream->get_num_channels(), uhd::convert::get_bytes_per_item(rx_cpu), rx_rate,
+                    measurements_per_sec, measurement_length, save_period_sec, fifo_buffers, flush_windows, file_prefix, id)) {
+                return -1;
+            }
+            auto save_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {
+                channelsounder::apply_thread_placement("save", id);
+                channelsounder::register_metrics_thread("save", id);
+                channelsounder::register_trace_thread("save", id);
+                channelsounder::send_save_ch_measurements(burst_timer_elapsed, id);
+            });
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+
+            // initialize ring buffer rx, in steered capture uhd writes directly into the fifo instead
+            if (steered_capture) {
+                channelsounder::init_steered_capture(rx_stream->get_max_num_samps(), id);
+            } else {
+                channelsounder::init_ringbuffer_rx(rx_stream->get_num_channels(), uhd::convert::get_bytes_per_item(rx_cpu), rx_stream->get_max_num_samps(), rx_ring_slots, id);
+                auto process_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {
+                    channelsounder::apply_thread_placement("process", id);
+                    channelsounder::register_metrics_thread("process", id);
+                    channelsounder::register_trace_thread("process", id);
+                    channelsounder::process_ringbuffer_rx(burst_timer_elapsed, id);
+                });
+                boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+            }
+            // ##########
+            // ##########
+            // ##########        
+            
+            auto rx_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {
+                benchmark_rx_rate(usrp,
+                    rx_cpu,
+                    rx_stream,
+                    random_nsamps,
+                    start_time,
+                    burst_timer_elapsed,
+                    elevate_priority,
+                    rx_delay,
+                    steered_capture,
+                    id);
+            });
+            uhd::set_thread_name(rx_thread, "bmark_rx_stream");
+        }
+        num_rx_pipelines = rx_channel_groups.size();
     }
     
     // ##########################
@@ -741,11 +1161,65 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
         // ##########################
         // ##########################        
         // initialize ring buffer tx
-        channelsounder::init_ringbuffer_tx(tx_stream->get_num_channels(), uhd::convert::get_bytes_per_item(tx_cpu), tx_stream->get_max_num_samps(), tx_rate);
+        // by default a whole period fits into a measurement and repeats at the same phase in each of them
+        size_t seq_length_tx = seq_length;
+        if (seq_length_tx == 0 and seq_type != SEQ_TYPE_SINE_1MHZ and seq_type != SEQ_TYPE_ONE_AND_MINUS_ONE)
+            seq_length_tx = channelsounder::get_matching_sequence_length((unsigned long long) tx_rate/measurements_per_sec, measurement_length);
+        if (not tx_waveform.empty()) {
+            if (vm.count("tx_bursts") or cir_taps > 0) {
+                std::cerr << "ERROR: A waveform can neither be sent in bursts nor be used for the cir extraction." << std::endl;
+                return -1;
+            }
+            if (not channelsounder::init_ringbuffer_tx_waveform(tx_stream->get_num_channels(), uhd::convert::get_bytes_per_item(tx_cpu), tx_stream->get_max_num_samps(),
+                                                                tx_waveform, vm.count("tx_waveform_loop") > 0, vm.count("tx_waveform_populate") > 0)) {
+                return -1;
+            }
+        } else if (not channelsounder::init_ringbuffer_tx(tx_stream->get_num_channels(), uhd::convert::get_bytes_per_item(tx_cpu), tx_stream->get_max_num_samps(), tx_rate,
+                                                          seq_type, seq_length_tx, seq_root)) {
+            return -1;
+        }
+
+        // measurement files record which sequence was transmitted
+        std::string seq_name;
+        unsigned long long seq_length, seq_checksum;
+        channelsounder::get_sequence_identity(seq_name, seq_length, seq_checksum);
+        for (size_t id = 0; id < num_rx_pipelines; id++)
+            channelsounder::set_sequence_identity_fifo(seq_name, seq_length, seq_checksum, id);
+
+        // reference of the cir extraction, the device may have rounded the rates differently
+        if (cir_taps > 0 and usrp->get_tx_rate() != usrp->get_rx_rate()) {
+            std::cerr << boost::format("ERROR: --cir_taps requires equal rates, the device set %f Msps for TX and %f Msps for RX.") % (usrp->get_tx_rate()/1e6) % (usrp->get_rx_rate()/1e6) << std::endl;
+            return -1;
+        }
+        std::vector<std::vector<std::complex<float>>> seq;
+        channelsounder::get_sequence(seq);
+        if (not channelsounder::set_cir_sequence(seq)) {
+            return -1;
+        }
         // ##########
         // ##########
         // ##########           
         
+        // bursts follow the schedule of the fifo, the link only carries the measurement windows and their guards
+        size_t tx_burst_period = 0, tx_burst_length = 0;
+        const bool tx_bursts = vm.count("tx_bursts") > 0;
+        if (tx_bursts) {
+            const double tx_per_rx = vm.count("rx_rate") ? tx_rate/rx_rate : 1.0;
+            if (std::fmod(tx_rate, (double) measurements_per_sec) != 0.0) {
+                std::cerr << "ERROR: TX rate must be a multiple of the measurements per second for --tx_bursts." << std::endl;
+                return -1;
+            }
+            tx_burst_period = (size_t) (tx_rate/measurements_per_sec);
+            tx_burst_length = (size_t) std::ceil(measurement_length*tx_per_rx) + 2*tx_burst_guard;
+            if (tx_burst_length >= tx_burst_period) {
+                std::cerr << "ERROR: Bursts of " << tx_burst_length << " samples would overlap with a period of " << tx_burst_period << " samples, transmit continuously instead." << std::endl;
+                return -1;
+            }
+            std::cout << boost::format("[%s] TX bursts of %u samples every %u samples, duty cycle %f")
+                             % NOW() % tx_burst_length % tx_burst_period % ((double) tx_burst_length/tx_burst_period)
+                      << std::endl;
+        }
+        
         auto tx_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {
             benchmark_tx_rate(usrp,
                 tx_cpu,
@@ -754,15 +1228,30 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
                 start_time,
                 elevate_priority,
                 tx_delay,
+                tx_burst_period,
+                tx_burst_length,
+                tx_burst_guard,
                 random_nsamps);
         });
         uhd::set_thread_name(tx_thread, "bmark_tx_stream");
         auto tx_async_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {
-            benchmark_tx_rate_async_helper(tx_stream, start_time, burst_timer_elapsed);
+            benchmark_tx_rate_async_helper(tx_stream, start_time, burst_timer_elapsed, tx_bursts);
         });
         uhd::set_thread_name(tx_async_thread, "bmark_tx_helper");
     }
 
+    // ##########################
+    // ##########################
+    // ##########################
+    if (channelsounder::is_metrics_enabled()) {
+        thread_group.create_thread([&burst_timer_elapsed]() {
+            channelsounder::serve_metrics(burst_timer_elapsed);
+        });
+    }
+    // ##########
+    // ##########
+    // ##########
+
     // sleep for the required duration (add any initial delay)
     if (vm.count("rx_rate") and vm.count("tx_rate")) {
         duration += std::max(rx_delay, tx_delay);
@@ -783,9 +1272,26 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
     // ##########################
     // ##########################
     // ##########################
-    channelsounder::show_debug_information_ringbuffer_rx();
-    channelsounder::show_debug_information_fifo();
+    channelsounder::write_event_trace();
+    channelsounder::show_debug_information_buffer_allocator();
+    channelsounder::show_debug_information_file_writer();
+    channelsounder::show_debug_information_compression();
+    channelsounder::show_debug_information_storage_format();
+    channelsounder::show_debug_information_cir_extraction();
+    channelsounder::show_debug_information_window_gate();
+    channelsounder::show_debug_information_window_average();
+    for (size_t id = 0; id < num_rx_pipelines; id++) {
+        if (not steered_capture)
+            channelsounder::show_debug_information_ringbuffer_rx(id);
+        channelsounder::show_debug_information_fifo(id);
+        channelsounder::show_debug_information_shm_publisher(id);
+    }
     channelsounder::show_debug_information_ringbuffer_tx();
+    for (size_t i = 0; i < virtual_rx_streams.size(); i++)
+        static_cast<channelsounder::virtual_rx_streamer*>(virtual_rx_streams[i].get())->show_debug_information();
+    channelsounder::show_debug_information_metrics();
+    channelsounder::show_debug_information_latency_histogram();
+    channelsounder::show_debug_information_event_trace();
     // ##########
     // ##########
     // ##########
@@ -793,6 +1299,18 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
     std::cout << "[" << NOW() << "] Benchmark complete." << std::endl << std::endl;
 
     // print summary
+    const unsigned long long num_overruns      = channelsounder::get_metric_total(channelsounder::METRIC_RX_OVERRUNS);
+    const unsigned long long num_underruns     = channelsounder::get_metric_total(channelsounder::METRIC_TX_UNDERRUNS);
+    const unsigned long long num_rx_samps      = channelsounder::get_metric_total(channelsounder::METRIC_RX_SAMPLES);
+    const unsigned long long num_tx_samps      = channelsounder::get_metric_total(channelsounder::METRIC_TX_SAMPLES);
+    const unsigned long long num_dropped_samps = channelsounder::get_metric_total(channelsounder::METRIC_RX_DROPPED_SAMPLES);
+    const unsigned long long num_seq_errors    = channelsounder::get_metric_total(channelsounder::METRIC_TX_SEQUENCE_ERRORS);
+    const unsigned long long num_seqrx_errors  = channelsounder::get_metric_total(channelsounder::METRIC_RX_SEQUENCE_ERRORS); // "D"s
+    const unsigned long long num_late_commands = channelsounder::get_metric_total(channelsounder::METRIC_RX_LATE_COMMANDS);
+    const unsigned long long num_timeouts_rx   = channelsounder::get_metric_total(channelsounder::METRIC_RX_TIMEOUTS);
+    const unsigned long long num_timeouts_tx   = channelsounder::get_metric_total(channelsounder::METRIC_TX_TIMEOUTS);
+    const unsigned long long num_tx_bursts     = channelsounder::get_metric_total(channelsounder::METRIC_TX_BURSTS);
+    const unsigned long long num_late_bursts   = channelsounder::get_metric_total(channelsounder::METRIC_TX_LATE_BURSTS);
     const std::string threshold_err(" ERROR: Exceeds threshold!");
     const bool overrun_threshold_err = vm.count("overrun-threshold")
                                        and num_overruns > overrun_threshold;
@@ -813,10 +1331,13 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
                                "  Num underruns detected:   %u\n"
                                "  Num late commands:        %u\n"
                                "  Num timeouts (Tx):        %u\n"
-                               "  Num timeouts (Rx):        %u\n")
+                               "  Num timeouts (Rx):        %u\n"
+                               "  Num bursts (Tx):          %u\n"
+                               "  Num late bursts (Tx):     %u\n")
                      % num_rx_samps % num_dropped_samps % num_overruns % num_tx_samps
                      % num_seq_errors % num_seqrx_errors % num_underruns
                      % num_late_commands % num_timeouts_tx % num_timeouts_rx
+                     % num_tx_bursts % num_late_bursts
               << std::endl;
     // finished
     std::cout << std::endl << "Done!" << std::endl << std::endl;
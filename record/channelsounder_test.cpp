@@ -23,14 +23,55 @@
 
 #include "ringbuffer_rx.h"
 #include "fifo_ch_measurement.h"
+#include "buffer_allocator.h"
+#include "file_writer.h"
+#include "compression.h"
+#include "storage_format.h"
+#include "cir_extraction.h"
+#include "shm_publisher.h"
+#include "metrics.h"
+#include "latency_histogram.h"
+#include "event_trace.h"
+#include "virtual_rx_streamer.h"
+#include "sequence.h"
+#include "seq_format.h"
+#include "window_gate.h"
+#include "window_average.h"
+#include "ch_measurement_format.h"
+#include "config.h"
 
 #define DURATION_SEC            120             // actual execution time of this test programm
 #define N_CHANNELS              4               // number of channels/antennas
 #define N_BYTES_PER_ITEM        4               // 4 for complex int16_t and 8 for float
-#define N_MIN_SAMPLES           2000            // minimum number of samples passed to ringbuffer
-#define N_MAX_SAMPLES           10000           // maximum number of samples passed to ringbuffer
-#define RX_RATE                 200000000       // target samp_rate, test programm likely much slower
-#define ITEM_CNT_MAX            1000
+#define N_MAX_SAMPLES           VIRTUAL_RX_MAX_SAMPS    // samples per packet of the virtual streamer
+#define RX_RATE                 200000000       // target samp_rate
+#define RX_PACED                true            // false to receive as fast as the pipeline takes the samples, to find its highest sustainable rate
+#define RX_BUFFER_SEC           VIRTUAL_RX_BUFFER_SEC   // paced, lag of the pipeline after which samples are dropped with an overflow
+#define RX_REPLAY_FILE          ""              // e.g. "../data/seq.bin" or a raw recording, empty to receive the sequence plus noise
+#define RX_SNR_DB               20.0            // of the sequence plus noise
+#define N_TX_CHANNELS           2               // channels of the sequence, received as their sum
+#define OVERFLOW_INTERVAL_SEC   0               // e.g. 10 to inject an overflow losing OVERFLOW_SAMPLES every 10 s
+#define OVERFLOW_SAMPLES        1000            // "
+#define MEASUREMENTS_PER_SEC    1000            // measurement schedule of the fifo
+#define MEASUREMENT_LENGTH      500             // "
+#define SAVE_PERIOD_SEC         10              // "
+#define N_FIFO_BUFFERS          4               // file buffers of the fifo
+#define FLUSH_WINDOWS           0               // e.g. 100 to append chunks of 100 measurements to the current file
+#define N_RX_RING_SLOTS         4               // depth of the rx ring buffer
+#define STEERED_CAPTURE         0               // 1 to write measurements directly into the fifo, bypasses the rx ring buffer
+#define WRITER_BACKEND          channelsounder::WRITER_OFSTREAM // or channelsounder::WRITER_IO_URING
+#define CODEC                   CH_MEASUREMENT_CODEC_RAW        // or CH_MEASUREMENT_CODEC_SC16_DELTA
+#define COMPRESSION_THREADS     2
+#define STORAGE_FORMAT          CH_MEASUREMENT_STORAGE_NATIVE   // or CH_MEASUREMENT_STORAGE_SC12, _SC8, _FP16
+#define CIR_TAPS                0               // no tx in this test, the taps would be zero
+#define SHM_NAME                ""              // e.g. "/channelsounder_test_" to watch with channelsounder_shm_reader
+#define GATE                    false           // true to save only windows around a trigger, needs N_FIFO_BUFFERS >= 3
+#define GATE_THRESHOLD_DB       -40.0f          // "
+#define AVERAGE_WINDOWS         1               // e.g. 20 to save the average of 20 windows, MEASUREMENTS_PER_SEC must be a multiple of it
+#define METRICS_PORT            0               // e.g. 9100 to scrape http://127.0.0.1:9100/metrics while the test runs
+#define STATUS_INTERVAL_SEC     1.0             // one-line status every second, 0 to disable
+#define TRACE_FILE              ""              // e.g. "trace.json" to open with ui.perfetto.dev after the test
+#define TRACE_EVENTS            65536           // events kept per thread
 
 /***********************************************************************
  * Test result variables
@@ -40,73 +81,62 @@
 /***********************************************************************
  * Benchmark RX Rate
  **********************************************************************/
-void benchmark_RX_RATE(std::atomic<bool>& burst_timer_elapsed)
+void benchmark_RX_RATE(uhd::rx_streamer::sptr rx_stream, std::atomic<bool>& burst_timer_elapsed)
 {
+    uhd::rx_metadata_t md;
     unsigned long long n_new_samples = 0;       // number of samples passed to ringbuffer
-    unsigned long long num_rx_samps = 0;        // uhd counter of all samples
-    unsigned long long item_cnt = 0;
+    long long tick = 0;                         // device time of the first new sample
     
-    std::vector<void*> buffs = channelsounder::get_ringbuffer_rx_pointers(0);
+    size_t n_samples_max = rx_stream->get_max_num_samps();     // in steered capture the fifo limits the number of samples
     
-    while (burst_timer_elapsed == false){
-        
-        // we measure the execution time to follow sampling rate as close as possible
-        std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
-        
-        // the number of samples generated by uhd can vary
-        n_new_samples = rand() % (N_MAX_SAMPLES - N_MIN_SAMPLES) + N_MIN_SAMPLES;
-
-        if (N_BYTES_PER_ITEM == 4){
-
-            std::vector<int16_t*> buff_s16;
-
-            // set samples consecutively (2 -> complex samples)
-            for(int i=0; i<N_CHANNELS; i++){
-                
-                buff_s16.push_back(static_cast<int16_t*>(buffs[i]));
-                
-                for(int j=0; j<n_new_samples*2; j=j+2){
-                    buff_s16[i][j] = (int16_t) item_cnt;       // real
-                    buff_s16[i][j+1] = (int16_t) item_cnt;     // imag
-                    
-                    item_cnt++;
-                    item_cnt = item_cnt % ITEM_CNT_MAX;
-                }
-            }
-        }
-        else if(N_BYTES_PER_ITEM == 8){
-            
-            std::vector<float*> buff_f32;
-
-            // set samples consecutively (2 -> complex samples)
-            for(int i=0; i<N_CHANNELS; i++){
-                
-                buff_f32.push_back(static_cast<float*>(buffs[i]));
-                
-                for(int j=0; j<n_new_samples*2; j=j+2){
-                    buff_f32[i][j] = (float) item_cnt;          // real
-                    buff_f32[i][j+1] = (float) item_cnt;        // imag
-                    
-                    item_cnt++;
-                    item_cnt = item_cnt % ITEM_CNT_MAX;
-                }
-            }
-        }
-        else{
-            std::cerr << "Unknown data type." << std::endl;
+    channelsounder::register_metrics_thread("rx", 0);
+    channelsounder::register_trace_thread("rx", 0);
+    
+    std::vector<void*> buffs;
+    if (STEERED_CAPTURE == 1)
+        buffs = channelsounder::get_fifo_ch_measurement_pointers(0, tick, n_samples_max, 0);
+    else
+        buffs = channelsounder::get_ringbuffer_rx_pointers(0, tick, 0);
+    
+    uhd::stream_cmd_t cmd(uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS);
+    cmd.stream_now = true;
+    rx_stream->issue_stream_cmd(cmd);
+    
+    bool stop_called = false;
+    while (true){
+        if (burst_timer_elapsed and not stop_called) {
+            rx_stream->issue_stream_cmd(uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS);
+            stop_called = true;
         }
-        num_rx_samps += n_new_samples * N_CHANNELS;
+        
+        // the virtual streamer follows RX_RATE like a device, or runs as fast as the pipeline takes the samples
+        n_new_samples = rx_stream->recv(buffs, n_samples_max, md, 0.1);
+        channelsounder::add_metric(channelsounder::METRIC_RX_SAMPLES, n_new_samples * N_CHANNELS);
+        if (n_new_samples > 0)
+            tick = md.time_spec.to_ticks(RX_RATE);
 
         // refresh pointers for next call of rx_stream->recv()
-        buffs = channelsounder::get_ringbuffer_rx_pointers(n_new_samples);
+        if (STEERED_CAPTURE == 1)
+            buffs = channelsounder::get_fifo_ch_measurement_pointers(n_new_samples, tick, n_samples_max, 0);
+        else
+            buffs = channelsounder::get_ringbuffer_rx_pointers(n_new_samples, tick, 0);
         
-        // try to follow RX_RATE, but probably mush slower
-        std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
-        double time_it_took_us = 1e6 * (double) std::chrono::duration_cast<std::chrono::seconds>(t2 - t1).count();
-        double time_it_should_have_taken_us = 1e6 * (double) n_new_samples/ (double) RX_RATE;
-        double time_difference_us = time_it_should_have_taken_us - time_it_took_us;
-        if(time_difference_us > 0)
-            boost::this_thread::sleep_for(boost::chrono::microseconds((unsigned int) time_difference_us));
+        switch (md.error_code) {
+            case uhd::rx_metadata_t::ERROR_CODE_NONE:
+                if (stop_called and md.end_of_burst)
+                    return;
+                break;
+            
+            case uhd::rx_metadata_t::ERROR_CODE_OVERFLOW:
+                channelsounder::add_metric(channelsounder::METRIC_RX_OVERRUNS, 1);
+                channelsounder::trace_instant(channelsounder::TRACE_RX_OVERFLOW, md.time_spec.to_ticks(RX_RATE), 0);
+                break;
+            
+            default:
+                if (stop_called)
+                    return;
+                break;
+        }
     }
 }
 
@@ -135,21 +165,61 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
 
     boost::thread_group thread_group;   
 
+    // all pipeline buffers are taken from this allocator
+    channelsounder::init_buffer_allocator(channelsounder::PAGES_4KB, -1, false);
+    channelsounder::init_file_writer(WRITER_BACKEND, 8, 1024*1024, std::vector<std::string>(1, SAVE_PATH), 0);
+    channelsounder::init_compression(CODEC, COMPRESSION_THREADS);
+    channelsounder::init_storage_format(STORAGE_FORMAT);
+    channelsounder::init_cir_extraction(CIR_TAPS, 0, 1, MEASUREMENT_LENGTH, 2);
+    channelsounder::init_shm_publisher(SHM_NAME, 1024);
+    channelsounder::init_window_gate(GATE, GATE_THRESHOLD_DB, 10, 10);
+    channelsounder::init_window_average(AVERAGE_WINDOWS);
+    channelsounder::init_metrics(METRICS_PORT, STATUS_INTERVAL_SEC);
+    channelsounder::init_latency_histogram();
+    channelsounder::init_event_trace(TRACE_FILE, TRACE_EVENTS);
+
+    // samples come from a virtual streamer instead of a device, in the packets uhd would deliver
+    channelsounder::virtual_rx_streamer* virtual_rx = new channelsounder::virtual_rx_streamer(N_CHANNELS, N_BYTES_PER_ITEM, RX_RATE, N_MAX_SAMPLES, RX_PACED, RX_BUFFER_SEC);
+    uhd::rx_streamer::sptr rx_stream(virtual_rx);
+    if (std::string(RX_REPLAY_FILE).empty()) {
+        std::vector<std::vector<std::complex<float>>> seq;
+        size_t n_active, cyclic_shift;
+        const size_t seq_length = channelsounder::get_matching_sequence_length(RX_RATE/MEASUREMENTS_PER_SEC, MEASUREMENT_LENGTH);
+        if (not channelsounder::generate_sequence_period(SEQ_TYPE_ZADOFF_CHU, seq_length, N_TX_CHANNELS, RX_RATE, 1, seq, n_active, cyclic_shift)
+            or not virtual_rx->init_synthetic(seq, RX_SNR_DB)) {
+            return -1;
+        }
+    } else if (not virtual_rx->init_replay(RX_REPLAY_FILE)) {
+        return -1;
+    }
+
     // spawn the receive test thread
     if (1==1) {
        
         // initialize save and send fifo
-        channelsounder::init_fifo_ch_measurement(N_CHANNELS, N_BYTES_PER_ITEM, RX_RATE);
-        auto save_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {channelsounder::send_save_ch_measurements(burst_timer_elapsed);});
+        channelsounder::init_fifo_ch_measurement(N_CHANNELS, N_BYTES_PER_ITEM, RX_RATE, MEASUREMENTS_PER_SEC, MEASUREMENT_LENGTH, SAVE_PERIOD_SEC, N_FIFO_BUFFERS, FLUSH_WINDOWS, "ch_measurement_", 0);
+        auto save_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {
+            channelsounder::register_metrics_thread("save", 0);
+            channelsounder::register_trace_thread("save", 0);
+            channelsounder::send_save_ch_measurements(burst_timer_elapsed, 0);
+        });
         boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
 
-        // initialize ring buffer
-        channelsounder::init_ringbuffer_rx(N_CHANNELS, N_BYTES_PER_ITEM, N_MAX_SAMPLES);
-        auto process_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {channelsounder::process_ringbuffer_rx(burst_timer_elapsed);});
-        boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+        // initialize ring buffer, in steered capture samples are written directly into the fifo instead
+        if (STEERED_CAPTURE == 1) {
+            channelsounder::init_steered_capture(N_MAX_SAMPLES, 0);
+        } else {
+            channelsounder::init_ringbuffer_rx(N_CHANNELS, N_BYTES_PER_ITEM, N_MAX_SAMPLES, N_RX_RING_SLOTS, 0);
+            auto process_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {
+                channelsounder::register_metrics_thread("process", 0);
+                channelsounder::register_trace_thread("process", 0);
+                channelsounder::process_ringbuffer_rx(burst_timer_elapsed, 0);
+            });
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+        }
         
         auto rx_thread = thread_group.create_thread([=, &burst_timer_elapsed]() {
-            benchmark_RX_RATE(burst_timer_elapsed);
+            benchmark_RX_RATE(rx_stream, burst_timer_elapsed);
         });
     }
     
@@ -166,18 +236,41 @@ int UHD_SAFE_MAIN(int argc, char* argv[])
         });
     }
 
-    // sleep for the required duration (add any initial delay)
-    const int64_t secs  = int64_t(duration);
-    const int64_t usecs = int64_t((duration - secs) * 1e6);
-    std::this_thread::sleep_for(
-        std::chrono::seconds(secs) + std::chrono::microseconds(usecs));    
+    if (channelsounder::is_metrics_enabled()) {
+        thread_group.create_thread([&burst_timer_elapsed]() {channelsounder::serve_metrics(burst_timer_elapsed);});
+    }
+
+    // sleep for the required duration, overflows are injected meanwhile
+    const std::chrono::steady_clock::time_point t_end = std::chrono::steady_clock::now() + std::chrono::microseconds((long long) (duration * 1e6));
+    std::chrono::steady_clock::time_point t_overflow = std::chrono::steady_clock::now() + std::chrono::seconds(OVERFLOW_INTERVAL_SEC);
+    while (std::chrono::steady_clock::now() < t_end) {
+        if (OVERFLOW_INTERVAL_SEC > 0 and std::chrono::steady_clock::now() >= t_overflow) {
+            virtual_rx->inject_overflow(OVERFLOW_SAMPLES);
+            t_overflow += std::chrono::seconds(OVERFLOW_INTERVAL_SEC);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
 
     // interrupt and join the threads
     burst_timer_elapsed = true;
     thread_group.join_all();
+    channelsounder::write_event_trace();
     
-    channelsounder::show_debug_information_ringbuffer_rx();
-    channelsounder::show_debug_information_fifo();
+    channelsounder::show_debug_information_buffer_allocator();
+    channelsounder::show_debug_information_file_writer();
+    channelsounder::show_debug_information_compression();
+    channelsounder::show_debug_information_storage_format();
+    channelsounder::show_debug_information_cir_extraction();
+    channelsounder::show_debug_information_window_gate();
+    channelsounder::show_debug_information_window_average();
+    if (STEERED_CAPTURE == 0)
+        channelsounder::show_debug_information_ringbuffer_rx(0);
+    channelsounder::show_debug_information_fifo(0);
+    virtual_rx->show_debug_information();
+    channelsounder::show_debug_information_shm_publisher(0);
+    channelsounder::show_debug_information_metrics();
+    channelsounder::show_debug_information_latency_histogram();
+    channelsounder::show_debug_information_event_trace();
     
     std::cout << "Test samples generated and written to file. Switch to MATLAB to finish testing." << std::endl;
     
@@ -0,0 +1,332 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <cmath>
+#include <cstring>
+#include <boost/thread/thread.hpp>
+
+#include "cir_extraction.h"
+#include "job_pool.h"
+
+// windows of one channel per job
+#define CIR_JOB_WINDOWS     64
+
+namespace channelsounder
+{
+// radix-2 fft, real and imag are kept in separate arrays so the butterflies of a stage are vectorized by the compiler
+struct fft_plan{
+    size_t n;
+    std::vector<uint32_t> bitrev;
+    std::vector<float> tw_re;           // twiddles of the stage with half size h start at index h
+    std::vector<float> tw_im;           // "
+};
+
+// conj(fft(q))/(n_fft*energy) of each tx sequence, q is the sequence delayed and repeated over the window, see set_cir_sequence()
+struct cir_reference{
+    std::vector<std::vector<float>> re;
+    std::vector<std::vector<float>> im;
+};
+
+// a group of windows of one rx channel
+struct cir_job{
+    const char* in;
+    size_t n_bytes_per_item;
+    size_t n_windows;
+    std::complex<float>* out;
+    std::shared_ptr<const cir_reference> reference;
+};
+
+static size_t n_taps;
+static int tap_offset;
+static size_t n_tx_channels;
+static size_t window_length;
+static size_t n_threads;
+
+static fft_plan plan;
+static std::shared_ptr<const cir_reference> reference;
+
+// shared by all pipelines
+static job_pool *pool;
+
+static boost::mutex m_mutex;
+
+// stats, only touched once per file
+static unsigned long long n_files;
+static unsigned long long n_windows_total;
+static unsigned long long n_windows_no_reference;
+static unsigned long long n_bytes_in;
+static unsigned long long n_bytes_out;
+static std::chrono::nanoseconds t_total;
+
+static void init_fft_plan(fft_plan &p, const size_t n);
+static void fft(const fft_plan &p, float* re, float* im);
+static void run_job(const cir_job &job);
+
+int init_cir_extraction(const size_t n_taps_arg, const int tap_offset_arg, const size_t n_tx_channels_arg, const size_t window_length_arg, const size_t n_threads_arg){
+    n_taps = n_taps_arg;
+    tap_offset = tap_offset_arg;
+    n_tx_channels = n_tx_channels_arg;
+    window_length = window_length_arg;
+    n_threads = n_threads_arg;
+
+    n_files = 0;
+    n_windows_total = 0;
+    n_windows_no_reference = 0;
+    n_bytes_in = 0;
+    n_bytes_out = 0;
+    t_total = std::chrono::nanoseconds(0);
+
+    if(n_taps == 0)
+        return 1;
+    if(n_tx_channels == 0 || window_length == 0){
+        std::cerr << "cir_extraction: cir extraction requires at least one tx channel." << std::endl;
+        return 0;
+    }
+    if(n_taps > window_length){
+        std::cerr << "cir_extraction: more taps than samples per window." << std::endl;
+        return 0;
+    }
+
+    // no circular wrap for the taps of interest
+    size_t n_fft = 1;
+    while(n_fft < window_length + n_taps - 1)
+        n_fft *= 2;
+    init_fft_plan(plan, n_fft);
+
+    pool = create_job_pool(n_threads);
+
+    return 1;
+}
+
+int set_cir_sequence(const std::vector<std::vector<std::complex<float>>> &seq){
+    if(n_taps == 0)
+        return 1;
+    if(seq.size() != n_tx_channels){
+        std::cerr << "cir_extraction: expected " << n_tx_channels << " tx sequences, got " << seq.size() << "." << std::endl;
+        return 0;
+    }
+
+    std::shared_ptr<cir_reference> r = std::make_shared<cir_reference>();
+    for(size_t tx = 0; tx < n_tx_channels; tx++){
+        const long long len = seq[tx].size();
+        std::vector<float> re(plan.n, 0.0f), im(plan.n, 0.0f);
+
+        // q[j] = s[j - tap_offset - (n_taps - 1)], so tap t of a window x is sum_n x[n]*conj(q[n + n_taps - 1 - t])
+        double energy = 0.0;
+        for(long long j = 0; len > 0 && j < (long long) (window_length + n_taps - 1); j++){
+            const long long i = ((j - tap_offset - (long long) (n_taps - 1)) % len + len) % len;
+            re[j] = seq[tx][i].real();
+            im[j] = seq[tx][i].imag();
+            if(j < (long long) window_length)
+                energy += std::norm(seq[tx][i]);
+        }
+        fft(plan, &re[0], &im[0]);
+
+        // the inverse transform is done by the forward transform of the conjugate, scale for an unbiased estimate of the taps
+        const float scale = (energy > 0.0) ? (float) (1.0/(plan.n*energy)) : 0.0f;
+        for(size_t i = 0; i < plan.n; i++){
+            re[i] *= scale;
+            im[i] *= -scale;
+        }
+        r->re.push_back(re);
+        r->im.push_back(im);
+    }
+
+    boost::mutex::scoped_lock lk(m_mutex);
+    reference = r;
+    return 1;
+}
+
+size_t get_cir_taps(){
+    return n_taps;
+}
+
+size_t get_cir_tx_channels(){
+    return n_tx_channels;
+}
+
+int get_cir_tap_offset(){
+    return tap_offset;
+}
+
+size_t get_cir_window_bytes(){
+    return n_tx_channels*n_taps*sizeof(std::complex<float>);
+}
+
+void extract_cir(const std::vector<const char*> &buffs, const size_t n_bytes_per_item, const size_t n_windows, std::vector<buffer_t> &out){
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    std::shared_ptr<const cir_reference> r;
+    {
+        boost::mutex::scoped_lock lk(m_mutex);
+        r = reference;
+    }
+
+    const size_t n_groups = (n_windows + CIR_JOB_WINDOWS - 1)/CIR_JOB_WINDOWS;
+
+    std::vector<std::function<void()>> batch_jobs;
+    for(size_t ch = 0; ch < buffs.size(); ch++){
+        for(size_t g = 0; g < n_groups; g++){
+            const size_t k = g*CIR_JOB_WINDOWS;
+            cir_job job;
+            job.in = buffs[ch] + k*window_length*n_bytes_per_item;
+            job.n_bytes_per_item = n_bytes_per_item;
+            job.n_windows = std::min<size_t>(CIR_JOB_WINDOWS, n_windows - k);
+            job.out = reinterpret_cast<std::complex<float>*>(&out[ch][0]) + k*n_tx_channels*n_taps;
+            job.reference = r;
+            batch_jobs.push_back(std::bind(run_job, job));
+        }
+    }
+
+    // without pool the save thread correlates itself
+    run_jobs(pool, batch_jobs);
+
+    std::chrono::nanoseconds t = std::chrono::steady_clock::now() - t1;
+
+    boost::mutex::scoped_lock lk(m_mutex);
+    n_files++;
+    n_windows_total += buffs.size()*n_windows;
+    if(r == nullptr)
+        n_windows_no_reference += buffs.size()*n_windows;
+    n_bytes_in += buffs.size()*n_windows*window_length*n_bytes_per_item;
+    n_bytes_out += buffs.size()*n_windows*get_cir_window_bytes();
+    t_total += t;
+}
+
+void show_debug_information_cir_extraction(){
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "CIR extraction:" << std::endl;
+    std::cout << "n_taps: " << n_taps << std::endl;
+    std::cout << "tap_offset: " << tap_offset << std::endl;
+    std::cout << "n_tx_channels: " << n_tx_channels << std::endl;
+    std::cout << "n_fft: " << plan.n << std::endl;
+    std::cout << "n_threads: " << n_threads << std::endl;
+    std::cout << "n_files: " << n_files << std::endl;
+    std::cout << "n_windows_total: " << n_windows_total << std::endl;
+    std::cout << "n_windows_no_reference: " << n_windows_no_reference << std::endl;
+    std::cout << "n_bytes_in: " << n_bytes_in << std::endl;
+    std::cout << "n_bytes_out: " << n_bytes_out << std::endl;
+    if(n_bytes_out > 0){
+        const double t_total_us = std::chrono::duration_cast<std::chrono::microseconds>(t_total).count();
+        std::cout << "Size reduction: " << (double) n_bytes_in/n_bytes_out << std::endl;
+        std::cout << "Throughput in windows/s: " << n_windows_total/(t_total_us + 1.0)*1e6 << std::endl;
+    }
+    std::cout << "--------------------------" << std::endl;
+}
+
+static void init_fft_plan(fft_plan &p, const size_t n){
+    p.n = n;
+    unsigned int log2n = 0;
+    while(((size_t) 1 << log2n) < n)
+        log2n++;
+
+    p.bitrev.resize(n);
+    for(size_t i = 0; i < n; i++){
+        uint32_t r = 0;
+        for(unsigned int b = 0; b < log2n; b++)
+            r |= ((i >> b) & 1) << (log2n - 1 - b);
+        p.bitrev[i] = r;
+    }
+
+    p.tw_re.assign(n, 0.0f);
+    p.tw_im.assign(n, 0.0f);
+    for(size_t h = 1; h < n; h *= 2){
+        for(size_t j = 0; j < h; j++){
+            p.tw_re[h + j] = (float) std::cos(-M_PI*j/h);
+            p.tw_im[h + j] = (float) std::sin(-M_PI*j/h);
+        }
+    }
+}
+
+// in place forward transform, decimation in time
+static void fft(const fft_plan &p, float* re, float* im){
+    for(size_t i = 0; i < p.n; i++){
+        const size_t j = p.bitrev[i];
+        if(i < j){
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+
+    for(size_t h = 1; h < p.n; h *= 2){
+        const float* __restrict__ wr = &p.tw_re[h];
+        const float* __restrict__ wi = &p.tw_im[h];
+        for(size_t k = 0; k < p.n; k += 2*h){
+            float* __restrict__ ar = re + k;
+            float* __restrict__ ai = im + k;
+            float* __restrict__ br = re + k + h;
+            float* __restrict__ bi = im + k + h;
+            for(size_t j = 0; j < h; j++){
+                const float tr = br[j]*wr[j] - bi[j]*wi[j];
+                const float ti = br[j]*wi[j] + bi[j]*wr[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+}
+
+static void run_job(const cir_job &job){
+    const size_t n = plan.n;
+    std::vector<float> xr(n), xi(n), zr(n), zi(n);
+
+    for(size_t k = 0; k < job.n_windows; k++){
+        std::complex<float>* out = job.out + k*n_tx_channels*n_taps;
+        if(job.reference == nullptr){
+            std::fill(out, out + n_tx_channels*n_taps, std::complex<float>(0.0f, 0.0f));
+            continue;
+        }
+
+        // window zero padded to the fft size
+        std::fill(xr.begin(), xr.end(), 0.0f);
+        std::fill(xi.begin(), xi.end(), 0.0f);
+        if(job.n_bytes_per_item == 4){
+            const int16_t* p = reinterpret_cast<const int16_t*>(job.in) + 2*k*window_length;
+            for(size_t i = 0; i < window_length; i++){
+                xr[i] = p[2*i];
+                xi[i] = p[2*i + 1];
+            }
+        }
+        else{
+            const float* p = reinterpret_cast<const float*>(job.in) + 2*k*window_length;
+            for(size_t i = 0; i < window_length; i++){
+                xr[i] = p[2*i];
+                xi[i] = p[2*i + 1];
+            }
+        }
+        fft(plan, &xr[0], &xi[0]);
+
+        // tap t is at lag n_taps - 1 - t of the correlation
+        for(size_t tx = 0; tx < n_tx_channels; tx++){
+            const float* rr = &job.reference->re[tx][0];
+            const float* ri = &job.reference->im[tx][0];
+            for(size_t i = 0; i < n; i++){
+                zr[i] = rr[i]*xr[i] - ri[i]*xi[i];
+                zi[i] = rr[i]*xi[i] + ri[i]*xr[i];
+            }
+            fft(plan, &zr[0], &zi[0]);
+            for(size_t t = 0; t < n_taps; t++)
+                out[tx*n_taps + t] = std::complex<float>(zr[n_taps - 1 - t], zi[n_taps - 1 - t]);
+        }
+    }
+}
+}
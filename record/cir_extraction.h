@@ -0,0 +1,82 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CHANNELSOUNDER_CIR_EXTRACTION_H
+#define CHANNELSOUNDER_CIR_EXTRACTION_H
+
+#include <vector>
+#include <complex>
+#include <cstddef>
+
+#include "buffer_allocator.h"
+
+namespace channelsounder
+{
+/*!
+ * Inits unit internally. Must be called before the first fifo is initialized.
+ * Each window is correlated with one period of every tx sequence, only n_taps_arg taps per rx/tx pair are saved.
+ * Tap t of a window is the correlation at a delay of tap_offset_arg + t samples relative to the start of the tx sequence at the start of the window.
+ *
+ * n_taps_arg                   complex taps saved per rx/tx pair, 0 to save the samples instead
+ * tap_offset_arg               delay of the first tap in samples
+ * n_tx_channels_arg            number of tx sequences, see set_cir_sequence()
+ * window_length_arg            complex samples per window, must equal the measurement length of the fifos
+ * n_threads_arg                size of the thread pool shared by all pipelines, 0 to correlate in the calling save thread
+ * return                       1 on success and 0 on failure
+*/
+int init_cir_extraction(const size_t n_taps_arg, const int tap_offset_arg, const size_t n_tx_channels_arg, const size_t window_length_arg, const size_t n_threads_arg);
+
+/*!
+ * Sets the reference, can be called once the tx sequence is known. Windows saved before are correlated with zeros.
+ *
+ * seq                          one period per tx channel, see get_sequence() of ringbuffer_tx.h
+ * return                       1 on success and 0 on failure, e.g. if the number of tx channels differs from init_cir_extraction()
+*/
+int set_cir_sequence(const std::vector<std::vector<std::complex<float>>> &seq);
+
+/*!
+ * return                       taps per rx/tx pair set in init_cir_extraction(), 0 if disabled
+*/
+size_t get_cir_taps();
+
+/*!
+ * return                       values set in init_cir_extraction(), written to the file header
+*/
+size_t get_cir_tx_channels();
+int get_cir_tap_offset();
+
+/*!
+ * return                       bytes of the cir of one window of one rx channel, n_tx_channels*n_taps complex fc32
+*/
+size_t get_cir_window_bytes();
+
+/*!
+ * Correlates windows on the thread pool and blocks until all are done.
+ *
+ * buffs                        one pointer per rx channel to n_windows windows of native complex samples
+ * n_bytes_per_item             4 for sc16 and 8 for fc32
+ * n_windows                    number of windows per channel
+ * out                          one buffer per rx channel with n_windows*get_cir_window_bytes() bytes, window k holds [tx 0 taps][tx 1 taps]...
+*/
+void extract_cir(const std::vector<const char*> &buffs, const size_t n_bytes_per_item, const size_t n_windows, std::vector<buffer_t> &out);
+
+/*!
+ * Shows some stats of the cir extraction, e.g. windows per second.
+*/
+void show_debug_information_cir_extraction();
+}
+ 
+#endif
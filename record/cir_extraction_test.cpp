@@ -0,0 +1,119 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <vector>
+#include <complex>
+#include <random>
+#include <cmath>
+
+#include "cir_extraction.h"
+#include "buffer_allocator.h"
+
+/***********************************************************************
+ * The FFT correlator of the cir extraction must match a direct
+ * correlation of each window with the periodic tx sequences:
+ * tap t of tx = sum_n x[n]*conj(s_tx[n - tap_offset - t])/energy
+ **********************************************************************/
+#define N_RX_CHANNELS           2
+#define N_TX_CHANNELS           3
+#define SEQ_LENGTH              300
+#define WINDOW_LENGTH           600             // two periods, so the energy of the reference does not depend on the tap offset
+#define N_TAPS                  24
+#define N_WINDOWS               70              // more than one job per channel
+#define MAX_ERROR               1e-4            // relative to the largest tap
+
+static int check(const size_t n_bytes_per_item, const int tap_offset, const size_t n_threads, const std::vector<std::vector<std::complex<float>>> &seq){
+    std::mt19937 gen(n_bytes_per_item + tap_offset);
+    std::uniform_int_distribution<int> dist(-2000, 2000);
+
+    // the same random samples as sc16 or fc32
+    std::vector<std::vector<std::complex<float>>> x(N_RX_CHANNELS, std::vector<std::complex<float>>(N_WINDOWS*WINDOW_LENGTH));
+    std::vector<std::vector<int16_t>> in_sc16(N_RX_CHANNELS, std::vector<int16_t>(2*N_WINDOWS*WINDOW_LENGTH));
+    std::vector<std::vector<float>> in_fc32(N_RX_CHANNELS, std::vector<float>(2*N_WINDOWS*WINDOW_LENGTH));
+    std::vector<const char*> buffs;
+    for(size_t ch = 0; ch < N_RX_CHANNELS; ch++){
+        for(size_t i = 0; i < x[ch].size(); i++){
+            x[ch][i] = std::complex<float>(dist(gen), dist(gen));
+            in_sc16[ch][2*i] = (int16_t) x[ch][i].real();
+            in_sc16[ch][2*i + 1] = (int16_t) x[ch][i].imag();
+            in_fc32[ch][2*i] = x[ch][i].real();
+            in_fc32[ch][2*i + 1] = x[ch][i].imag();
+        }
+        buffs.push_back((n_bytes_per_item == 4) ? reinterpret_cast<const char*>(&in_sc16[ch][0]) : reinterpret_cast<const char*>(&in_fc32[ch][0]));
+    }
+
+    if (not channelsounder::init_cir_extraction(N_TAPS, tap_offset, N_TX_CHANNELS, WINDOW_LENGTH, n_threads)
+        or not channelsounder::set_cir_sequence(seq)) {
+        return 0;
+    }
+    std::vector<channelsounder::buffer_t> out;
+    for(size_t ch = 0; ch < N_RX_CHANNELS; ch++)
+        out.push_back(channelsounder::buffer_t(N_WINDOWS*channelsounder::get_cir_window_bytes()));
+    channelsounder::extract_cir(buffs, n_bytes_per_item, N_WINDOWS, out);
+
+    double max_tap = 0.0, max_error = 0.0;
+    for(size_t ch = 0; ch < N_RX_CHANNELS; ch++){
+        const std::complex<float>* taps = reinterpret_cast<const std::complex<float>*>(&out[ch][0]);
+        for(size_t k = 0; k < N_WINDOWS; k++){
+            const std::complex<float>* w = &x[ch][k*WINDOW_LENGTH];
+            for(size_t tx = 0; tx < N_TX_CHANNELS; tx++){
+                double energy = 0.0;
+                for(size_t i = 0; i < SEQ_LENGTH; i++)
+                    energy += std::norm(seq[tx][i]);
+                energy *= WINDOW_LENGTH/SEQ_LENGTH;
+
+                for(size_t t = 0; t < N_TAPS; t++){
+                    std::complex<double> c(0.0, 0.0);
+                    for(long long n = 0; n < WINDOW_LENGTH; n++){
+                        const long long i = ((n - tap_offset - (long long) t) % SEQ_LENGTH + SEQ_LENGTH) % SEQ_LENGTH;
+                        c += std::complex<double>(w[n])*std::conj(std::complex<double>(seq[tx][i]));
+                    }
+                    c /= energy;
+                    const std::complex<double> tap(taps[(k*N_TX_CHANNELS + tx)*N_TAPS + t]);
+                    max_tap = std::max(max_tap, std::abs(c));
+                    max_error = std::max(max_error, std::abs(tap - c));
+                }
+            }
+        }
+    }
+
+    std::cout << "n_bytes_per_item " << n_bytes_per_item << ", tap_offset " << tap_offset << ", n_threads " << n_threads
+              << ": max error " << max_error << " of max tap " << max_tap << std::endl;
+    return max_error <= MAX_ERROR*max_tap;
+}
+
+int main()
+{
+    channelsounder::init_buffer_allocator(channelsounder::PAGES_4KB, -1, false);
+
+    // unrelated sequences per tx channel, so a mix-up of channels shows
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> phase(0.0f, 2.0f*M_PI);
+    std::vector<std::vector<std::complex<float>>> seq(N_TX_CHANNELS, std::vector<std::complex<float>>(SEQ_LENGTH));
+    for(size_t tx = 0; tx < N_TX_CHANNELS; tx++)
+        for(size_t i = 0; i < SEQ_LENGTH; i++)
+            seq[tx][i] = std::polar(1.0f, phase(gen));
+
+    if (not check(4, 0, 0, seq)
+        or not check(4, 17, 2, seq)
+        or not check(8, 5, 0, seq)
+        or not check(8, -9, 2, seq)) {
+        std::cerr << "FAILED" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <boost/thread/thread.hpp>
+
+#include "compression.h"
+#include "job_pool.h"
+#include "sc16_codec.h"
+#include "ch_measurement_format.h"
+
+namespace channelsounder
+{
+// one group of windows of one channel
+struct compression_job{
+    const int16_t* in;
+    size_t n_windows;
+    size_t window_length;
+    char* out;
+    uint32_t* n_bytes_window;
+    uint64_t* n_bytes_group;
+};
+
+static uint32_t codec;
+static size_t n_threads;
+
+// shared by all pipelines
+static job_pool *pool;
+
+static boost::mutex m_mutex;
+
+// stats, only touched once per file
+static unsigned long long n_files;
+static unsigned long long n_bytes_in;
+static unsigned long long n_bytes_out;
+static std::chrono::nanoseconds t_total;
+
+static void run_job(const compression_job &job);
+
+int init_compression(const uint32_t codec_arg, const size_t n_threads_arg){
+    codec = codec_arg;
+    n_threads = n_threads_arg;
+
+    n_files = 0;
+    n_bytes_in = 0;
+    n_bytes_out = 0;
+    t_total = std::chrono::nanoseconds(0);
+
+    pool = (codec != CH_MEASUREMENT_CODEC_RAW) ? create_job_pool(n_threads) : nullptr;
+
+    return 1;
+}
+
+int parse_codec(const std::string &str, uint32_t &codec_out){
+    if(str == "raw")
+        codec_out = CH_MEASUREMENT_CODEC_RAW;
+    else if(str == "sc16_delta")
+        codec_out = CH_MEASUREMENT_CODEC_SC16_DELTA;
+    else
+        return 0;
+    return 1;
+}
+
+uint32_t get_codec(){
+    return codec;
+}
+
+void get_compression_buffer_size(const size_t n_channels, const size_t n_windows, const size_t window_length, size_t &n_buffers, size_t &n_bytes_per_buffer){
+    const size_t n_groups = (n_windows + SC16_CODEC_KEYFRAME_INTERVAL - 1)/SC16_CODEC_KEYFRAME_INTERVAL;
+    n_buffers = n_channels*n_groups;
+    n_bytes_per_buffer = SC16_CODEC_KEYFRAME_INTERVAL*sc16_codec_max_bytes(window_length);
+}
+
+void compress_windows(const std::vector<const char*> &buffs, const size_t n_windows, const size_t window_length,
+                      std::vector<buffer_t> &out, std::vector<uint32_t> &n_bytes_window, std::vector<uint64_t> &n_bytes_group){
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    const size_t n_groups = (n_windows + SC16_CODEC_KEYFRAME_INTERVAL - 1)/SC16_CODEC_KEYFRAME_INTERVAL;
+
+    std::vector<std::function<void()>> batch_jobs;
+    for(size_t ch = 0; ch < buffs.size(); ch++){
+        for(size_t g = 0; g < n_groups; g++){
+            const size_t k = g*SC16_CODEC_KEYFRAME_INTERVAL;
+            compression_job job;
+            job.in = reinterpret_cast<const int16_t*>(buffs[ch]) + 2*k*window_length;
+            job.n_windows = std::min<size_t>(SC16_CODEC_KEYFRAME_INTERVAL, n_windows - k);
+            job.window_length = window_length;
+            job.out = &out[ch*n_groups + g][0];
+            job.n_bytes_window = &n_bytes_window[ch*n_windows + k];
+            job.n_bytes_group = &n_bytes_group[ch*n_groups + g];
+            batch_jobs.push_back(std::bind(run_job, job));
+        }
+    }
+
+    // without pool the save thread compresses itself
+    run_jobs(pool, batch_jobs);
+
+    std::chrono::nanoseconds t = std::chrono::steady_clock::now() - t1;
+
+    unsigned long long n_out = 0;
+    for(size_t i = 0; i < buffs.size()*n_groups; i++)
+        n_out += n_bytes_group[i];
+
+    boost::mutex::scoped_lock lk(m_mutex);
+    n_files++;
+    n_bytes_in += buffs.size()*n_windows*window_length*4;
+    n_bytes_out += n_out;
+    t_total += t;
+}
+
+void show_debug_information_compression(){
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Compression:" << std::endl;
+    std::cout << "codec: " << codec << std::endl;
+    std::cout << "n_threads: " << n_threads << std::endl;
+    std::cout << "n_files: " << n_files << std::endl;
+    std::cout << "n_bytes_in: " << n_bytes_in << std::endl;
+    std::cout << "n_bytes_out: " << n_bytes_out << std::endl;
+    if(n_bytes_out > 0){
+        const double t_total_us = std::chrono::duration_cast<std::chrono::microseconds>(t_total).count();
+        std::cout << "Compression ratio: " << (double) n_bytes_in/n_bytes_out << std::endl;
+        std::cout << "Throughput in MB/s (uncompressed): " << n_bytes_in/(t_total_us + 1.0) << std::endl;
+    }
+    std::cout << "--------------------------" << std::endl;
+}
+
+static void run_job(const compression_job &job){
+    const size_t n_values = 2*job.window_length;
+    uint64_t n_bytes = 0;
+    for(size_t k = 0; k < job.n_windows; k++){
+        const int16_t* ref = (k == 0) ? nullptr : job.in + (k - 1)*n_values;
+        job.n_bytes_window[k] = sc16_encode_window(job.in + k*n_values, ref, job.window_length, job.out + n_bytes);
+        n_bytes += job.n_bytes_window[k];
+    }
+    *job.n_bytes_group = n_bytes;
+}
+}
@@ -0,0 +1,83 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_COMPRESSION_H
+#define CHANNELSOUNDER_COMPRESSION_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "buffer_allocator.h"
+
+namespace channelsounder
+{
+/*!
+ * Inits unit internally. Must be called before the first fifo is initialized.
+ *
+ * codec_arg                    CH_MEASUREMENT_CODEC_RAW or CH_MEASUREMENT_CODEC_SC16_DELTA, see ch_measurement_format.h
+ * n_threads_arg                size of the thread pool shared by all pipelines, 0 to compress in the calling save thread
+ * return                       1 on success and 0 on failure
+*/
+int init_compression(const uint32_t codec_arg, const size_t n_threads_arg);
+
+/*!
+ * Converts a command line string to a codec.
+ *
+ * str                          "raw" or "sc16_delta"
+ * codec                        set on success
+ * return                       1 on success and 0 on failure
+*/
+int parse_codec(const std::string &str, uint32_t &codec);
+
+/*!
+ * return                       codec set in init_compression()
+*/
+uint32_t get_codec();
+
+/*!
+ * Number of output buffers and their size needed by compress_windows().
+ *
+ * n_channels                   number of channels
+ * n_windows                    number of windows per channel
+ * window_length                complex samples per window
+ * n_buffers                    set to number of buffers
+ * n_bytes_per_buffer           set to size of each buffer
+*/
+void get_compression_buffer_size(const size_t n_channels, const size_t n_windows, const size_t window_length, size_t &n_buffers, size_t &n_bytes_per_buffer);
+
+/*!
+ * Compresses sc16 windows on the thread pool and blocks until all are done.
+ * Windows are coded in groups of SC16_CODEC_KEYFRAME_INTERVAL, each group is one job.
+ *
+ * buffs                        one pointer per channel to n_windows windows of window_length complex sc16 samples
+ * n_windows                    number of windows per channel
+ * window_length                complex samples per window
+ * out                          output buffers, see get_compression_buffer_size(), out[ch*n_groups + g] holds group g of channel ch
+ * n_bytes_window               set to coded size of each window, index ch*n_windows + k
+ * n_bytes_group                set to coded size of each group, index ch*n_groups + g
+*/
+void compress_windows(const std::vector<const char*> &buffs, const size_t n_windows, const size_t window_length,
+                      std::vector<buffer_t> &out, std::vector<uint32_t> &n_bytes_window, std::vector<uint64_t> &n_bytes_group);
+
+/*!
+ * Shows some stats of the compression, e.g. compression ratio and throughput.
+*/
+void show_debug_information_compression();
+}
+ 
+#endif
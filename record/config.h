@@ -20,4 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define SAVE_PATH       "../data/"
 
+// maximum number of independent rx pipelines (streamer, ring buffer and fifo), one per motherboard
+#define MAX_PIPELINES   8
+
 #endif
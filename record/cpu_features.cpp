@@ -0,0 +1,39 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include "cpu_features.h"
+
+namespace channelsounder
+{
+static bool enabled = true;
+
+bool has_cpu_feature(const cpu_feature_enum feature){
+    if(enabled == false)
+        return false;
+#if defined(__x86_64__) || defined(__i386__)
+    switch(feature){
+        case CPU_FEATURE_AVX:   return __builtin_cpu_supports("avx");
+        case CPU_FEATURE_AVX2:  return __builtin_cpu_supports("avx2");
+        case CPU_FEATURE_F16C:  return __builtin_cpu_supports("f16c");
+    }
+#endif
+    return false;
+}
+
+void set_cpu_features_enabled(const bool enabled_arg){
+    enabled = enabled_arg;
+}
+}
@@ -0,0 +1,45 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CHANNELSOUNDER_CPU_FEATURES_H
+#define CHANNELSOUNDER_CPU_FEATURES_H
+
+namespace channelsounder
+{
+// instruction set extensions of the hand-written kernels
+enum cpu_feature_enum{
+    CPU_FEATURE_AVX,
+    CPU_FEATURE_AVX2,
+    CPU_FEATURE_F16C
+};
+
+/*!
+ * Checks the cpu the process runs on, which may differ from the one the binary was built on.
+ * Units read the features once in their init function and use a scalar fallback for missing ones.
+ *
+ * feature                      CPU_FEATURE_AVX etc.
+ * return                       true if the cpu supports the feature and kernels are enabled, always false on other architectures than x86
+*/
+bool has_cpu_feature(const cpu_feature_enum feature);
+
+/*!
+ * enabled                      false to make has_cpu_feature() return false for all features, e.g. to compare the kernels with the scalar fallback,
+ *                              takes effect for units initialized afterwards
+*/
+void set_cpu_features_enabled(const bool enabled);
+}
+
+#endif
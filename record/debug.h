@@ -40,6 +40,8 @@ struct stats{
     unsigned long long n_worker_wait;                           // how often did we enter the wait state in the worker?
     unsigned long long n_worker_executed;                       // how often did the worker execute his task after notify_all()?
     unsigned long long n_worker_not_done;                       // how often was a buffer full but the worker thread was not done processing the old thread?
+    unsigned long long n_slots_high_water;                      // maximum number of buffers handed to the worker but not yet processed
+    unsigned long long n_samples_lost;                          // number of samples missing according to the time stamps, e.g. after an overrun
     
     void reset(){
         tstart = std::chrono::high_resolution_clock::now();
@@ -49,6 +51,8 @@ struct stats{
         n_worker_wait = 0;
         n_worker_executed = 0;
         n_worker_not_done = 0;
+        n_slots_high_water = 0;
+        n_samples_lost = 0;
     };
     
     void print_data(std::string source){
@@ -65,6 +69,8 @@ struct stats{
         std::cout << "local_stats.n_worker_wait: " << n_worker_wait << std::endl;
         std::cout << "local_stats.n_worker_executed: " << n_worker_executed << std::endl;
         std::cout << "local_stats.n_worker_not_done: " << n_worker_not_done << std::endl;
+        std::cout << "local_stats.n_slots_high_water: " << n_slots_high_water << std::endl;
+        std::cout << "local_stats.n_samples_lost: " << n_samples_lost << std::endl;
         std::cout << "--------------------------" << std::endl;    
     }
 };
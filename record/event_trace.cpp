@@ -0,0 +1,164 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <boost/thread/mutex.hpp>
+
+#include "event_trace.h"
+
+namespace channelsounder
+{
+thread_local trace_ring* trace_thread_ring = nullptr;
+
+// name, category, name of the argument and phase in the trace file, in the order of trace_event_enum
+static const char* const event_names[TRACE_N_EVENTS][4] = {
+    {"rx_overflow",          "rx",       "tick",            "i"},
+    {"rx_sequence_error",    "rx",       "tick",            "i"},
+    {"rx_late_command",      "rx",       "tick",            "i"},
+    {"rx_timeout",           "rx",       "tick",            "i"},
+    {"ring_publish",         "ring",     "slots_used",      "i"},
+    {"ring_overwrite",       "ring",     "slots_used",      "i"},
+    {"fifo_feed",            "fifo",     "samples",         "X"},
+    {"fifo_swap",            "fifo",     "buffers_used",    "i"},
+    {"fifo_drop",            "fifo",     "measurements",    "i"},
+    {"fifo_save",            "fifo",     "file",            "X"},
+    {"file_write",           "file",     "file",            "X"},
+    {"file_open",            "file",     "file",            "i"},
+    {"file_close",           "file",     "file",            "i"},
+    {"tx_underflow",         "tx",       "channel",         "i"},
+    {"tx_sequence_error",    "tx",       "channel",         "i"},
+    {"tx_late_burst",        "tx",       "channel",         "i"}
+};
+
+static std::string file_name;
+static size_t n_events_per_thread;
+static unsigned long long t0;
+
+// rings of all threads ever registered, kept until the end of the program
+static std::vector<trace_ring*> rings;
+static boost::mutex t_mutex;
+
+int init_event_trace(const std::string &file_name_arg, const size_t n_events_arg){
+    file_name = file_name_arg;
+    
+    n_events_per_thread = 1;
+    while(n_events_per_thread < n_events_arg)
+        n_events_per_thread <<= 1;
+    
+    if(file_name.empty())
+        return 1;
+    
+    // the file is opened here to not lose the trace of a long run at the end
+    std::ofstream test(file_name.c_str(), std::ios::out | std::ios::trunc);
+    if(!test.is_open()){
+        std::cerr << "event_trace: Cannot open " << file_name << "." << std::endl;
+        return 0;
+    }
+    
+    t0 = latency_clock();
+    
+    return 1;
+}
+
+void register_trace_thread(const std::string &role, const size_t index){
+    if(file_name.empty())
+        return;
+    
+    boost::mutex::scoped_lock lk(t_mutex);
+    
+    // a thread started again continues the ring of its predecessor
+    for(size_t i = 0; i < rings.size(); i++){
+        if(rings[i]->role == role && rings[i]->index == index){
+            trace_thread_ring = rings[i];
+            return;
+        }
+    }
+    
+    trace_ring* r = new trace_ring;
+    r->events.resize(n_events_per_thread);      // value initialized, all pages are touched here and not on the hot path
+    r->mask = n_events_per_thread - 1;
+    r->n_events = 0;
+    r->role = role;
+    r->index = index;
+    rings.push_back(r);
+    trace_thread_ring = r;
+}
+
+int write_event_trace(){
+    if(file_name.empty())
+        return 1;
+    
+    boost::mutex::scoped_lock lk(t_mutex);
+    
+    std::ofstream out(file_name.c_str(), std::ios::out | std::ios::trunc);
+    if(!out.is_open()){
+        std::cerr << "event_trace: Cannot open " << file_name << "." << std::endl;
+        return 0;
+    }
+    
+    // microseconds since init_event_trace(), one track per thread
+    const double us_per_tick = get_latency_clock_ns_per_tick()/1e3;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"channelsounder\"}}";
+    for(size_t i = 0; i < rings.size(); i++){
+        const trace_ring &r = *rings[i];
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i + 1 << ",\"args\":{\"name\":\"" << r.role << " " << r.index << "\"}}";
+        out << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i + 1 << ",\"args\":{\"sort_index\":" << i << "}}";
+        
+        // oldest event still in the ring first
+        const unsigned long long n = std::min<unsigned long long>(r.n_events, r.events.size());
+        for(unsigned long long k = r.n_events - n; k < r.n_events; k++){
+            const trace_event &e = r.events[k & r.mask];
+            const char* const* names = event_names[e.type];
+            out << ",\n{\"name\":\"" << names[0] << "\",\"cat\":\"" << names[1] << "\",\"pid\":1,\"tid\":" << i + 1
+                << ",\"ts\":" << (long long) (e.t - t0)*us_per_tick;
+            if(names[3][0] == 'X')
+                out << ",\"ph\":\"X\",\"dur\":" << e.duration*us_per_tick;
+            else
+                out << ",\"ph\":\"i\",\"s\":\"t\"";
+            out << ",\"args\":{\"pipeline\":" << e.id << ",\"" << names[2] << "\":" << e.arg << "}}";
+        }
+    }
+    out << "\n]}\n";
+    
+    if(!out.good()){
+        std::cerr << "event_trace: Cannot write " << file_name << "." << std::endl;
+        return 0;
+    }
+    
+    return 1;
+}
+
+void show_debug_information_event_trace(){
+    boost::mutex::scoped_lock lk(t_mutex);
+    
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Event trace:" << std::endl;
+    std::cout << "file_name: " << (file_name.empty() ? "disabled" : file_name) << std::endl;
+    std::cout << "n_events_per_thread: " << n_events_per_thread << std::endl;
+    for(size_t i = 0; i < rings.size(); i++){
+        const trace_ring &r = *rings[i];
+        const unsigned long long n = std::min<unsigned long long>(r.n_events, r.events.size());
+        std::cout << r.role << " " << r.index << ": " << r.n_events << " events, " << r.n_events - n << " overwritten" << std::endl;
+    }
+    std::cout << "--------------------------" << std::endl;
+}
+}
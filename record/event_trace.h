@@ -0,0 +1,143 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_EVENT_TRACE_H
+#define CHANNELSOUNDER_EVENT_TRACE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "latency_histogram.h"
+
+namespace channelsounder
+{
+// events of the pipeline, instants or spans with a duration
+enum trace_event_enum{
+    TRACE_RX_OVERFLOW = 0,              // uhd reported an overflow, arg is the device tick
+    TRACE_RX_SEQUENCE_ERROR,            // "
+    TRACE_RX_LATE_COMMAND,              // "
+    TRACE_RX_TIMEOUT,                   // arg is the tick of the last samples received
+    TRACE_RING_PUBLISH,                 // an rx ring slot was handed to the process thread, arg is the number of slots in use
+    TRACE_RING_OVERWRITE,               // no rx ring slot was free
+    TRACE_FIFO_FEED,                    // span, one rx ring slot fed into the fifo, arg is the number of samples
+    TRACE_FIFO_SWAP,                    // a fifo buffer was handed to the save thread, arg is the number of buffers in use
+    TRACE_FIFO_DROP,                    // no fifo buffer was free, arg is the number of measurements lost
+    TRACE_FIFO_SAVE,                    // span, one fifo buffer saved, arg is the file number
+    TRACE_FILE_WRITE,                   // span, one whole file written, arg is the file number
+    TRACE_FILE_OPEN,                    // file written chunk by chunk, arg is the file number
+    TRACE_FILE_CLOSE,                   // "
+    TRACE_TX_UNDERFLOW,                 // uhd reported an async event, arg is the channel
+    TRACE_TX_SEQUENCE_ERROR,            // "
+    TRACE_TX_LATE_BURST,                // "
+    TRACE_N_EVENTS
+};
+
+struct trace_event{
+    unsigned long long t;               // latency_clock() at the event or at the begin of the span
+    unsigned long long duration;        // ticks of latency_clock(), 0 for instants
+    unsigned long long arg;
+    uint16_t type;                      // trace_event_enum
+    uint16_t id;                        // pipeline
+};
+
+// events of one thread, the oldest are overwritten
+struct trace_ring{
+    std::vector<trace_event> events;
+    unsigned long long mask;
+    unsigned long long n_events;        // ever recorded, the ring holds the last min(n_events, events.size())
+    std::string role;
+    size_t index;
+};
+
+// set by register_trace_thread(), threads without a ring record nothing
+extern thread_local trace_ring* trace_thread_ring;
+
+/*!
+ * Inits unit internally. Must be called after init_latency_histogram() and before any pipeline thread is started.
+ *
+ * file_name_arg                Chrome trace file written by write_event_trace(), opened with chrome://tracing or ui.perfetto.dev, empty to disable tracing
+ * n_events_arg                 events kept per thread, rounded up to a power of two, the ring is allocated and touched on registration
+ * return                       1 on success and 0 on failure
+*/
+int init_event_trace(const std::string &file_name_arg, const size_t n_events_arg);
+
+/*!
+ * Gives the calling thread a ring of its own, shown as a track named after role and index.
+ *
+ * role                         e.g. "rx", "process", "save", see thread_placement.h
+ * index                        index of the thread within its role, e.g. the pipeline id
+*/
+void register_trace_thread(const std::string &role, const size_t index);
+
+/*!
+ * Records an event without a duration, a few plain stores to the ring of the calling thread.
+ *
+ * type                         TRACE_RX_OVERFLOW etc.
+ * arg                          see trace_event_enum
+ * id                           pipeline
+*/
+inline void trace_instant(const trace_event_enum type, const unsigned long long arg, const size_t id){
+    trace_ring* r = trace_thread_ring;
+    if(r == nullptr)
+        return;
+    trace_event &e = r->events[r->n_events & r->mask];
+    e.t = latency_clock();
+    e.duration = 0;
+    e.arg = arg;
+    e.type = type;
+    e.id = id;
+    r->n_events++;
+}
+
+/*!
+ * Records an event with a duration, once it has ended.
+ *
+ * type                         TRACE_FIFO_FEED etc.
+ * t_begin                      latency_clock() at the begin
+ * t_end                        latency_clock() at the end
+ * arg                          see trace_event_enum
+ * id                           pipeline
+*/
+inline void trace_span(const trace_event_enum type, const unsigned long long t_begin, const unsigned long long t_end, const unsigned long long arg, const size_t id){
+    trace_ring* r = trace_thread_ring;
+    if(r == nullptr)
+        return;
+    trace_event &e = r->events[r->n_events & r->mask];
+    e.t = t_begin;
+    e.duration = t_end - t_begin;
+    e.arg = arg;
+    e.type = type;
+    e.id = id;
+    r->n_events++;
+}
+
+/*!
+ * Writes the rings of all threads to the trace file in the Chrome trace event format. Must only be called once all registered threads have ended.
+ *
+ * return                       1 on success or if tracing is disabled and 0 on failure
+*/
+int write_event_trace();
+
+/*!
+ * Shows the number of events recorded and lost per thread.
+*/
+void show_debug_information_event_trace();
+}
+ 
+#endif
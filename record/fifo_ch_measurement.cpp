@@ -14,245 +14,1044 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 */
-
 #include <iostream>
 #include <fstream>
 #include <boost/thread/thread.hpp>
 #include <iomanip>
+#include <chrono>
+#include <cstring>
 
 #include "debug.h"
 #include "config.h"
 #include "fifo_ch_measurement.h"
-
-#define CH_MEASUREMENT_PER_SEC              1000
-#define CH_MEASUREMENT_LENGTH_IN_SAMPLES    500
-#define CH_MEASUREMENT_SAVE_PERIOD_SEC      10
-#define CH_MEASUREMENT_SAVE_PERIOD          CH_MEASUREMENT_PER_SEC*CH_MEASUREMENT_SAVE_PERIOD_SEC
+#include "file_writer.h"
+#include "ch_measurement_format.h"
+#include "compression.h"
+#include "sc16_codec.h"
+#include "storage_format.h"
+#include "cir_extraction.h"
+#include "shm_publisher.h"
+#include "window_gate.h"
+#include "window_average.h"
+#include "metrics.h"
+#include "latency_histogram.h"
+#include "event_trace.h"
 
 namespace channelsounder
 {
-static size_t n_channels;                   // number of channels/antennas, set in init function
-static size_t n_bytes_per_item;             // size of complex sample
-static unsigned int samp_rate;              // S/s
-static unsigned int n_samples_per_period;   // number of complex samples between two channel measurements
-    
-enum buffer_enum{
-    NO_BUFFER = -1,
-    BUFFER0 = 0,
-    BUFFER1 = 1
-};
-static buffer_enum buffer2write;
-static buffer_enum buffer2process;
-
 // collecting samples in a state machine
 enum buffer_enum_state{
     COLLECT_CHANNEL_MEASUREMENT,
     WAIT_FOR_NEW_MEASUREMENT
 };
-static buffer_enum_state d_STATE;
-static unsigned int n_state_0;                      // state counter
-static unsigned int n_state_1;                      // "
-static unsigned long long n_measurement_counter;    // counts to CH_MEASUREMENT_SAVE_PERIOD, actual measurements per file
-static unsigned long long n_measurement_saved;      // counts files
-    
+
+struct fifo_unit;
+typedef void (*feed_function_t)(fifo_unit &u, const std::vector<const char*> &buffs01, const unsigned long long n_new_samples);
+
+// one buffer of the pool, holds a chunk of chunk_windows consecutive measurements of one file, or the whole file
 // columns: number of rx channels (antennas)
 // rows: container for samples
-static std::vector<std::vector<char>> buffs0;
-static std::vector<std::vector<char>> buffs1;
+struct fifo_buffer{
+    std::vector<buffer_t> buffs;
+    std::vector<uint32_t> flags;            // one entry per measurement, CH_MEASUREMENT_COMPLETE etc.
+    unsigned long long file_number;         // set when the buffer is handed to the save thread
+    size_t first_window;                    // "    index of the first measurement in the file
+    size_t n_windows;                       // "    shorter than chunk_windows for the last chunk of a file
+    std::vector<float> power;               // one entry per measurement, only used with the window gate
+};
+
+// one independent fifo per rx pipeline
+struct fifo_unit{
+    size_t id;                              // pipeline, index in units
+    size_t n_channels;                      // number of channels/antennas, set in init function
+    size_t n_bytes_per_item;                // size of complex sample
+    unsigned int samp_rate;                 // S/s
+    unsigned int n_samples_per_period;      // number of complex samples between two channel measurements
+    unsigned int n_samples_per_window;      // number of complex samples between two captured windows, n_samples_per_period/n_average
+    std::string file_prefix;                // name of saved files without number and extension
+
+    // measurement schedule
+    unsigned int measurements_per_sec;      // number of channel measurements per second, saved ones if averaged
+    unsigned int measurement_length;        // number of complex samples per channel measurement
+    unsigned int save_period_sec;           // seconds per saved file
+    unsigned int save_period;               // channel measurements per saved file
+    unsigned int chunk_windows;             // channel measurements per buffer, chunks start at multiples of it within a file
+    feed_function_t feed;                   // state machine, specialized for common measurement lengths
+
+    buffer_enum_state d_STATE;
+    long long n_state_0;                            // state counter, negative while waiting for the first measurement
+    unsigned int n_state_1;                         // "
+    unsigned int n_state_valid;                     // samples actually received for the current measurement
+    unsigned long long n_measurement_counter;       // counts to save_period, actual measurements per file
+    unsigned long long n_measurement_total;         // index of the current measurement in device time, tick/n_samples_per_period
+    unsigned int n_average_counter;                 // counts to n_average, windows of the current measurement
+
+    // measurements and files start at multiples of n_samples_per_period and save_period in device time, so all pipelines stay aligned
+    bool synced;                            // set once the first tick was seen
+    long long next_tick;                    // tick of the next sample we expect
+
+    // pool of buffers, one is filled while the others wait for or are processed by the save thread
+    // ready and free are single producer single consumer queues of pool indices, their counters only increase
+    // ready: filled buffers, pushed by the thread feeding the fifo and popped by the save thread
+    // free:  saved buffers, pushed by the save thread and popped by the thread feeding the fifo
+    size_t n_buffers;
+    std::vector<fifo_buffer> pool;
+    size_t buffer2write;                    // index of the buffer being filled
+    std::vector<size_t> ready_list;
+    std::vector<size_t> free_list;
+    std::atomic<unsigned long long> ready_head;
+    std::atomic<unsigned long long> ready_tail;
+    std::atomic<unsigned long long> free_head;
+    std::atomic<unsigned long long> free_tail;
+
+    // pool stats, occupancy is sampled each time a buffer is full
+    std::vector<unsigned long long> occupancy_hist;     // index is the number of buffers waiting for or being saved
+    unsigned long long n_chunks_dropped;
+    unsigned long long n_measurements_dropped;
+
+    // file header and index, written in front of the samples
+    buffer_t header;
+    size_t channel_stride;                  // bytes per channel including padding to CH_MEASUREMENT_FILE_ALIGNMENT
+    long long stream_start_tick;            // first tick seen
+    std::string seq_name;                   // identity of the tx sequence, set by set_sequence_identity_fifo()
+    unsigned long long seq_length;          // "
+    unsigned long long seq_checksum;        // "
+
+    // compression, only used if get_codec() is not CH_MEASUREMENT_CODEC_RAW
+    uint32_t codec;
+    std::vector<buffer_t> buffs_compressed;             // one buffer per channel and group of windows
+    std::vector<uint32_t> n_bytes_compressed_window;    // index ch*save_period + k
+    std::vector<uint64_t> n_bytes_compressed_group;     // index ch*n_groups + g
+
+    // storage format, windows are captured in buffs_window and converted into the write buffer once complete
+    uint32_t storage_format;
+    size_t n_bytes_per_window;              // bytes of one stored window of one channel
+    std::vector<buffer_t> buffs_window;     // only used if storage_format is not CH_MEASUREMENT_STORAGE_NATIVE
+
+    // cir extraction, only used if get_cir_taps() is not 0, the save thread writes the taps instead of the windows
+    size_t cir_taps;
+    std::vector<buffer_t> buffs_cir;        // one buffer per rx channel
+
+    // file written chunk by chunk, only used if chunk_windows is smaller than save_period
+    file_handle_t file;
+    bool file_open;
+    unsigned long long file_number_open;
+
+    // window gate, a buffer is held until the next one arrives, so triggers at the start of the next buffer reach back into it
+    bool gate;
+    bool held;
+    size_t buffer_held;                     // index of the held buffer
+    size_t gate_post_left;                  // windows owed to triggers of the last saved buffer
+    unsigned long long gate_next_measurement;   // absolute number of the measurement following the last saved buffer
+    std::vector<char> keep;                 // one entry per measurement of the buffer being saved
+
+    // averaging, n_average consecutive windows are accumulated and saved as one measurement, see window_average.h
+    // the feed path adds the samples directly, in steered capture uhd writes to buffs_window which is added once complete
+    size_t n_average;
+    std::vector<buffer_t> buffs_average;    // one accumulator per channel
+    bool average_complete;                  // all windows of the current measurement were complete
+    
+    // live publication of each finished window, see shm_publisher.h
+    bool publish;
+    std::vector<const char*> publish_windows;
+
+    boost::mutex m_mutex;
+    boost::condition_variable m_condition;
 
-static boost::mutex m_mutex;
-static boost::condition_variable m_condition;
+    // steered capture, uhd writes directly into the fifo
+    bool steered;                           // set by init_steered_capture()
+    size_t max_items_per_packet;            // maximum number of samples passed on by uhd driver
+    std::vector<buffer_t> buffs_scratch;    // uhd writes samples between two measurements here
+    std::vector<void*> buffs;               // actual output given to uhd
 
-static struct stats local_stats;
+    struct stats local_stats;
+};
+static fifo_unit units[MAX_PIPELINES];
+    
+template<unsigned int LEN> static void feed_window(fifo_unit &u, const std::vector<const char*> &buffs01, const unsigned long long n_new_samples);
+static void sync_to_tick(fifo_unit &u, const long long tick);
+static void finish_ch_measurement(fifo_unit &u);
+static bool average_window(fifo_unit &u, fifo_buffer &b, const size_t slot);
+static void print_data_init(const fifo_unit &u);
+static void fill_file_header(fifo_unit &u, const unsigned long long file_number, const uint32_t* flags);
+static void save_buffer(fifo_unit &u, fifo_buffer &b, const fifo_buffer* next);
+static void release_buffer(fifo_unit &u, const size_t index);
+static void save_file(fifo_unit &u, fifo_buffer &b);
+static void save_chunk(fifo_unit &u, fifo_buffer &b);
+static void close_chunked_file(fifo_unit &u);
+static unsigned long long fifo_buffers_used(const size_t id);
+    
+int init_fifo_ch_measurement(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const unsigned int samp_rate_arg,
+                             const unsigned int measurements_per_sec_arg, const unsigned int measurement_length_arg, const unsigned int save_period_sec_arg,
+                             const size_t n_buffers_arg, const unsigned int chunk_windows_arg, const std::string &file_prefix_arg, const size_t id){
+    if(id >= MAX_PIPELINES){
+        std::cerr << "fifo_ch_measurement: id exceeds MAX_PIPELINES." << std::endl;
+        return 0;
+    }
+    if(measurements_per_sec_arg == 0 || measurement_length_arg == 0 || save_period_sec_arg == 0){
+        std::cerr << "fifo_ch_measurement: measurements per second, measurement length and save period must be larger than 0." << std::endl;
+        return 0;
+    }
+    if(n_buffers_arg < 2){
+        std::cerr << "fifo_ch_measurement: at least 2 buffers are required." << std::endl;
+        return 0;
+    }
+    if(samp_rate_arg % measurements_per_sec_arg != 0){
+        std::cerr << "fifo_ch_measurement: sampling rate must be a multiple of the measurements per second." << std::endl;
+        return 0;
+    }
+    if(measurement_length_arg > samp_rate_arg/measurements_per_sec_arg){
+        std::cerr << "fifo_ch_measurement: measurement length exceeds the period of " << samp_rate_arg/measurements_per_sec_arg << " samples." << std::endl;
+        return 0;
+    }
+    if(get_codec() != CH_MEASUREMENT_CODEC_RAW && (n_bytes_per_item_arg != 4 || get_storage_format() != CH_MEASUREMENT_STORAGE_NATIVE)){
+        std::cerr << "fifo_ch_measurement: compression requires sc16 samples stored natively." << std::endl;
+        return 0;
+    }
+    if(get_cir_taps() > 0 && (get_codec() != CH_MEASUREMENT_CODEC_RAW || get_storage_format() != CH_MEASUREMENT_STORAGE_NATIVE)){
+        std::cerr << "fifo_ch_measurement: cir extraction requires uncompressed samples stored natively." << std::endl;
+        return 0;
+    }
+    if(chunk_windows_arg > 0 && chunk_windows_arg < measurements_per_sec_arg*save_period_sec_arg && get_codec() != CH_MEASUREMENT_CODEC_RAW){
+        std::cerr << "fifo_ch_measurement: flushing in chunks requires uncompressed files." << std::endl;
+        return 0;
+    }
+    if(is_window_gate_enabled() && (get_codec() != CH_MEASUREMENT_CODEC_RAW || n_buffers_arg < 3)){
+        std::cerr << "fifo_ch_measurement: the window gate requires uncompressed files and at least 3 buffers." << std::endl;
+        return 0;
+    }
+    if(measurements_per_sec_arg % get_average_windows() != 0){
+        std::cerr << "fifo_ch_measurement: measurements per second must be a multiple of the windows averaged." << std::endl;
+        return 0;
+    }
+    if(is_window_gate_enabled() && chunk_windows_arg > 0 && chunk_windows_arg < get_gate_pre()){
+        std::cerr << "fifo_ch_measurement: the window gate looks ahead one chunk, so a chunk must hold at least the windows saved before a trigger." << std::endl;
+        return 0;
+    }
+    fifo_unit &u = units[id];
+    
+    u.id = id;
+    u.n_channels = n_channels_arg;
+    u.n_bytes_per_item = n_bytes_per_item_arg;
+    u.samp_rate = samp_rate_arg;
+    u.file_prefix = file_prefix_arg;
+    
+    // with averaging, files and the shared memory ring see measurements at the reduced rate only
+    u.n_average = get_average_windows();
+    u.measurements_per_sec = measurements_per_sec_arg/u.n_average;
+    u.measurement_length = measurement_length_arg;
+    u.save_period_sec = save_period_sec_arg;
+    u.save_period = u.measurements_per_sec*u.save_period_sec;
+    u.chunk_windows = (chunk_windows_arg == 0 || chunk_windows_arg > u.save_period) ? u.save_period : chunk_windows_arg;
+    u.n_samples_per_window = u.samp_rate/measurements_per_sec_arg;
+    u.n_samples_per_period = u.n_samples_per_window*u.n_average;
+    
+    // the length is a compile time constant in the fast paths
+    switch(u.measurement_length){
+        case 256:   u.feed = &feed_window<256>;     break;
+        case 500:   u.feed = &feed_window<500>;     break;
+        case 512:   u.feed = &feed_window<512>;     break;
+        case 1024:  u.feed = &feed_window<1024>;    break;
+        default:    u.feed = &feed_window<0>;       break;
+    }
+    
+    // initialize buffers, memory is taken from the pre-faulted arena
+    u.storage_format = get_storage_format();
+    u.n_bytes_per_window = get_storage_window_bytes(u.storage_format, u.n_bytes_per_item, u.measurement_length);
+    const size_t n_bytes_per_buffer = u.chunk_windows * u.n_bytes_per_window;
+    u.n_buffers = n_buffers_arg;
+    u.gate = is_window_gate_enabled();
+    u.pool.resize(u.n_buffers);
+    for(size_t i = 0; i < u.n_buffers; i++){
+        for(size_t ch = 0; ch < u.n_channels; ch++)
+            u.pool[i].buffs.push_back(buffer_t(n_bytes_per_buffer));
+        u.pool[i].flags.assign(u.chunk_windows, 0);
+        u.pool[i].file_number = 0;
+        u.pool[i].first_window = 0;
+        u.pool[i].n_windows = 0;
+        if(u.gate)
+            u.pool[i].power.assign(u.chunk_windows, 0.0f);
+    }
+    for(size_t ch = 0; ch < u.n_channels; ch++){
+        if(u.storage_format != CH_MEASUREMENT_STORAGE_NATIVE)
+            u.buffs_window.push_back(buffer_t(u.measurement_length * u.n_bytes_per_item));
+        if(u.n_average > 1)
+            u.buffs_average.push_back(buffer_t(get_average_window_bytes(u.measurement_length)));
+    }
+    u.average_complete = true;
+    u.steered = false;
+    
+    // the first buffer is filled, all others are free
+    u.buffer2write = 0;
+    u.ready_list.assign(u.n_buffers, 0);
+    u.free_list.assign(u.n_buffers, 0);
+    for(size_t i = 1; i < u.n_buffers; i++)
+        u.free_list[i - 1] = i;
+    u.ready_head = 0;
+    u.ready_tail = 0;
+    u.free_head = u.n_buffers - 1;
+    u.free_tail = 0;
+    u.occupancy_hist.assign(u.n_buffers, 0);
+    u.n_chunks_dropped = 0;
+    u.n_measurements_dropped = 0;
     
-static void print_data_init();
+    // compressed windows have a different size per channel, so there is one index entry per measurement and channel
+    u.codec = get_codec();
+    size_t n_index_entries = u.save_period;
+    if(u.codec != CH_MEASUREMENT_CODEC_RAW){
+        size_t n_buffers, n_bytes_per_compressed_buffer;
+        get_compression_buffer_size(u.n_channels, u.save_period, u.measurement_length, n_buffers, n_bytes_per_compressed_buffer);
+        for(size_t i = 0; i < n_buffers; i++)
+            u.buffs_compressed.push_back(buffer_t(n_bytes_per_compressed_buffer));
+        u.n_bytes_compressed_window.assign(u.n_channels*u.save_period, 0);
+        u.n_bytes_compressed_group.assign(n_buffers, 0);
+        n_index_entries = u.n_channels*u.save_period;
+    }
     
-int init_fifo_ch_measurement(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const unsigned int samp_rate_arg){
-    n_channels = n_channels_arg;
-    n_bytes_per_item = n_bytes_per_item_arg;
-    samp_rate = samp_rate_arg;
-    n_samples_per_period = samp_rate/CH_MEASUREMENT_PER_SEC;
+    // only the taps are saved, the windows are kept in the pool until they are correlated
+    u.cir_taps = get_cir_taps();
+    size_t n_bytes_per_saved_window = u.n_bytes_per_window;
+    if(u.cir_taps > 0){
+        n_bytes_per_saved_window = get_cir_window_bytes();
+        for(size_t ch = 0; ch < u.n_channels; ch++)
+            u.buffs_cir.push_back(buffer_t(u.chunk_windows * n_bytes_per_saved_window));
+    }
     
-    buffer2write = BUFFER0;
-    buffer2process = NO_BUFFER;
+    // header and index are padded, so the samples of each channel start aligned
+    const size_t n_bytes_header = sizeof(ch_measurement_file_header) + n_index_entries*sizeof(ch_measurement_index_entry);
+    u.header = buffer_t((n_bytes_header + CH_MEASUREMENT_FILE_ALIGNMENT - 1)/CH_MEASUREMENT_FILE_ALIGNMENT*CH_MEASUREMENT_FILE_ALIGNMENT);
+    u.channel_stride = (u.save_period * n_bytes_per_saved_window + CH_MEASUREMENT_FILE_ALIGNMENT - 1)/CH_MEASUREMENT_FILE_ALIGNMENT*CH_MEASUREMENT_FILE_ALIGNMENT;
+    u.stream_start_tick = 0;
+    u.seq_name = "";
+    u.seq_length = 0;
+    u.seq_checksum = 0;
+    u.file_open = false;
+    u.file_number_open = 0;
+    u.held = false;
+    u.buffer_held = 0;
+    u.gate_post_left = 0;
+    u.gate_next_measurement = 0;
     
-    // initialize buffers
-    std::vector<char> buff_template(CH_MEASUREMENT_SAVE_PERIOD * CH_MEASUREMENT_LENGTH_IN_SAMPLES * n_bytes_per_item);
-    for (size_t ch = 0; ch < n_channels; ch++){
-        buffs0.push_back(buff_template);
-        buffs1.push_back(buff_template);
+    // readers attach to the ring while we record
+    u.publish = is_shm_publisher_enabled();
+    if(u.publish){
+        if(create_shm_ring(u.n_channels, u.n_bytes_per_item, u.n_bytes_per_window, u.storage_format, u.samp_rate, u.n_samples_per_period, u.measurement_length, id) == 0)
+            return 0;
+        u.publish_windows.assign(u.n_channels, nullptr);
     }
     
-    d_STATE = COLLECT_CHANNEL_MEASUREMENT;
+    // state is set once the first samples arrive
+    u.d_STATE = WAIT_FOR_NEW_MEASUREMENT;
+
+    u.n_state_0 = 0;
+    u.n_state_1 = 0;
+    u.n_state_valid = 0;
+    u.n_measurement_counter = 0;
+    u.n_measurement_total = 0;
+    u.n_average_counter = 0;
+    
+    u.synced = false;
+    u.next_tick = 0;
 
-    n_state_0 = 0;
-    n_state_1 = 0;
-    n_measurement_counter = 0;
-    n_measurement_saved = 0;
+    print_data_init(u);
+    add_metrics_gauge("fifo_buffers_used", "fifo buffers waiting for or being saved by the save thread", fifo_buffers_used, id);
+    u.local_stats.reset();
+    
+    return 1;
+}
 
-    print_data_init();
-    local_stats.reset();
+int init_steered_capture(const size_t max_items_per_packet_arg, const size_t id){
+    fifo_unit &u = units[id];
+    
+    u.max_items_per_packet = max_items_per_packet_arg;
+    
+    // a single packet per channel, content is never read
+    for (size_t ch = 0; ch < u.n_channels; ch++){
+        u.buffs_scratch.push_back(buffer_t(u.max_items_per_packet * u.n_bytes_per_item));
+        u.buffs.push_back(&u.buffs_scratch[ch].front());
+    }
+    
+    // windows to be averaged are captured separately as well
+    if(u.n_average > 1 && u.buffs_window.empty()){
+        for(size_t ch = 0; ch < u.n_channels; ch++)
+            u.buffs_window.push_back(buffer_t(u.measurement_length * u.n_bytes_per_item));
+    }
+    u.steered = true;
     
     return 1;
 }
 
-void feed_new_ch_measurement(const std::vector<std::vector<char>> &buffs01, const unsigned long long n_new_samples){
-    DBG_RB(local_stats.n_samples_total += n_new_samples;)
+void feed_new_ch_measurement(const std::vector<const char*> &buffs01, const unsigned long long n_new_samples, const long long tick, const size_t id){
+    fifo_unit &u = units[id];
+    
+    DBG_RB(u.local_stats.n_samples_total += n_new_samples;)
+    
+    // first samples or samples were lost before this buffer
+    if(u.synced == false || tick != u.next_tick)
+        sync_to_tick(u, tick);
+    u.next_tick = tick + n_new_samples;
+    
+    u.feed(u, buffs01, n_new_samples);
+}
+
+// a whole window is copied with a size known at compile time, so the copy is inlined and unrolled, parts of windows at runtime size
+template<unsigned int LEN>
+static inline void copy_samples(char* destination, const char* source, const unsigned int n_samples, const size_t n_bytes_per_item){
+    if(LEN != 0 && n_samples == LEN && n_bytes_per_item == 4)
+        std::memcpy(destination, source, LEN*4);
+    else if(LEN != 0 && n_samples == LEN && n_bytes_per_item == 8)
+        std::memcpy(destination, source, LEN*8);
+    else
+        std::memcpy(destination, source, (size_t) n_samples*n_bytes_per_item);
+}
+
+// LEN is the measurement length, 0 for any length known at runtime only
+template<unsigned int LEN>
+static void feed_window(fifo_unit &u, const std::vector<const char*> &buffs01, const unsigned long long n_new_samples){
+    const unsigned int len = (LEN != 0) ? LEN : u.measurement_length;
+    
     unsigned int n_consumed_samples = 0;
 
     while(n_consumed_samples < n_new_samples)
     {
-        switch(d_STATE)
+        switch(u.d_STATE)
         {
             case COLLECT_CHANNEL_MEASUREMENT:
             {
                 unsigned int n_residual_samples = n_new_samples - n_consumed_samples;
-                unsigned int n_samples_until_measurement_complete = CH_MEASUREMENT_LENGTH_IN_SAMPLES - n_state_1;
+                unsigned int n_samples_until_measurement_complete = len - u.n_state_1;
                 unsigned int n_samples_usable = std::min(n_samples_until_measurement_complete, n_residual_samples);
                 
-                // save binary data of this measurement
-                unsigned int offest = (n_measurement_counter * CH_MEASUREMENT_LENGTH_IN_SAMPLES + n_state_1) * n_bytes_per_item;
-                for(size_t ch = 0; ch < n_channels; ch++){
-                    if(buffer2write == BUFFER0){
-                        auto destination = buffs0[ch].begin() + offest;
-                        auto source = buffs01[ch].begin() + n_consumed_samples*n_bytes_per_item;
-                        std::copy_n(source, n_samples_usable*n_bytes_per_item, destination);
+                // save binary data of this measurement, converted windows are collected separately, averaged windows are added up without a copy
+                for(size_t ch = 0; ch < u.n_channels; ch++){
+                    auto source = buffs01[ch] + n_consumed_samples*u.n_bytes_per_item;
+                    if(u.n_average > 1){
+                        accumulate_window(&u.buffs_average[ch][get_average_window_bytes(u.n_state_1)], source, u.n_bytes_per_item, n_samples_usable);
+                    }
+                    else if(u.storage_format != CH_MEASUREMENT_STORAGE_NATIVE){
+                        char* destination = &u.buffs_window[ch][u.n_state_1 * u.n_bytes_per_item];
+                        copy_samples<LEN>(destination, source, n_samples_usable, u.n_bytes_per_item);
                     }
-                    else if(buffer2write == BUFFER1){
-                        auto destination = buffs1[ch].begin() + offest;
-                        auto source = buffs01[ch].begin() + n_consumed_samples*n_bytes_per_item;
-                        std::copy_n(source, n_samples_usable*n_bytes_per_item, destination);
+                    else{
+                        char* destination = &u.pool[u.buffer2write].buffs[ch][(u.n_measurement_counter % u.chunk_windows) * u.n_bytes_per_window + u.n_state_1 * u.n_bytes_per_item];
+                        copy_samples<LEN>(destination, source, n_samples_usable, u.n_bytes_per_item);
                     }
                 }
 
-                n_state_1 += n_samples_usable;
+                u.n_state_1 += n_samples_usable;
+                u.n_state_valid += n_samples_usable;
                 n_consumed_samples += n_samples_usable;
 
                 // if this condition is met, we know that the measurement is complete
-                if(n_state_1 == CH_MEASUREMENT_LENGTH_IN_SAMPLES){
-                    d_STATE = WAIT_FOR_NEW_MEASUREMENT;
-                    n_state_0 = 0;
-                    n_state_1 = 0;
+                if(u.n_state_1 == len){
+                    u.d_STATE = WAIT_FOR_NEW_MEASUREMENT;
+                    u.n_state_0 = 0;
+                    u.n_state_1 = 0;
                     
-                    n_measurement_counter++;
-
-                    // trigger worker thread
-                    if (n_measurement_counter == CH_MEASUREMENT_SAVE_PERIOD){
-                        DBG_RB(local_stats.n_full++;)
-                        n_measurement_counter = 0;
-                        {
-                            boost::mutex::scoped_lock lock(m_mutex, boost::try_to_lock);
-
-                            // if we were able to lock the mutex, processing thread must be in waiting state, so we prepare processing and then notify worker thread
-                            if(lock){
-                                // swap buffers
-                                if(buffer2write == BUFFER0){
-                                    buffer2write = BUFFER1;
-                                    buffer2process = BUFFER0;
-                                }
-                                else{
-                                    buffer2write = BUFFER0;
-                                    buffer2process = BUFFER1;
-                                }
-                            }
-                            // if we were unable to lock the mutex, we write data into the same buffer again, therefore losing samples
-                            else{
-                                DBG_RB(local_stats.n_worker_not_done++;)
-                                buffer2process = NO_BUFFER;                
-                            }
-                        }
-                        m_condition.notify_all();
-                    }
+                    finish_ch_measurement(u);
                 }
             }
             case WAIT_FOR_NEW_MEASUREMENT:
             {
-                unsigned int n_residual_samples = n_new_samples - n_consumed_samples;
-                unsigned int n_samples_until_new_measurement = (n_samples_per_period - CH_MEASUREMENT_LENGTH_IN_SAMPLES) - n_state_0;
-                unsigned int n_samples_skippable = std::min(n_samples_until_new_measurement, n_residual_samples);
+                long long n_residual_samples = n_new_samples - n_consumed_samples;
+                long long n_samples_until_new_measurement = (long long) (u.n_samples_per_window - len) - u.n_state_0;
+                long long n_samples_skippable = std::min(n_samples_until_new_measurement, n_residual_samples);
 
-                n_state_0 += n_samples_skippable;
+                u.n_state_0 += n_samples_skippable;
                 n_consumed_samples += n_samples_skippable;
 
                 // if this condition is met, we know that a measurement is starting in this buffs01
                 if(n_samples_until_new_measurement < n_residual_samples){
-                    d_STATE = COLLECT_CHANNEL_MEASUREMENT;
-                    n_state_0 = 0;
-                    n_state_1 = 0;
+                    u.d_STATE = COLLECT_CHANNEL_MEASUREMENT;
+                    u.n_state_0 = 0;
+                    u.n_state_1 = 0;
                 }
             }                
         }
     }
 }
+
+std::vector<void*> get_fifo_ch_measurement_pointers(const unsigned long long n_new_samples, const long long tick, size_t &n_samples_max, const size_t id){
+    fifo_unit &u = units[id];
+    
+    DBG_RB(u.local_stats.n_samples_total += n_new_samples;)
+    
+    const long long n_samples_gap = u.n_samples_per_window - u.measurement_length;
+    
+    // first samples or samples were lost, the new samples were written assuming no loss and are discarded
+    if(n_new_samples > 0 && (u.synced == false || tick != u.next_tick)){
+        sync_to_tick(u, tick + n_new_samples);
+    }
+    // uhd never writes beyond n_samples_max, so a single call can at most complete the current state
+    else if(u.d_STATE == COLLECT_CHANNEL_MEASUREMENT){
+        u.n_state_1 += n_new_samples;
+        u.n_state_valid += n_new_samples;
+        if(u.n_state_1 == u.measurement_length){
+            u.d_STATE = WAIT_FOR_NEW_MEASUREMENT;
+            u.n_state_0 = 0;
+            u.n_state_1 = 0;
+            finish_ch_measurement(u);
+        }
+    }
+    else{
+        u.n_state_0 += n_new_samples;
+    }
+    
+    // a call without samples, e.g. after a timeout or an overflow, carries no valid tick
+    if(n_new_samples > 0)
+        u.next_tick = tick + n_new_samples;
+    
+    // measurements without gap in between
+    if(u.synced == true && u.d_STATE == WAIT_FOR_NEW_MEASUREMENT && u.n_state_0 == n_samples_gap){
+        u.d_STATE = COLLECT_CHANNEL_MEASUREMENT;
+        u.n_state_0 = 0;
+        u.n_state_1 = 0;
+    }
+    
+    // point directly into the current measurement of the write buffer, or into the window to be converted
+    if(u.synced == true && u.d_STATE == COLLECT_CHANNEL_MEASUREMENT){
+        const size_t offset = (u.n_measurement_counter % u.chunk_windows) * u.n_bytes_per_window + u.n_state_1 * u.n_bytes_per_item;
+        for(size_t ch = 0; ch < u.n_channels; ch++){
+            if(u.storage_format != CH_MEASUREMENT_STORAGE_NATIVE || u.n_average > 1)
+                u.buffs[ch] = static_cast<void*>(&u.buffs_window[ch][u.n_state_1 * u.n_bytes_per_item]);
+            else
+                u.buffs[ch] = static_cast<void*>(&u.pool[u.buffer2write].buffs[ch][offset]);
+        }
+        n_samples_max = u.measurement_length - u.n_state_1;
+    }
+    // samples between two measurements are written to scratch memory, before the first tick is known we only listen
+    else{
+        for(size_t ch = 0; ch < u.n_channels; ch++)
+            u.buffs[ch] = static_cast<void*>(&u.buffs_scratch[ch].front());
+        if(u.synced == true)
+            n_samples_max = std::min<size_t>(n_samples_gap - u.n_state_0, u.max_items_per_packet);
+        else
+            n_samples_max = u.max_items_per_packet;
+    }
+    
+    return u.buffs;
+}
    
-void send_save_ch_measurements(std::atomic<bool>& burst_timer_elapsed){
+void send_save_ch_measurements(std::atomic<bool>& burst_timer_elapsed, const size_t id){
+    fifo_unit &u = units[id];
     
     while(1){
-            boost::mutex::scoped_lock lock(m_mutex);
+            boost::mutex::scoped_lock lock(u.m_mutex);
         
-            while(buffer2process == NO_BUFFER){
-                DBG_RB(local_stats.n_worker_wait++;)
+            // buffers are saved in the order they were filled
+            const unsigned long long ready_tail = u.ready_tail.load(std::memory_order_relaxed);
+            while(u.ready_head.load(std::memory_order_acquire) == ready_tail){
+                DBG_RB(u.local_stats.n_worker_wait++;)
                                     
                 // from time to time we check if "burst_timer_elapsed" was set to true
-                m_condition.wait_for(lock, boost::chrono::milliseconds(1000));
+                // the feeding thread notifies without the mutex, so a notification may be missed and is picked up here
+                u.m_condition.wait_for(lock, boost::chrono::milliseconds(100));
                 
-                // is set in main thread to stop execution
-                if(burst_timer_elapsed == true)
+                // is set in main thread to stop execution, the last file may miss its remaining chunks
+                if(burst_timer_elapsed == true){
+                    if(u.held){
+                        save_buffer(u, u.pool[u.buffer_held], nullptr);
+                        release_buffer(u, u.buffer_held);
+                        u.held = false;
+                    }
+                    if(u.file_open)
+                        close_chunked_file(u);
                     return;
+                }
             }    
 
-            DBG_RB(local_stats.n_worker_executed++;)
+            DBG_RB(u.local_stats.n_worker_executed++;)
                 
-            // create, save and close file
-            std::ostringstream ss;
-            ss << std::setw(10) << std::setfill('0') << n_measurement_saved;
-            std::string str_n_measurement_saved = ss.str();
-            std::string folder_path = SAVE_PATH;
-            std::string file_name = "ch_measurement_";
-            std::string full_file_path = folder_path + file_name + str_n_measurement_saved + ".bin";
-            n_measurement_saved++;
-            std::ofstream fout(full_file_path, std::ios::out | std::ios::binary);
-            if(buffer2process == BUFFER0){
-                for(size_t ch = 0; ch < n_channels; ch++)
-                    fout.write((char*)&buffs0[ch][0], buffs0[ch].size()*sizeof(buffs0[ch][0]));
+            const size_t buffer2process = u.ready_list[ready_tail % u.n_buffers];
+            u.ready_tail.store(ready_tail + 1, std::memory_order_relaxed);
+            
+            // with the gate the previous buffer is saved now that its successor is known
+            if(u.gate){
+                if(u.held){
+                    save_buffer(u, u.pool[u.buffer_held], &u.pool[buffer2process]);
+                    release_buffer(u, u.buffer_held);
+                }
+                u.held = true;
+                u.buffer_held = buffer2process;
             }
             else{
-                for(size_t ch = 0; ch < n_channels; ch++)
-                    fout.write((char*)&buffs1[ch][0], buffs1[ch].size()*sizeof(buffs0[ch][0]));
+                save_buffer(u, u.pool[buffer2process], nullptr);
+                release_buffer(u, buffer2process);
+            }
+    }
+}
+
+static void save_buffer(fifo_unit &u, fifo_buffer &b, const fifo_buffer* next){
+    const unsigned long long t_save = latency_clock();
+    
+    // windows around triggers are kept, all others are marked and left out of the file
+    if(u.gate){
+        const unsigned long long first = b.file_number*u.save_period + b.first_window;
+        if(first != u.gate_next_measurement)
+            u.gate_post_left = 0;
+        u.gate_next_measurement = first + b.n_windows;
+        
+        const bool adjacent = (next != nullptr && next->file_number*u.save_period + next->first_window == u.gate_next_measurement);
+        select_windows(&b.power[0], &b.flags[0], b.n_windows,
+                       adjacent ? &next->power[0] : nullptr, adjacent ? &next->flags[0] : nullptr, adjacent ? next->n_windows : 0,
+                       u.gate_post_left, u.keep);
+        for(size_t k = 0; k < b.n_windows; k++){
+            if(u.keep[k] == 0)
+                b.flags[k] |= CH_MEASUREMENT_DISCARDED;
+        }
+        save_chunk(u, b);
+    }
+    // append to the current file
+    else if(u.chunk_windows < u.save_period)
+        save_chunk(u, b);
+    // create, save and close file
+    else
+        save_file(u, b);
+    
+    const unsigned long long t_saved = latency_clock();
+    record_latency(LATENCY_FIFO_SAVE, t_saved - t_save, u.id);
+    trace_span(TRACE_FIFO_SAVE, t_save, t_saved, b.file_number, u.id);
+}
+
+// we are done, hand the buffer back to the feeding thread
+static void release_buffer(fifo_unit &u, const size_t index){
+    const unsigned long long free_head = u.free_head.load(std::memory_order_relaxed);
+    u.free_list[free_head % u.n_buffers] = index;
+    u.free_head.store(free_head + 1, std::memory_order_release);
+}
+    
+static void save_file(fifo_unit &u, fifo_buffer &b){
+    std::ostringstream ss;
+    ss << std::setw(10) << std::setfill('0') << b.file_number;
+    std::string str_n_measurement_saved = ss.str();
+    std::string file_name = u.file_prefix + str_n_measurement_saved + ".bin";
+    std::vector<buffer_t> &buffs = b.buffs;
+    
+    std::vector<file_piece_t> pieces;
+    pieces.push_back(file_piece_t(&u.header[0], u.header.size()));
+    
+    // header, then the taps of each channel padded to the alignment
+    if(u.cir_taps > 0){
+        static const char padding[CH_MEASUREMENT_FILE_ALIGNMENT] = {0};
+        std::vector<const char*> buffs_in;
+        for(size_t ch = 0; ch < u.n_channels; ch++)
+            buffs_in.push_back(&buffs[ch][0]);
+        extract_cir(buffs_in, u.n_bytes_per_item, u.save_period, u.buffs_cir);
+        for(size_t ch = 0; ch < u.n_channels; ch++){
+            pieces.push_back(file_piece_t(&u.buffs_cir[ch][0], u.buffs_cir[ch].size()));
+            if(u.channel_stride > u.buffs_cir[ch].size())
+                pieces.push_back(file_piece_t(padding, u.channel_stride - u.buffs_cir[ch].size()));
+        }
+    }
+    // header, then each channel padded to the alignment
+    else if(u.codec == CH_MEASUREMENT_CODEC_RAW){
+        static const char padding[CH_MEASUREMENT_FILE_ALIGNMENT] = {0};
+        for(size_t ch = 0; ch < u.n_channels; ch++){
+            pieces.push_back(file_piece_t(&buffs[ch][0], buffs[ch].size()*sizeof(buffs[ch][0])));
+            if(u.channel_stride > buffs[ch].size())
+                pieces.push_back(file_piece_t(padding, u.channel_stride - buffs[ch].size()));
+        }
+    }
+    // header, then the compressed groups of each channel back to back
+    else{
+        std::vector<const char*> buffs_in;
+        for(size_t ch = 0; ch < u.n_channels; ch++)
+            buffs_in.push_back(&buffs[ch][0]);
+        compress_windows(buffs_in, u.save_period, u.measurement_length, u.buffs_compressed, u.n_bytes_compressed_window, u.n_bytes_compressed_group);
+        for(size_t i = 0; i < u.buffs_compressed.size(); i++)
+            pieces.push_back(file_piece_t(&u.buffs_compressed[i][0], u.n_bytes_compressed_group[i]));
+    }
+    
+    fill_file_header(u, b.file_number, &b.flags[0]);
+    const unsigned long long t_write = latency_clock();
+    write_file(file_name, pieces);
+    const unsigned long long t_written = latency_clock();
+    record_latency(LATENCY_FILE_WRITE, t_written - t_write, u.id);
+    trace_span(TRACE_FILE_WRITE, t_write, t_written, b.file_number, u.id);
+}
+
+static void save_chunk(fifo_unit &u, fifo_buffer &b){
+    // rotate, a file whose last chunk was dropped is closed here
+    if(u.file_open && u.file_number_open != b.file_number)
+        close_chunked_file(u);
+    
+    // ticks spent in write_file_at() for this chunk, without the cir extraction in between
+    unsigned long long n_write_ticks = 0;
+    unsigned long long t_write;
+    
+    // the file has its final size from the start, the index marks all measurements as incomplete until their chunk arrives
+    // with the gate the file is sparse, discarded measurements take no space
+    if(u.file_open == false){
+        std::ostringstream ss;
+        ss << std::setw(10) << std::setfill('0') << b.file_number;
+        std::string file_name = u.file_prefix + ss.str() + ".bin";
+        fill_file_header(u, b.file_number, nullptr);
+        const ch_measurement_file_header &h = *reinterpret_cast<ch_measurement_file_header*>(&u.header[0]);
+        if(open_file(file_name, h.file_bytes, u.gate == false, u.file) == 0)
+            return;
+        t_write = latency_clock();
+        write_file_at(u.file, 0, &u.header[0], u.header.size());
+        n_write_ticks += latency_clock() - t_write;
+        u.file_open = true;
+        u.file_number_open = b.file_number;
+        trace_instant(TRACE_FILE_OPEN, b.file_number, u.id);
+    }
+    
+    // samples or taps of each channel at their final position
+    size_t n_bytes_per_saved_window = u.n_bytes_per_window;
+    if(u.cir_taps > 0){
+        std::vector<const char*> buffs_in;
+        for(size_t ch = 0; ch < u.n_channels; ch++)
+            buffs_in.push_back(&b.buffs[ch][0]);
+        extract_cir(buffs_in, u.n_bytes_per_item, b.n_windows, u.buffs_cir);
+        n_bytes_per_saved_window = get_cir_window_bytes();
+    }
+    // runs of kept measurements, everything without the gate
+    for(size_t ch = 0; ch < u.n_channels; ch++){
+        const char* data = (u.cir_taps > 0) ? &u.buffs_cir[ch][0] : &b.buffs[ch][0];
+        const unsigned long long offset = u.header.size() + ch*u.channel_stride + b.first_window*n_bytes_per_saved_window;
+        size_t k0 = 0;
+        while(k0 < b.n_windows){
+            if(u.gate && u.keep[k0] == 0){
+                k0++;
+                continue;
             }
-            fout.close();
+            size_t k1 = k0 + 1;
+            while(k1 < b.n_windows && (u.gate == false || u.keep[k1] != 0))
+                k1++;
+            t_write = latency_clock();
+            write_file_at(u.file, offset + k0*n_bytes_per_saved_window, data + k0*n_bytes_per_saved_window, (k1 - k0)*n_bytes_per_saved_window);
+            n_write_ticks += latency_clock() - t_write;
+            k0 = k1;
+        }
+    }
+    
+    // flags of this chunk are written last, so a reader of the growing file never sees a complete measurement before its samples
+    ch_measurement_index_entry* index = reinterpret_cast<ch_measurement_index_entry*>(&u.header[sizeof(ch_measurement_file_header)]);
+    for(size_t k = 0; k < b.n_windows; k++)
+        index[b.first_window + k].flags = b.flags[k];
+    t_write = latency_clock();
+    write_file_at(u.file, sizeof(ch_measurement_file_header) + b.first_window*sizeof(ch_measurement_index_entry),
+                  reinterpret_cast<const char*>(&index[b.first_window]), b.n_windows*sizeof(ch_measurement_index_entry));
+    n_write_ticks += latency_clock() - t_write;
+    record_latency(LATENCY_FILE_WRITE, n_write_ticks, u.id);
+    
+    if(b.first_window + b.n_windows == u.save_period)
+        close_chunked_file(u);
+}
+
+static void close_chunked_file(fifo_unit &u){
+    close_file(u.file);
+    u.file_open = false;
+    trace_instant(TRACE_FILE_CLOSE, u.file_number_open, u.id);
+}
+
+// read by the metrics thread, buffers neither free nor being filled, as sampled in finish_ch_measurement()
+static unsigned long long fifo_buffers_used(const size_t id){
+    const fifo_unit &u = units[id];
+    const unsigned long long free_tail = u.free_tail.load(std::memory_order_relaxed);
+    const unsigned long long n_free = u.free_head.load(std::memory_order_relaxed) - free_tail;
+    return u.n_buffers - 1 - std::min<unsigned long long>(n_free, u.n_buffers - 1);
+}
+    
+void set_sequence_identity_fifo(const std::string &seq_name_arg, const unsigned long long seq_length_arg, const unsigned long long seq_checksum_arg, const size_t id){
+    fifo_unit &u = units[id];
+    
+    // the save thread reads these while holding the mutex
+    boost::mutex::scoped_lock lock(u.m_mutex);
+    u.seq_name = seq_name_arg;
+    u.seq_length = seq_length_arg;
+    u.seq_checksum = seq_checksum_arg;
+    
+    // the sequence starts at a different phase in each window, the average smears it out
+    if(u.n_average > 1 && u.seq_length > 0 && u.n_samples_per_window % u.seq_length != 0)
+        std::cerr << "fifo_ch_measurement: averaged windows are " << u.n_samples_per_window << " samples apart, not a multiple of the sequence length " << u.seq_length << ", the average is not coherent." << std::endl;
+}
 
-            // we are done, make sure we enter wait loop
-            buffer2process = NO_BUFFER;
+void show_debug_information_fifo(const size_t id){
+    std::ostringstream ss;
+    ss << "FIFO " << id << ":";
+    units[id].local_stats.print_data(ss.str());
+    
+    const fifo_unit &u = units[id];
+    std::cout << "--------------------------" << std::endl;
+    std::cout << ss.str() << " pool" << std::endl;
+    std::cout << "n_buffers: " << u.n_buffers << std::endl;
+    std::cout << "chunk_windows: " << u.chunk_windows << std::endl;
+    std::cout << "n_chunks_dropped: " << u.n_chunks_dropped << std::endl;
+    std::cout << "n_measurements_dropped: " << u.n_measurements_dropped << std::endl;
+    std::cout << "occupancy (buffers waiting or saving: files):";
+    for(size_t i = 0; i < u.occupancy_hist.size(); i++)
+        std::cout << " " << i << ":" << u.occupancy_hist[i];
+    std::cout << std::endl;
+    std::cout << "--------------------------" << std::endl;
+}
+
+static void sync_to_tick(fifo_unit &u, const long long tick){
+    const long long period = u.n_samples_per_window;
+    const long long n_samples_gap = period - u.measurement_length;
+    
+    // the first measurement starts at the next multiple of its period in device time, the first file is filled partially
+    if(u.synced == false){
+        u.synced = true;
+        u.stream_start_tick = tick;
+        const long long first_tick = (tick + u.n_samples_per_period - 1)/u.n_samples_per_period*u.n_samples_per_period;
+        u.n_measurement_total = first_tick/u.n_samples_per_period;
+        u.n_measurement_counter = u.n_measurement_total % u.save_period;
+        u.n_average_counter = 0;
+        
+        // wait until first_tick, may be longer than the regular gap
+        u.d_STATE = WAIT_FOR_NEW_MEASUREMENT;
+        u.n_state_0 = n_samples_gap - (first_tick - tick);
+        u.n_state_1 = 0;
+        return;
+    }
+    
+    // time went backwards, nothing we can align to
+    if(tick < u.next_tick)
+        return;
+    
+    DBG_RB(u.local_stats.n_samples_lost += tick - u.next_tick;)
+    add_metric(METRIC_SAMPLES_LOST, tick - u.next_tick);
+    
+    // in which window and where in its period are we?
+    const unsigned long long m = tick/period;
+    const long long phase = tick%period;
+    
+    // finish the window in progress and all windows we lost entirely, they keep their slot in the buffer
+    while(u.n_measurement_total*u.n_average + u.n_average_counter < m)
+        finish_ch_measurement(u);
+    
+    // continue current measurement with a hole of stale samples
+    if(phase < u.measurement_length){
+        u.d_STATE = COLLECT_CHANNEL_MEASUREMENT;
+        u.n_state_0 = 0;
+        u.n_state_1 = phase;
+    }
+    // the current measurement is lost as well
+    else{
+        if(u.n_measurement_total*u.n_average + u.n_average_counter == m)
+            finish_ch_measurement(u);
+        u.d_STATE = WAIT_FOR_NEW_MEASUREMENT;
+        u.n_state_0 = phase - u.measurement_length;
+        u.n_state_1 = 0;
     }
 }
+
+static void finish_ch_measurement(fifo_unit &u){
+    // convert the captured window into its slot, lost windows are converted as well and keep stale samples
+    fifo_buffer &b = u.pool[u.buffer2write];
+    const size_t slot = u.n_measurement_counter % u.chunk_windows;
+    if(u.n_average > 1 && average_window(u, b, slot) == false)
+        return;
+    if(u.storage_format != CH_MEASUREMENT_STORAGE_NATIVE){
+        for(size_t ch = 0; ch < u.n_channels; ch++)
+            convert_window(&u.buffs_window[ch][0], u.n_bytes_per_item, u.measurement_length, &b.buffs[ch][slot * u.n_bytes_per_window]);
+    }
+    
+    b.flags[slot] = (u.n_state_valid == u.measurement_length) ? CH_MEASUREMENT_COMPLETE : 0;
+    u.n_state_valid = 0;
+    add_metric(METRIC_WINDOWS_CAPTURED, 1);
+    if(b.flags[slot] == 0)
+        add_metric(METRIC_WINDOWS_INCOMPLETE, 1);
     
-void show_debug_information_fifo(){
-    local_stats.print_data("FIFO:");
+    // power of the native window, the save thread decides which windows are kept
+    if(u.gate){
+        float power = 0.0f;
+        for(size_t ch = 0; ch < u.n_channels; ch++){
+            const char* window = (u.storage_format != CH_MEASUREMENT_STORAGE_NATIVE) ? &u.buffs_window[ch][0] : &b.buffs[ch][slot * u.n_bytes_per_window];
+            power += window_power(window, u.n_bytes_per_item, u.measurement_length);
+        }
+        b.power[slot] = power/u.n_channels;
+    }
+    
+    // the window is final now, readers of the ring get a copy
+    if(u.publish){
+        for(size_t ch = 0; ch < u.n_channels; ch++)
+            u.publish_windows[ch] = &b.buffs[ch][slot * u.n_bytes_per_window];
+        publish_window(u.publish_windows, u.n_measurement_total, (long long) u.n_measurement_total*u.n_samples_per_period, b.flags[slot], u.id);
+    }
+    
+    u.n_measurement_counter++;
+    u.n_measurement_total++;
+
+    // trigger worker thread once the chunk or the file is complete
+    const bool file_complete = (u.n_measurement_counter == u.save_period);
+    if (slot + 1 == u.chunk_windows || file_complete){
+        DBG_RB(u.local_stats.n_full++;)
+        
+        // the file number follows the measurement number, so files of all pipelines with equal numbers cover the same time
+        b.file_number = (u.n_measurement_total - 1)/u.save_period;
+        b.first_window = u.n_measurement_counter - 1 - slot;
+        b.n_windows = slot + 1;
+        if(file_complete)
+            u.n_measurement_counter = 0;
+        
+        // buffers waiting for or being saved, the full one not included
+        const unsigned long long free_tail = u.free_tail.load(std::memory_order_relaxed);
+        const unsigned long long n_free = u.free_head.load(std::memory_order_acquire) - free_tail;
+        const size_t occupancy = u.n_buffers - 1 - n_free;
+        u.occupancy_hist[occupancy]++;
+        DBG_RB(u.local_stats.n_slots_high_water = std::max<unsigned long long>(u.local_stats.n_slots_high_water, occupancy);)
+        
+        // queue the full buffer and continue with a free one
+        if(n_free > 0){
+            const unsigned long long ready_head = u.ready_head.load(std::memory_order_relaxed);
+            u.ready_list[ready_head % u.n_buffers] = u.buffer2write;
+            u.ready_head.store(ready_head + 1, std::memory_order_release);
+            
+            u.buffer2write = u.free_list[free_tail % u.n_buffers];
+            u.free_tail.store(free_tail + 1, std::memory_order_release);
+            u.m_condition.notify_all();
+            trace_instant(TRACE_FIFO_SWAP, occupancy + 1, u.id);
+        }
+        // all other buffers wait for the save thread, we write data into the same buffer again, therefore losing this chunk
+        else{
+            DBG_RB(u.local_stats.n_worker_not_done++;)
+            u.n_chunks_dropped++;
+            u.n_measurements_dropped += b.n_windows;
+            add_metric(METRIC_WINDOWS_DROPPED, b.n_windows);
+            trace_instant(TRACE_FIFO_DROP, b.n_windows, u.id);
+        }
+        
+        // measurements of the next chunk are marked once they are finished
+        std::vector<uint32_t> &flags_next = u.pool[u.buffer2write].flags;
+        std::fill(flags_next.begin(), flags_next.end(), 0);
+    }
 }
     
-static void print_data_init(){
+// returns true once the last window of a measurement was added, the average then replaces the captured window
+static bool average_window(fifo_unit &u, fifo_buffer &b, const size_t slot){
+    if(u.steered){
+        for(size_t ch = 0; ch < u.n_channels; ch++)
+            accumulate_window(&u.buffs_average[ch][0], &u.buffs_window[ch][0], u.n_bytes_per_item, u.measurement_length);
+    }
+    if(u.n_state_valid != u.measurement_length)
+        u.average_complete = false;
+    u.n_state_valid = 0;
+    
+    if(++u.n_average_counter < u.n_average)
+        return false;
+    u.n_average_counter = 0;
+    
+    for(size_t ch = 0; ch < u.n_channels; ch++){
+        char* window = (u.storage_format != CH_MEASUREMENT_STORAGE_NATIVE) ? &u.buffs_window[ch][0] : &b.buffs[ch][slot * u.n_bytes_per_window];
+        finish_average(&u.buffs_average[ch][0], u.n_bytes_per_item, u.measurement_length, window);
+    }
+    
+    // the measurement is complete only if all of its windows were
+    u.n_state_valid = u.average_complete ? u.measurement_length : 0;
+    u.average_complete = true;
+    return true;
+}
+
+static void print_data_init(const fifo_unit &u){
     std::cout << "--------------------------" << std::endl;
     std::cout << "FIFO start statistics:" << std::endl;
-    std::cout << "CH_MEASUREMENT_PER_SEC: " << CH_MEASUREMENT_PER_SEC << std::endl;
-    std::cout << "CH_MEASUREMENT_LENGTH_IN_SAMPLES: " << CH_MEASUREMENT_LENGTH_IN_SAMPLES << std::endl;
-    std::cout << "CH_MEASUREMENT_SAVE_PERIOD_SEC: " << CH_MEASUREMENT_SAVE_PERIOD_SEC << std::endl;
-    std::cout << "CH_MEASUREMENT_SAVE_PERIOD: " << CH_MEASUREMENT_SAVE_PERIOD << std::endl;
-    std::cout << "n_channels: " << n_channels << std::endl;
-    std::cout << "n_bytes_per_item: " << n_bytes_per_item << std::endl;
-    std::cout << "samp_rate: " << samp_rate << std::endl;
-    std::cout << "n_samples_per_period: " << n_samples_per_period << std::endl;
+    std::cout << "measurements_per_sec: " << u.measurements_per_sec << std::endl;
+    std::cout << "measurement_length: " << u.measurement_length << std::endl;
+    std::cout << "save_period_sec: " << u.save_period_sec << std::endl;
+    std::cout << "save_period: " << u.save_period << std::endl;
+    std::cout << "n_buffers: " << u.n_buffers << std::endl;
+    std::cout << "chunk_windows: " << u.chunk_windows << std::endl;
+    std::cout << "n_channels: " << u.n_channels << std::endl;
+    std::cout << "n_bytes_per_item: " << u.n_bytes_per_item << std::endl;
+    std::cout << "samp_rate: " << u.samp_rate << std::endl;
+    std::cout << "n_samples_per_period: " << u.n_samples_per_period << std::endl;
+    std::cout << "n_average: " << u.n_average << std::endl;
+    std::cout << "file_prefix: " << u.file_prefix << std::endl;
+    std::cout << "storage: " << get_storage_data_type(u.storage_format, u.n_bytes_per_item) << std::endl;
+    std::cout << "cir_taps: " << u.cir_taps << std::endl;
+    std::cout << "gate: " << u.gate << std::endl;
     
     // how large will a single measurement be?
-    unsigned long long measurement_size_bytes = n_channels*CH_MEASUREMENT_LENGTH_IN_SAMPLES*n_bytes_per_item;
-    unsigned long long measurements_per_second_size_bytes = measurement_size_bytes*CH_MEASUREMENT_PER_SEC;
-    unsigned long long measurements_per_file_size_bytes = measurement_size_bytes*CH_MEASUREMENT_SAVE_PERIOD;
+    unsigned long long measurement_size_bytes = u.n_channels*((u.cir_taps > 0) ? get_cir_window_bytes() : u.n_bytes_per_window);
+    unsigned long long measurements_per_second_size_bytes = measurement_size_bytes*u.measurements_per_sec;
+    unsigned long long measurements_per_file_size_bytes = measurement_size_bytes*u.save_period;
     unsigned long long measurements_per_minute_size_bytes = measurements_per_second_size_bytes*60;
     
     std::cout << "measurement_size_bytes: " << measurement_size_bytes << std::endl;
     std::cout << "measurements_per_second_size_bytes: " << measurements_per_second_size_bytes << std::endl;
     std::cout << "measurements_per_file_size_bytes: " << measurements_per_file_size_bytes << std::endl;
+    std::cout << "pool_size_bytes: " << (unsigned long long) u.n_buffers*u.n_channels*u.chunk_windows*u.n_bytes_per_window << std::endl;
     std::cout << "measurements_per_minute_size_bytes: " << measurements_per_minute_size_bytes << std::endl;
     std::cout << "--------------------------" << std::endl;    
 }
+
+static void fill_file_header(fifo_unit &u, const unsigned long long file_number, const uint32_t* flags){
+    std::fill(u.header.begin(), u.header.end(), 0);
+    
+    ch_measurement_file_header &h = *reinterpret_cast<ch_measurement_file_header*>(&u.header[0]);
+    memcpy(h.magic, CH_MEASUREMENT_FILE_MAGIC, sizeof(CH_MEASUREMENT_FILE_MAGIC));
+    h.version = CH_MEASUREMENT_FILE_VERSION;
+    h.header_bytes = u.header.size();
+    h.index_offset = sizeof(ch_measurement_file_header);
+    
+    h.n_channels = u.n_channels;
+    h.n_bytes_per_item = u.n_bytes_per_item;
+    strncpy(h.data_type, (u.cir_taps > 0) ? "fc32" : get_storage_data_type(u.storage_format, u.n_bytes_per_item), sizeof(h.data_type) - 1);
+    h.samp_rate = u.samp_rate;
+    h.n_samples_per_period = u.n_samples_per_period;
+    h.measurement_length = u.measurement_length;
+    h.measurements_per_sec = u.measurements_per_sec;
+    h.save_period_sec = u.save_period_sec;
+    h.n_measurements = u.save_period;
+    h.channel_stride = (u.codec == CH_MEASUREMENT_CODEC_RAW) ? u.channel_stride : 0;
+    
+    h.file_number = file_number;
+    h.first_measurement = file_number*u.save_period;
+    h.first_tick = h.first_measurement*u.n_samples_per_period;
+    h.first_time_full_secs = h.first_tick/u.samp_rate;
+    h.first_time_frac_secs = (double) (h.first_tick%u.samp_rate)/u.samp_rate;
+    h.stream_start_tick = u.stream_start_tick;
+    h.host_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    
+    strncpy(h.seq_name, u.seq_name.c_str(), sizeof(h.seq_name) - 1);
+    h.seq_length = u.seq_length;
+    h.seq_checksum = u.seq_checksum;
+    strncpy(h.file_prefix, u.file_prefix.c_str(), sizeof(h.file_prefix) - 1);
+    h.storage_format = u.storage_format;
+    h.storage_scale = get_storage_scale(u.storage_format, u.n_bytes_per_item);
+    h.codec = u.codec;
+    h.codec_param = (u.codec == CH_MEASUREMENT_CODEC_SC16_DELTA) ? SC16_CODEC_KEYFRAME_INTERVAL : 0;
+    h.content = (u.cir_taps > 0) ? CH_MEASUREMENT_CONTENT_CIR : CH_MEASUREMENT_CONTENT_SAMPLES;
+    if(u.cir_taps > 0){
+        h.n_tx_channels = get_cir_tx_channels();
+        h.cir_taps = u.cir_taps;
+        h.cir_tap_offset = get_cir_tap_offset();
+    }
+    if(u.gate){
+        h.gate = 1;
+        h.gate_threshold_db = get_gate_threshold_db();
+        h.gate_pre = get_gate_pre();
+        h.gate_post = get_gate_post();
+    }
+    h.n_average = u.n_average;
+    
+    ch_measurement_index_entry* index = reinterpret_cast<ch_measurement_index_entry*>(&u.header[h.index_offset]);
+    if(u.codec == CH_MEASUREMENT_CODEC_RAW){
+        const size_t n_bytes_per_saved_window = (u.cir_taps > 0) ? get_cir_window_bytes() : u.n_bytes_per_window;
+        for(size_t k = 0; k < u.save_period; k++){
+            index[k].tick = h.first_tick + (long long) k*u.n_samples_per_period;
+            index[k].offset = h.header_bytes + k*n_bytes_per_saved_window;
+            index[k].n_bytes = n_bytes_per_saved_window;
+            index[k].flags = (flags != nullptr) ? flags[k] : 0;
+        }
+        h.file_bytes = h.header_bytes + u.n_channels*u.channel_stride;
+    }
+    else{
+        unsigned long long offset = h.header_bytes;
+        for(size_t ch = 0; ch < u.n_channels; ch++){
+            for(size_t k = 0; k < u.save_period; k++){
+                ch_measurement_index_entry &e = index[ch*u.save_period + k];
+                e.tick = h.first_tick + (long long) k*u.n_samples_per_period;
+                e.offset = offset;
+                e.n_bytes = u.n_bytes_compressed_window[ch*u.save_period + k];
+                e.flags = flags[k];
+                offset += e.n_bytes;
+            }
+        }
+        h.file_bytes = offset;
+    }
+}
 }
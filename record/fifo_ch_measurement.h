@@ -20,40 +20,86 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <atomic>
+#include <string>
+
+#include "buffer_allocator.h"
 
 namespace channelsounder
 {
 /*!
  * Inits unit internally. Must be called first.
+ * There is one independent fifo per rx pipeline, all other functions must be called with the same id.
+ * Measurements start at multiples of the measurement period in device time, so fifos of different pipelines stay aligned.
  *
  * num_channels_arg             in our case this is the number of rx antennas
  * num_bytes_per_item_arg       one item is one complex sample with real and imag, e.g. with data type "float" it is num_bytes_per_item_arg=8
- * samp_rate_arg                sampling rate for each rx channel in Samples/s
+ * samp_rate_arg                sampling rate for each rx channel in Samples/s, must be a multiple of measurements_per_sec_arg
+ * measurements_per_sec_arg     number of channel measurements per second
+ * measurement_length_arg       number of complex samples per channel measurement, at most samp_rate_arg/measurements_per_sec_arg
+ * save_period_sec_arg          seconds of measurements per saved file
+ * n_buffers_arg                number of buffers, one is filled while the others wait for the save thread, at least 2
+ * chunk_windows_arg            measurements per buffer, the save thread appends each full buffer to the current file, 0 to buffer and write whole files
+ * file_prefix_arg              name of saved files without number and extension, e.g. "ch_measurement_"
+ * id                           index of the pipeline, smaller than MAX_PIPELINES
  * return                       1 on success and 0 on failure
 */
-int init_fifo_ch_measurement(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const unsigned int samp_rate_arg);
+int init_fifo_ch_measurement(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const unsigned int samp_rate_arg,
+                             const unsigned int measurements_per_sec_arg, const unsigned int measurement_length_arg, const unsigned int save_period_sec_arg,
+                             const size_t n_buffers_arg, const unsigned int chunk_windows_arg, const std::string &file_prefix_arg, const size_t id);
+
+/*!
+ * Enables steered capture, must be called after init_fifo_ch_measurement().
+ * In steered capture uhd writes measurement windows directly into the fifo, ringbuffer rx is not used.
+ *
+ * max_items_per_packet_arg     maximum number of samples passed on by uhd driver, size of the scratch memory between measurements
+ * return                       1 on success and 0 on failure
+*/
+int init_steered_capture(const size_t max_items_per_packet_arg, const size_t id);
+
+/*!
+ * Steered capture, replaces ringbuffer rx and feed_new_ch_measurement().
+ * Must be called initially with n_new_samples=0.
+ *
+ * n_new_samples                number of new samples written per channel to pointers from last call
+ * tick                         device time of the first new sample in samples, e.g. md.time_spec.to_ticks(rate)
+ * n_samples_max                set to the number of samples uhd may write to the returned pointers, never crosses the border of a measurement
+ * return                       pointers into the current measurement of the fifo during a measurement, pointers to scratch memory in between
+*/
+std::vector<void*> get_fifo_ch_measurement_pointers(const unsigned long long n_new_samples, const long long tick, size_t &n_samples_max, const size_t id);
 
 /*!
  * Feed buffered samples. Size of single samples is known after initialization.
+ * If tick is not where the last call ended, samples were lost and the fifo realigns to the measurement period.
  *
  * buffs01                      vector of pointer to samples of individual channels
  * n_new_samples                number of new samples in buffer, buffer is guaranteed to be large enough
+ * tick                         device time of the first sample in samples, e.g. md.time_spec.to_ticks(rate)
 */  
-void feed_new_ch_measurement(const std::vector<std::vector<char>> &buffs01, const unsigned long long n_new_samples);
+void feed_new_ch_measurement(const std::vector<const char*> &buffs01, const unsigned long long n_new_samples, const long long tick, const size_t id);
     
 /*!
- * Must be started in additional thread, processes unused half of fifo.
- * Saves measurements in binary file in ../data.
- * Must process faster than it takes to fill one fifo half, otherwise measurements are dropped.
+ * Must be started in additional thread, processes the full buffers of the fifo in the order they were filled.
+ * Saves measurements in binary file in ../data, format see ch_measurement_format.h.
+ * Must keep up on average, a single slow write is absorbed by the pool. If no buffer is free, the chunk being filled is dropped.
+ * With chunks a file is created at its first chunk and each chunk is written at its final position, measurements not yet written are marked incomplete.
  *
  * burst_timer_elapsed          when set to true, the thread has to finish
 */    
-void send_save_ch_measurements(std::atomic<bool>& burst_timer_elapsed);
+void send_save_ch_measurements(std::atomic<bool>& burst_timer_elapsed, const size_t id);
     
+/*!
+ * Sets the identity of the tx sequence, which is recorded in the header of all following files.
+ *
+ * seq_name_arg                 name of the sequence, e.g. "sine_1mhz"
+ * seq_length_arg               length of one period in complex samples
+ * seq_checksum_arg             checksum of one period, see get_sequence_identity()
+*/
+void set_sequence_identity_fifo(const std::string &seq_name_arg, const unsigned long long seq_length_arg, const unsigned long long seq_checksum_arg, const size_t id);
+
 /*!
  * Shows some stats of the fifo.
 */    
-void show_debug_information_fifo();
+void show_debug_information_fifo(const size_t id);
 }
  
 #endif
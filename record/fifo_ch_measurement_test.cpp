@@ -0,0 +1,80 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <vector>
+
+#include "fifo_ch_measurement.h"
+#include "buffer_allocator.h"
+#include "file_writer.h"
+#include "compression.h"
+#include "storage_format.h"
+#include "shm_publisher.h"
+#include "window_gate.h"
+#include "window_average.h"
+#include "metrics.h"
+
+/***********************************************************************
+ * Regression test of the steered capture of the fifo: a recv() returning
+ * no samples, e.g. after a timeout or an overflow, passes a stale tick and
+ * must not make the fifo count samples as lost.
+ **********************************************************************/
+#define N_CHANNELS              2
+#define N_BYTES_PER_ITEM        4
+#define RX_RATE                 1000000
+#define MEASUREMENTS_PER_SEC    1000            // 1000 samples per period
+#define MEASUREMENT_LENGTH      500
+#define N_MAX_SAMPLES           300
+#define TICK_START              600             // in the gap between two windows, so the first packet discarded on sync costs no window
+#define N_SAMPLES               20000
+
+int main()
+{
+    channelsounder::init_buffer_allocator(channelsounder::PAGES_4KB, -1, false);
+    channelsounder::init_file_writer(channelsounder::WRITER_OFSTREAM, 1, 1024*1024, std::vector<std::string>(1, "./"), 0);
+    channelsounder::init_compression(CH_MEASUREMENT_CODEC_RAW, 0);
+    channelsounder::init_storage_format(CH_MEASUREMENT_STORAGE_NATIVE);
+    channelsounder::init_shm_publisher("", 1024);
+    channelsounder::init_window_gate(false, 0.0f, 10, 10);
+    channelsounder::init_window_average(1);
+    if (not channelsounder::init_fifo_ch_measurement(N_CHANNELS, N_BYTES_PER_ITEM, RX_RATE, MEASUREMENTS_PER_SEC, MEASUREMENT_LENGTH, 10, 4, 0, "test_", 0)
+        or not channelsounder::init_steered_capture(N_MAX_SAMPLES, 0)) {
+        return 1;
+    }
+    
+    // every packet is followed by a call without samples, which still carries the tick of that packet
+    size_t n_samples_max = N_MAX_SAMPLES;
+    long long tick = TICK_START;
+    channelsounder::get_fifo_ch_measurement_pointers(0, tick, n_samples_max, 0);
+    while (tick < TICK_START + N_SAMPLES) {
+        const size_t n_new_samples = n_samples_max;
+        channelsounder::get_fifo_ch_measurement_pointers(n_new_samples, tick, n_samples_max, 0);
+        channelsounder::get_fifo_ch_measurement_pointers(0, tick, n_samples_max, 0);
+        tick += n_new_samples;
+    }
+    
+    const unsigned long long n_lost = channelsounder::get_metric_total(channelsounder::METRIC_SAMPLES_LOST);
+    const unsigned long long n_captured = channelsounder::get_metric_total(channelsounder::METRIC_WINDOWS_CAPTURED);
+    const unsigned long long n_incomplete = channelsounder::get_metric_total(channelsounder::METRIC_WINDOWS_INCOMPLETE);
+    std::cout << "samples lost: " << n_lost << ", windows captured: " << n_captured << ", incomplete: " << n_incomplete << std::endl;
+    
+    if (n_lost != 0 or n_incomplete != 0 or n_captured != N_SAMPLES/(RX_RATE/MEASUREMENTS_PER_SEC)) {
+        std::cerr << "FAILED" << std::endl;
+        return 1;
+    }
+    return 0;
+}
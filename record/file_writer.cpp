@@ -0,0 +1,791 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <deque>
+#include <sstream>
+#include <boost/thread/thread.hpp>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#include "buffer_allocator.h"
+#include "file_writer.h"
+#include "metrics.h"
+
+#define WRITER_ALIGNMENT        4096        // O_DIRECT requires aligned address, length and offset
+#define MAX_SAVE_PATHS          16          // maximum number of output directories, one writer thread each
+
+namespace channelsounder
+{
+// one io_uring instance and its staging buffers, owned by a single save thread
+struct writer_context{
+    int ring_fd;                            // -1 if io_uring is not available, we use pwrite then
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+
+    std::vector<char*> staging;             // queue_depth aligned buffers of chunk_bytes each
+};
+
+static writer_backend_enum backend;
+static size_t queue_depth;
+static size_t chunk_bytes;
+
+static thread_local writer_context *ctx = nullptr;
+
+// stats, only touched once per file
+static unsigned long long n_files;
+static unsigned long long n_files_failed;
+static unsigned long long n_bytes_written;
+static unsigned long long n_direct_fallback;    // files written without O_DIRECT, e.g. on tmpfs
+static unsigned long long n_uring_fallback;     // threads which could not set up io_uring
+static std::chrono::nanoseconds t_total;
+static std::chrono::nanoseconds t_min;
+static std::chrono::nanoseconds t_max;
+static double throughput_min;                   // MB/s of the slowest file
+
+// stats of files written piecewise, see open_file()
+static unsigned long long n_files_piecewise;
+static unsigned long long n_writes_piecewise;
+static unsigned long long n_writes_piecewise_failed;
+static std::chrono::nanoseconds t_piecewise_total;
+static std::chrono::nanoseconds t_piecewise_max;
+
+static boost::mutex m_mutex;
+
+// one writer thread per output directory, only used with more than one directory
+struct device_job{
+    std::string full_file_path;
+    std::vector<file_piece_t> pieces;
+    struct device_done *done;
+};
+
+// shared by all jobs of one file, the caller waits until n_pending is zero
+struct device_done{
+    boost::mutex m_mutex;
+    boost::condition_variable m_condition;
+    size_t n_pending;
+    int ret;
+};
+
+struct device_unit{
+    std::string save_path;
+    std::deque<device_job> jobs;
+    boost::mutex m_mutex;
+    boost::condition_variable m_condition;
+    unsigned long long n_files;
+    unsigned long long n_bytes_written;
+};
+
+static device_unit *devices;                    // never freed, the writer threads live until the process ends
+static size_t n_devices;
+static size_t stripe_bytes;                     // 0 to distribute whole files round robin
+static unsigned long long n_file_next_device;   // round robin counter for whole files
+
+static writer_context* get_context();
+static int write_single_file(const std::string &full_file_path, const std::vector<file_piece_t> &pieces);
+static int write_file_ofstream(const std::string &full_file_path, const std::vector<file_piece_t> &pieces);
+static int write_file_direct(const std::string &full_file_path, const std::vector<file_piece_t> &pieces, bool &direct);
+static int write_stripe_index(const std::string &file_name, const unsigned long long n_bytes);
+static int pwrite_all(const int fd, const char* data, size_t n_bytes, unsigned long long offset);
+static void slice_pieces(const std::vector<file_piece_t> &pieces, unsigned long long begin, unsigned long long end, std::vector<file_piece_t> &out);
+static void device_worker(const size_t d);
+static int probe_io_uring();
+static size_t fill_chunk(char* dst, const std::vector<file_piece_t> &pieces, size_t &piece, size_t &piece_offset);
+
+int init_file_writer(const writer_backend_enum backend_arg, const size_t queue_depth_arg, const size_t chunk_bytes_arg,
+                     const std::vector<std::string> &save_paths, const size_t stripe_bytes_arg){
+    if(queue_depth_arg == 0 || chunk_bytes_arg == 0){
+        std::cerr << "file_writer: queue depth and chunk size must be larger than 0" << std::endl;
+        return 0;
+    }
+    if(save_paths.size() == 0 || save_paths.size() > MAX_SAVE_PATHS){
+        std::cerr << "file_writer: between 1 and " << MAX_SAVE_PATHS << " save paths are supported" << std::endl;
+        return 0;
+    }
+
+    if(backend_arg == WRITER_IO_URING && probe_io_uring() == 0)
+        return 0;
+
+    backend = backend_arg;
+    queue_depth = queue_depth_arg;
+    chunk_bytes = (chunk_bytes_arg + WRITER_ALIGNMENT - 1)/WRITER_ALIGNMENT*WRITER_ALIGNMENT;
+    stripe_bytes = stripe_bytes_arg;
+
+    n_files = 0;
+    n_files_failed = 0;
+    n_bytes_written = 0;
+    n_direct_fallback = 0;
+    n_uring_fallback = 0;
+    t_total = std::chrono::nanoseconds(0);
+    t_min = std::chrono::nanoseconds::max();
+    t_max = std::chrono::nanoseconds(0);
+    throughput_min = 0.0;
+    n_files_piecewise = 0;
+    n_writes_piecewise = 0;
+    n_writes_piecewise_failed = 0;
+    t_piecewise_total = std::chrono::nanoseconds(0);
+    t_piecewise_max = std::chrono::nanoseconds(0);
+
+    n_devices = save_paths.size();
+    n_file_next_device = 0;
+    devices = new device_unit[n_devices];
+    for(size_t d = 0; d < n_devices; d++){
+        devices[d].save_path = save_paths[d];
+        if(devices[d].save_path.empty() == false && devices[d].save_path.back() != '/')
+            devices[d].save_path += '/';
+        devices[d].n_files = 0;
+        devices[d].n_bytes_written = 0;
+    }
+
+    // with a single directory the calling thread writes itself
+    if(n_devices > 1){
+        for(size_t d = 0; d < n_devices; d++)
+            boost::thread(device_worker, d).detach();
+    }
+
+    return 1;
+}
+
+int parse_writer_backend(const std::string &str, writer_backend_enum &backend_out){
+    if(str == "ofstream")
+        backend_out = WRITER_OFSTREAM;
+    else if(str == "io_uring")
+        backend_out = WRITER_IO_URING;
+    else
+        return 0;
+    return 1;
+}
+
+int write_file(const std::string &file_name, const std::vector<file_piece_t> &pieces){
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    unsigned long long n_bytes = 0;
+    for(size_t i = 0; i < pieces.size(); i++)
+        n_bytes += pieces[i].second;
+
+    int ret;
+    if(n_devices == 1){
+        ret = write_single_file(devices[0].save_path + file_name, pieces);
+        boost::mutex::scoped_lock lk(m_mutex);
+        devices[0].n_files++;
+        devices[0].n_bytes_written += n_bytes;
+    }
+    else{
+        device_done done;
+        done.ret = 1;
+
+        // whole file to the next device
+        if(stripe_bytes == 0){
+            size_t d;
+            {
+                boost::mutex::scoped_lock lk(m_mutex);
+                d = n_file_next_device++ % n_devices;
+            }
+            done.n_pending = 1;
+            device_job job = {devices[d].save_path + file_name, pieces, &done};
+            boost::mutex::scoped_lock lk(devices[d].m_mutex);
+            devices[d].jobs.push_back(job);
+            devices[d].m_condition.notify_one();
+        }
+        // stripe k goes to device k%n_devices, each device writes its stripes back to back into <file_name>.part<d>
+        else{
+            done.n_pending = n_devices;
+            for(size_t d = 0; d < n_devices; d++){
+                std::ostringstream ss;
+                ss << devices[d].save_path << file_name << ".part" << d;
+                device_job job = {ss.str(), std::vector<file_piece_t>(), &done};
+                for(unsigned long long begin = d*stripe_bytes; begin < n_bytes; begin += n_devices*stripe_bytes)
+                    slice_pieces(pieces, begin, std::min<unsigned long long>(begin + stripe_bytes, n_bytes), job.pieces);
+                boost::mutex::scoped_lock lk(devices[d].m_mutex);
+                devices[d].jobs.push_back(job);
+                devices[d].m_condition.notify_one();
+            }
+            if(write_stripe_index(file_name, n_bytes) == 0)
+                done.ret = 0;
+        }
+
+        boost::mutex::scoped_lock lk(done.m_mutex);
+        while(done.n_pending > 0)
+            done.m_condition.wait(lk);
+        ret = done.ret;
+    }
+
+    std::chrono::nanoseconds t = std::chrono::steady_clock::now() - t1;
+
+    boost::mutex::scoped_lock lk(m_mutex);
+    if(ret == 0){
+        n_files_failed++;
+        add_metric(METRIC_WRITE_ERRORS, 1);
+        return 0;
+    }
+    n_files++;
+    n_bytes_written += n_bytes;
+    add_metric(METRIC_FILES_WRITTEN, 1);
+    add_metric(METRIC_BYTES_WRITTEN, n_bytes);
+    t_total += t;
+    t_min = std::min(t_min, t);
+    t_max = std::max(t_max, t);
+    const double throughput = n_bytes/(std::chrono::duration_cast<std::chrono::microseconds>(t).count() + 1.0);
+    if(n_files == 1 || throughput < throughput_min)
+        throughput_min = throughput;
+
+    return 1;
+}
+
+int open_file(const std::string &file_name, const unsigned long long n_bytes, const bool reserve, file_handle_t &handle){
+    handle.file_name = file_name;
+    handle.fds.clear();
+    handle.n_bytes = n_bytes;
+
+    // whole file to the next device or one part per device, each part has its final size right away
+    std::vector<std::string> paths;
+    std::vector<unsigned long long> part_bytes;
+    if(stripe_bytes == 0){
+        size_t d;
+        {
+            boost::mutex::scoped_lock lk(m_mutex);
+            d = n_file_next_device++ % n_devices;
+            devices[d].n_files++;
+        }
+        paths.push_back(devices[d].save_path + file_name);
+        part_bytes.push_back(n_bytes);
+    }
+    else{
+        const unsigned long long n_stripes = (n_bytes + stripe_bytes - 1)/stripe_bytes;
+        for(size_t d = 0; d < n_devices; d++){
+            std::ostringstream ss;
+            ss << devices[d].save_path << file_name << ".part" << d;
+            paths.push_back(ss.str());
+
+            // full stripes of this part, the last stripe of the file may be short
+            unsigned long long n = (n_stripes/n_devices + (d < n_stripes % n_devices ? 1 : 0))*stripe_bytes;
+            if(n_stripes > 0 && (n_stripes - 1) % n_devices == d)
+                n -= n_stripes*stripe_bytes - n_bytes;
+            part_bytes.push_back(n);
+        }
+        if(write_stripe_index(file_name, n_bytes) == 0)
+            return 0;
+        boost::mutex::scoped_lock lk(m_mutex);
+        for(size_t d = 0; d < n_devices; d++)
+            devices[d].n_files++;
+    }
+
+    for(size_t i = 0; i < paths.size(); i++){
+        const int fd = open(paths[i].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0){
+            std::cerr << "file_writer: could not open " << paths[i] << ": " << strerror(errno) << std::endl;
+            close_file(handle);
+            return 0;
+        }
+        handle.fds.push_back(fd);
+
+        // reserve extents up front, file systems without fallocate get a sparse file
+        bool reserved = false;
+        if(part_bytes[i] > 0 && reserve){
+            if(fallocate(fd, 0, 0, part_bytes[i]) == 0)
+                reserved = true;
+            else if(errno != EOPNOTSUPP){
+                std::cerr << "file_writer: could not reserve " << part_bytes[i] << " bytes for " << paths[i] << ": " << strerror(errno) << std::endl;
+                close_file(handle);
+                return 0;
+            }
+        }
+        if(part_bytes[i] > 0 && reserved == false && ftruncate(fd, part_bytes[i]) != 0){
+            std::cerr << "file_writer: could not resize " << paths[i] << ": " << strerror(errno) << std::endl;
+            close_file(handle);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int write_file_at(const file_handle_t &handle, const unsigned long long offset, const char* data, const size_t n_bytes){
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    int ret = 1;
+    if(handle.fds.empty() || offset + n_bytes > handle.n_bytes)
+        ret = 0;
+    else if(stripe_bytes == 0)
+        ret = pwrite_all(handle.fds[0], data, n_bytes, offset);
+    // stripe k goes to part k%n_devices at offset (k/n_devices)*stripe_bytes
+    else{
+        unsigned long long pos = offset;
+        size_t done = 0;
+        while(ret == 1 && done < n_bytes){
+            const unsigned long long k = pos/stripe_bytes;
+            const unsigned long long in_stripe = pos%stripe_bytes;
+            const size_t n = std::min<unsigned long long>(n_bytes - done, stripe_bytes - in_stripe);
+            ret = pwrite_all(handle.fds[k % n_devices], data + done, n, (k/n_devices)*stripe_bytes + in_stripe);
+            pos += n;
+            done += n;
+        }
+    }
+
+    std::chrono::nanoseconds t = std::chrono::steady_clock::now() - t1;
+
+    boost::mutex::scoped_lock lk(m_mutex);
+    if(ret == 0){
+        n_writes_piecewise_failed++;
+        add_metric(METRIC_WRITE_ERRORS, 1);
+        std::cerr << "file_writer: could not write " << handle.file_name << " at offset " << offset << std::endl;
+        return 0;
+    }
+    n_writes_piecewise++;
+    n_bytes_written += n_bytes;
+    add_metric(METRIC_BYTES_WRITTEN, n_bytes);
+    t_piecewise_total += t;
+    t_piecewise_max = std::max(t_piecewise_max, t);
+
+    return 1;
+}
+
+int close_file(file_handle_t &handle){
+    int ret = 1;
+    for(size_t i = 0; i < handle.fds.size(); i++){
+        if(close(handle.fds[i]) != 0)
+            ret = 0;
+    }
+    const bool opened = handle.fds.empty() == false;
+    handle.fds.clear();
+
+    boost::mutex::scoped_lock lk(m_mutex);
+    if(ret == 0 || opened == false){
+        n_files_failed++;
+        add_metric(METRIC_WRITE_ERRORS, 1);
+        return 0;
+    }
+    n_files_piecewise++;
+    add_metric(METRIC_FILES_WRITTEN, 1);
+    return 1;
+}
+
+void show_debug_information_file_writer(){
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "File writer:" << std::endl;
+    std::cout << "backend: " << (backend == WRITER_IO_URING ? "io_uring" : "ofstream") << std::endl;
+    if(backend == WRITER_IO_URING){
+        std::cout << "queue_depth: " << queue_depth << std::endl;
+        std::cout << "chunk_bytes: " << chunk_bytes << std::endl;
+        std::cout << "n_uring_fallback: " << n_uring_fallback << std::endl;
+        std::cout << "n_direct_fallback: " << n_direct_fallback << std::endl;
+    }
+    std::cout << "stripe_bytes: " << stripe_bytes << std::endl;
+    for(size_t d = 0; d < n_devices; d++)
+        std::cout << "Device " << d << " " << devices[d].save_path << " n_files: " << devices[d].n_files << " n_bytes_written: " << devices[d].n_bytes_written << std::endl;
+    std::cout << "n_files: " << n_files << std::endl;
+    std::cout << "n_files_failed: " << n_files_failed << std::endl;
+    std::cout << "n_bytes_written: " << n_bytes_written << std::endl;
+    if(n_files > 0){
+        const double t_total_us = std::chrono::duration_cast<std::chrono::microseconds>(t_total).count();
+        std::cout << "Latency per file min/avg/max in ms: "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(t_min).count()/1000.0 << " / "
+                  << t_total_us/n_files/1000.0 << " / "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(t_max).count()/1000.0 << std::endl;
+        std::cout << "Throughput avg/min in MB/s: " << n_bytes_written/(t_total_us + 1.0) << " / " << throughput_min << std::endl;
+    }
+    if(n_writes_piecewise > 0){
+        std::cout << "n_files_piecewise: " << n_files_piecewise << std::endl;
+        std::cout << "n_writes_piecewise: " << n_writes_piecewise << std::endl;
+        std::cout << "n_writes_piecewise_failed: " << n_writes_piecewise_failed << std::endl;
+        std::cout << "Latency per piecewise write avg/max in ms: "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(t_piecewise_total).count()/1000.0/n_writes_piecewise << " / "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(t_piecewise_max).count()/1000.0 << std::endl;
+    }
+    std::cout << "--------------------------" << std::endl;
+}
+
+static int write_single_file(const std::string &full_file_path, const std::vector<file_piece_t> &pieces){
+    if(backend == WRITER_OFSTREAM)
+        return write_file_ofstream(full_file_path, pieces);
+
+    bool direct = true;
+    const int ret = write_file_direct(full_file_path, pieces, direct);
+    if(direct == false){
+        boost::mutex::scoped_lock lk(m_mutex);
+        n_direct_fallback++;
+    }
+    return ret;
+}
+
+static void device_worker(const size_t d){
+    device_unit &dev = devices[d];
+    while(1){
+        device_job job;
+        {
+            boost::mutex::scoped_lock lk(dev.m_mutex);
+            while(dev.jobs.empty())
+                dev.m_condition.wait(lk);
+            job = dev.jobs.front();
+            dev.jobs.pop_front();
+        }
+
+        unsigned long long n_bytes = 0;
+        for(size_t i = 0; i < job.pieces.size(); i++)
+            n_bytes += job.pieces[i].second;
+
+        const int ret = write_single_file(job.full_file_path, job.pieces);
+        {
+            boost::mutex::scoped_lock lk(m_mutex);
+            dev.n_files++;
+            dev.n_bytes_written += n_bytes;
+        }
+
+        boost::mutex::scoped_lock lk(job.done->m_mutex);
+        if(ret == 0)
+            job.done->ret = 0;
+        job.done->n_pending--;
+        job.done->m_condition.notify_one();
+    }
+}
+
+static int pwrite_all(const int fd, const char* data, size_t n_bytes, unsigned long long offset){
+    while(n_bytes > 0){
+        const ssize_t r = pwrite(fd, data, n_bytes, offset);
+        if(r < 0 && errno == EINTR)
+            continue;
+        if(r <= 0)
+            return 0;
+        data += r;
+        n_bytes -= r;
+        offset += r;
+    }
+    return 1;
+}
+
+// appends the byte range [begin, end) of the concatenated pieces to out
+static void slice_pieces(const std::vector<file_piece_t> &pieces, unsigned long long begin, unsigned long long end, std::vector<file_piece_t> &out){
+    unsigned long long piece_begin = 0;
+    for(size_t i = 0; i < pieces.size() && begin < end; i++){
+        const unsigned long long piece_end = piece_begin + pieces[i].second;
+        if(begin < piece_end){
+            const unsigned long long n = std::min(end, piece_end) - begin;
+            out.push_back(file_piece_t(pieces[i].first + (begin - piece_begin), n));
+            begin += n;
+        }
+        piece_begin = piece_end;
+    }
+}
+
+// text file next to the first part, one line per stripe: index, offset in file, length, part file, offset in part file
+static int write_stripe_index(const std::string &file_name, const unsigned long long n_bytes){
+    const std::string full_file_path = devices[0].save_path + file_name + ".idx";
+    std::ofstream fout(full_file_path);
+    fout << "n_bytes " << n_bytes << std::endl;
+    fout << "stripe_bytes " << stripe_bytes << std::endl;
+    fout << "n_parts " << n_devices << std::endl;
+    unsigned long long k = 0;
+    for(unsigned long long offset = 0; offset < n_bytes; offset += stripe_bytes, k++){
+        const size_t d = k % n_devices;
+        fout << k << " " << offset << " " << std::min<unsigned long long>(stripe_bytes, n_bytes - offset) << " "
+             << devices[d].save_path << file_name << ".part" << d << " " << (k/n_devices)*stripe_bytes << std::endl;
+    }
+    fout.close();
+    if(!fout){
+        std::cerr << "file_writer: could not write " << full_file_path << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+static int write_file_ofstream(const std::string &full_file_path, const std::vector<file_piece_t> &pieces){
+    std::ofstream fout(full_file_path, std::ios::out | std::ios::binary);
+    for(size_t i = 0; i < pieces.size(); i++)
+        fout.write(pieces[i].first, pieces[i].second);
+    fout.close();
+    if(!fout){
+        std::cerr << "file_writer: could not write " << full_file_path << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *p){
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags){
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args){
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// checks on a temporary ring that the kernel supports io_uring and IORING_OP_WRITE (linux 5.6 and newer)
+static int probe_io_uring(){
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    const int fd = io_uring_setup(1, &p);
+    if(fd < 0){
+        std::cerr << "file_writer: io_uring is not available: " << strerror(errno) << std::endl;
+        return 0;
+    }
+
+    const size_t n_ops = IORING_OP_WRITE + 1;
+    std::vector<char> buf(sizeof(struct io_uring_probe) + n_ops*sizeof(struct io_uring_probe_op), 0);
+    struct io_uring_probe *probe = (struct io_uring_probe*) buf.data();
+    const int r = io_uring_register(fd, IORING_REGISTER_PROBE, probe, n_ops);
+    close(fd);
+    if(r < 0 || probe->last_op < IORING_OP_WRITE || !(probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED)){
+        std::cerr << "file_writer: the kernel does not support IORING_OP_WRITE, use --writer ofstream" << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+static writer_context* get_context(){
+    if(ctx != nullptr)
+        return ctx;
+
+    ctx = new writer_context();
+    ctx->ring_fd = -1;
+
+    // staging buffers come from the arena, they are aligned, numa local and pre-faulted
+    for(size_t i = 0; i < queue_depth; i++)
+        ctx->staging.push_back(static_cast<char*>(allocate_buffer(chunk_bytes)));
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = io_uring_setup(queue_depth, &p);
+    if(fd < 0){
+        boost::mutex::scoped_lock lk(m_mutex);
+        n_uring_fallback++;
+        return ctx;
+    }
+
+    size_t sq_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+        sq_size = cq_size = std::max(sq_size, cq_size);
+
+    char* sq_ptr = (char*) mmap(0, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    char* cq_ptr = sq_ptr;
+    if(!(p.features & IORING_FEAT_SINGLE_MMAP) && sq_ptr != MAP_FAILED)
+        cq_ptr = (char*) mmap(0, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    void* sqes = mmap(0, p.sq_entries*sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED){
+        close(fd);
+        boost::mutex::scoped_lock lk(m_mutex);
+        n_uring_fallback++;
+        return ctx;
+    }
+
+    ctx->ring_fd = fd;
+    ctx->sq_head = (unsigned*) (sq_ptr + p.sq_off.head);
+    ctx->sq_tail = (unsigned*) (sq_ptr + p.sq_off.tail);
+    ctx->sq_mask = (unsigned*) (sq_ptr + p.sq_off.ring_mask);
+    ctx->sq_array = (unsigned*) (sq_ptr + p.sq_off.array);
+    ctx->cq_head = (unsigned*) (cq_ptr + p.cq_off.head);
+    ctx->cq_tail = (unsigned*) (cq_ptr + p.cq_off.tail);
+    ctx->cq_mask = (unsigned*) (cq_ptr + p.cq_off.ring_mask);
+    ctx->cqes = (struct io_uring_cqe*) (cq_ptr + p.cq_off.cqes);
+    ctx->sqes = (struct io_uring_sqe*) sqes;
+
+    return ctx;
+}
+
+// copies the next chunk_bytes of the concatenated pieces into dst, returns number of bytes copied
+static size_t fill_chunk(char* dst, const std::vector<file_piece_t> &pieces, size_t &piece, size_t &piece_offset){
+    size_t n = 0;
+    while(n < chunk_bytes && piece < pieces.size()){
+        const size_t n_copy = std::min(chunk_bytes - n, pieces[piece].second - piece_offset);
+        memcpy(dst + n, pieces[piece].first + piece_offset, n_copy);
+        n += n_copy;
+        piece_offset += n_copy;
+        if(piece_offset == pieces[piece].second){
+            piece++;
+            piece_offset = 0;
+        }
+    }
+    return n;
+}
+
+static int write_file_direct(const std::string &full_file_path, const std::vector<file_piece_t> &pieces, bool &direct){
+    writer_context *c = get_context();
+
+    unsigned long long n_bytes = 0;
+    for(size_t i = 0; i < pieces.size(); i++)
+        n_bytes += pieces[i].second;
+
+    // some file systems (tmpfs) reject O_DIRECT, we still write through the staging buffers then
+    int fd = open(full_file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if(fd < 0 && errno == EINVAL){
+        direct = false;
+        fd = open(full_file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if(fd < 0){
+        std::cerr << "file_writer: could not open " << full_file_path << ": " << strerror(errno) << std::endl;
+        return 0;
+    }
+
+    // reserve extents up front, the last chunk is padded to the alignment and truncated afterwards
+    const unsigned long long n_bytes_padded = (n_bytes + WRITER_ALIGNMENT - 1)/WRITER_ALIGNMENT*WRITER_ALIGNMENT;
+    if(n_bytes_padded > 0 && fallocate(fd, 0, 0, n_bytes_padded) != 0 && errno != EOPNOTSUPP){
+        std::cerr << "file_writer: could not reserve " << n_bytes_padded << " bytes for " << full_file_path << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return 0;
+    }
+
+    size_t piece = 0;
+    size_t piece_offset = 0;
+    unsigned long long offset = 0;
+    int ret = 1;
+
+    // synchronous fallback, one chunk at a time
+    if(c->ring_fd < 0){
+        while(ret == 1 && offset < n_bytes){
+            const size_t n = fill_chunk(c->staging[0], pieces, piece, piece_offset);
+            const size_t n_padded = (n + WRITER_ALIGNMENT - 1)/WRITER_ALIGNMENT*WRITER_ALIGNMENT;
+            memset(c->staging[0] + n, 0, n_padded - n);
+            size_t done = 0;
+            while(done < n_padded){
+                const ssize_t r = pwrite(fd, c->staging[0] + done, n_padded - done, offset + done);
+                if(r <= 0){
+                    ret = 0;
+                    break;
+                }
+                done += r;
+            }
+            offset += n;
+        }
+    }
+    // io_uring, keep up to queue_depth chunks in flight, user_data is the staging buffer index
+    else{
+        std::vector<size_t> free_buffers;
+        for(size_t i = 0; i < queue_depth; i++)
+            free_buffers.push_back(i);
+        std::vector<unsigned long long> buffer_offset(queue_depth);
+        std::vector<unsigned> buffer_len(queue_depth);
+        std::vector<unsigned> buffer_done(queue_depth);
+        size_t n_in_flight = 0;
+        unsigned n_unsubmitted = 0;                 // prepared entries not yet consumed by the kernel
+
+        while(ret == 1 && (offset < n_bytes || n_in_flight > 0)){
+            // fill submission queue
+            unsigned tail = *c->sq_tail;
+            while(offset < n_bytes && free_buffers.empty() == false){
+                const size_t b = free_buffers.back();
+                free_buffers.pop_back();
+                const size_t n = fill_chunk(c->staging[b], pieces, piece, piece_offset);
+                const size_t n_padded = (n + WRITER_ALIGNMENT - 1)/WRITER_ALIGNMENT*WRITER_ALIGNMENT;
+                memset(c->staging[b] + n, 0, n_padded - n);
+                buffer_offset[b] = offset;
+                buffer_len[b] = n_padded;
+                buffer_done[b] = 0;
+                offset += n;
+
+                const unsigned idx = tail & *c->sq_mask;
+                struct io_uring_sqe *sqe = &c->sqes[idx];
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->fd = fd;
+                sqe->addr = (unsigned long long) c->staging[b];
+                sqe->len = n_padded;
+                sqe->off = buffer_offset[b];
+                sqe->user_data = b;
+                c->sq_array[idx] = idx;
+                tail++;
+                n_unsubmitted++;
+                n_in_flight++;
+            }
+            __atomic_store_n(c->sq_tail, tail, __ATOMIC_RELEASE);
+
+            // submit and wait for at least one completion
+            const int r = io_uring_enter(c->ring_fd, n_unsubmitted, 1, IORING_ENTER_GETEVENTS);
+            if(r < 0 && errno != EINTR){
+                ret = 0;
+                break;
+            }
+            if(r > 0)
+                n_unsubmitted -= r;
+
+            // reap completions, short writes are resubmitted with the remainder
+            unsigned head = *c->cq_head;
+            while(head != __atomic_load_n(c->cq_tail, __ATOMIC_ACQUIRE)){
+                const struct io_uring_cqe *cqe = &c->cqes[head & *c->cq_mask];
+                const size_t b = cqe->user_data;
+                const int res = cqe->res;
+                head++;
+                n_in_flight--;
+
+                if(res <= 0){
+                    ret = 0;
+                    continue;
+                }
+                buffer_done[b] += res;
+                if(buffer_done[b] == buffer_len[b]){
+                    free_buffers.push_back(b);
+                    continue;
+                }
+
+                const unsigned t = *c->sq_tail;
+                const unsigned idx = t & *c->sq_mask;
+                struct io_uring_sqe *sqe = &c->sqes[idx];
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->fd = fd;
+                sqe->addr = (unsigned long long) (c->staging[b] + buffer_done[b]);
+                sqe->len = buffer_len[b] - buffer_done[b];
+                sqe->off = buffer_offset[b] + buffer_done[b];
+                sqe->user_data = b;
+                c->sq_array[idx] = idx;
+                __atomic_store_n(c->sq_tail, t + 1, __ATOMIC_RELEASE);
+                n_unsubmitted++;
+                n_in_flight++;
+            }
+            __atomic_store_n(c->cq_head, head, __ATOMIC_RELEASE);
+        }
+
+        // on error, drain what is still in flight before the staging buffers are reused
+        while(n_in_flight > 0){
+            const int r = io_uring_enter(c->ring_fd, n_unsubmitted, 1, IORING_ENTER_GETEVENTS);
+            if(r < 0 && errno != EINTR)
+                break;
+            if(r > 0)
+                n_unsubmitted -= r;
+            unsigned head = *c->cq_head;
+            while(head != __atomic_load_n(c->cq_tail, __ATOMIC_ACQUIRE)){
+                head++;
+                n_in_flight--;
+            }
+            __atomic_store_n(c->cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    // remove padding of the last chunk
+    if(ret == 1 && ftruncate(fd, n_bytes) != 0)
+        ret = 0;
+    if(close(fd) != 0)
+        ret = 0;
+
+    if(ret == 0)
+        std::cerr << "file_writer: could not write " << full_file_path << std::endl;
+
+    return ret;
+}
+}
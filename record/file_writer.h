@@ -0,0 +1,113 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_FILE_WRITER_H
+#define CHANNELSOUNDER_FILE_WRITER_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstddef>
+
+namespace channelsounder
+{
+enum writer_backend_enum{
+    WRITER_OFSTREAM,            // blocking std::ofstream through the page cache
+    WRITER_IO_URING             // io_uring with O_DIRECT, init_file_writer fails if the kernel does not support IORING_OP_WRITE
+};
+
+// one contiguous piece of a file, e.g. the samples of one channel
+typedef std::pair<const char*, size_t> file_piece_t;
+
+/*!
+ * Inits unit internally. Must be called before the first file is written.
+ *
+ * backend_arg                  see writer_backend_enum
+ * queue_depth_arg              number of writes in flight per file (io_uring only)
+ * chunk_bytes_arg              size of a single write, rounded up to a multiple of 4096 (io_uring only)
+ * save_paths                   output directories, ideally one per drive, each directory gets its own writer thread if there is more than one
+ * stripe_bytes_arg             0 to distribute whole files round robin across save_paths,
+ *                              otherwise stripe k of each file goes to save_paths[k % save_paths.size()] and an index <file>.idx is written into save_paths[0]
+ * return                       1 on success and 0 on failure
+*/
+int init_file_writer(const writer_backend_enum backend_arg, const size_t queue_depth_arg, const size_t chunk_bytes_arg,
+                     const std::vector<std::string> &save_paths, const size_t stripe_bytes_arg);
+
+/*!
+ * Converts a command line string to a backend.
+ *
+ * str                          "ofstream" or "io_uring"
+ * backend                      set on success
+ * return                       1 on success and 0 on failure
+*/
+int parse_writer_backend(const std::string &str, writer_backend_enum &backend);
+
+/*!
+ * Creates a file, writes all pieces back to back and closes it. Blocks until the data was handed to the device(s).
+ * May be called from several threads at once, each thread uses its own io_uring instance and staging buffers.
+ *
+ * file_name                    name of the file without directory, an existing file is truncated
+ * pieces                       data to be written in order
+ * return                       1 on success and 0 on failure
+*/
+int write_file(const std::string &file_name, const std::vector<file_piece_t> &pieces);
+
+// file written in several steps, see open_file()
+struct file_handle_t{
+    std::string file_name;
+    std::vector<int> fds;                   // one per part, a single one without striping
+    unsigned long long n_bytes;             // final size of the file
+};
+
+/*!
+ * Creates a file of its final size, which is then written piecewise at arbitrary offsets, e.g. while its content is still being captured.
+ * Unwritten ranges read as zeros. Writes go through the page cache with pwrite for all backends, O_DIRECT would need aligned offsets.
+ * Without reserve the file is sparse, ranges never written take no space on disk.
+ * The file is placed and striped like a file of write_file().
+ *
+ * file_name                    name of the file without directory, an existing file is truncated
+ * n_bytes                      final size of the file
+ * reserve                      allocate all blocks up front, reduces fragmentation if the whole file is written
+ * handle                       set on success, passed to write_file_at() and close_file()
+ * return                       1 on success and 0 on failure
+*/
+int open_file(const std::string &file_name, const unsigned long long n_bytes, const bool reserve, file_handle_t &handle);
+
+/*!
+ * Writes into a file created by open_file(). Blocks until the data is in the page cache and visible to readers.
+ *
+ * offset                       position in the file, offset + n_bytes must not exceed the size given to open_file()
+ * data                         data to be written
+ * n_bytes                      number of bytes
+ * return                       1 on success and 0 on failure
+*/
+int write_file_at(const file_handle_t &handle, const unsigned long long offset, const char* data, const size_t n_bytes);
+
+/*!
+ * Closes a file created by open_file().
+ *
+ * return                       1 on success and 0 on failure
+*/
+int close_file(file_handle_t &handle);
+
+/*!
+ * Shows some stats of the writer, e.g. write throughput and latency per file.
+*/
+void show_debug_information_file_writer();
+}
+ 
+#endif
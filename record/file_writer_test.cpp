@@ -0,0 +1,141 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "file_writer.h"
+#include "buffer_allocator.h"
+#include "ch_measurement_reader.h"
+
+/***********************************************************************
+ * A file striped across several directories, written at once and
+ * piecewise, must read back identical through ch_measurement_reader.
+ **********************************************************************/
+#define N_DEVICES               3
+#define STRIPE_BYTES            5000            // not a multiple of the page size, the last stripe is short
+#define N_CHANNELS              2
+#define MEASUREMENT_LENGTH      1000
+#define N_MEASUREMENTS          5
+#define CHUNK_BYTES             3000            // piecewise writes cross stripe boundaries
+
+// raw sc16 file with a valid header and a sample pattern differing per position and channel
+static void make_file(std::vector<char> &file){
+    const size_t n_bytes_channel = N_MEASUREMENTS*MEASUREMENT_LENGTH*4;
+    const size_t channel_stride = (n_bytes_channel + CH_MEASUREMENT_FILE_ALIGNMENT - 1)/CH_MEASUREMENT_FILE_ALIGNMENT*CH_MEASUREMENT_FILE_ALIGNMENT;
+    file.assign(CH_MEASUREMENT_FILE_ALIGNMENT + N_CHANNELS*channel_stride, 0);
+
+    channelsounder::ch_measurement_file_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CH_MEASUREMENT_FILE_MAGIC, sizeof(CH_MEASUREMENT_FILE_MAGIC));
+    h.version = CH_MEASUREMENT_FILE_VERSION;
+    h.header_bytes = CH_MEASUREMENT_FILE_ALIGNMENT;
+    h.index_offset = sizeof(h);
+    h.file_bytes = file.size();
+    h.n_channels = N_CHANNELS;
+    h.n_bytes_per_item = 4;
+    memcpy(h.data_type, "sc16", 4);
+    h.measurement_length = MEASUREMENT_LENGTH;
+    h.n_measurements = N_MEASUREMENTS;
+    h.channel_stride = channel_stride;
+    h.n_average = 1;
+    memcpy(&file[0], &h, sizeof(h));
+
+    for(size_t k = 0; k < N_MEASUREMENTS; k++){
+        channelsounder::ch_measurement_index_entry e;
+        e.tick = k*MEASUREMENT_LENGTH;
+        e.offset = h.header_bytes + k*MEASUREMENT_LENGTH*4;
+        e.n_bytes = MEASUREMENT_LENGTH*4;
+        e.flags = CH_MEASUREMENT_COMPLETE;
+        memcpy(&file[h.index_offset + k*sizeof(e)], &e, sizeof(e));
+    }
+
+    for(size_t ch = 0; ch < N_CHANNELS; ch++){
+        int16_t* iq = reinterpret_cast<int16_t*>(&file[h.header_bytes + ch*channel_stride]);
+        for(size_t i = 0; i < 2*N_MEASUREMENTS*MEASUREMENT_LENGTH; i++)
+            iq[i] = (int16_t) (i*31 + ch*7919);
+    }
+}
+
+static int check_file(const std::string &full_file_path, const std::vector<char> &file){
+    channelsounder::ch_measurement_reader r;
+    if(r.open(full_file_path) == 0)
+        return 0;
+    if(memcmp(&r.header(), &file[0], file.size()) != 0){
+        std::cerr << full_file_path << " differs from the data written" << std::endl;
+        return 0;
+    }
+
+    std::vector<int16_t> iq(2*MEASUREMENT_LENGTH);
+    for(size_t k = 0; k < N_MEASUREMENTS; k++){
+        for(size_t ch = 0; ch < N_CHANNELS; ch++){
+            const size_t offset = CH_MEASUREMENT_FILE_ALIGNMENT + ch*r.header().channel_stride + k*MEASUREMENT_LENGTH*4;
+            if(r.decode_measurement(k, ch, &iq[0]) == 0 || memcmp(&iq[0], &file[offset], MEASUREMENT_LENGTH*4) != 0){
+                std::cerr << full_file_path << ": measurement " << k << " of channel " << ch << " differs" << std::endl;
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int main()
+{
+    std::vector<std::string> save_paths;
+    for(size_t d = 0; d < N_DEVICES; d++){
+        save_paths.push_back("file_writer_test_" + std::to_string(d) + "/");
+        mkdir(save_paths.back().c_str(), 0755);
+    }
+    channelsounder::init_buffer_allocator(channelsounder::PAGES_4KB, -1, false);
+    if (not channelsounder::init_file_writer(channelsounder::WRITER_OFSTREAM, 1, 1024*1024, save_paths, STRIPE_BYTES)) {
+        return 1;
+    }
+
+    std::vector<char> file;
+    make_file(file);
+
+    // whole file in pieces of uneven size
+    std::vector<channelsounder::file_piece_t> pieces;
+    pieces.push_back(channelsounder::file_piece_t(&file[0], 100));
+    pieces.push_back(channelsounder::file_piece_t(&file[100], 7000));
+    pieces.push_back(channelsounder::file_piece_t(&file[7100], file.size() - 7100));
+    if (not channelsounder::write_file("striped.bin", pieces)) {
+        return 1;
+    }
+
+    // piecewise and back to front, like windows saved before the header is complete
+    channelsounder::file_handle_t handle;
+    if (not channelsounder::open_file("chunked.bin", file.size(), true, handle)) {
+        return 1;
+    }
+    for (size_t offset = (file.size() - 1)/CHUNK_BYTES*CHUNK_BYTES; ; offset -= CHUNK_BYTES) {
+        if (not channelsounder::write_file_at(handle, offset, &file[offset], std::min<size_t>(CHUNK_BYTES, file.size() - offset))) {
+            return 1;
+        }
+        if (offset == 0)
+            break;
+    }
+    channelsounder::close_file(handle);
+
+    if (not check_file(save_paths[0] + "striped.bin", file) or not check_file(save_paths[0] + "chunked.bin.idx", file)) {
+        std::cerr << "FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "striped files read back identical" << std::endl;
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <deque>
+#include <boost/thread/thread.hpp>
+
+#include "job_pool.h"
+
+namespace channelsounder
+{
+// all jobs of one call to run_jobs(), the caller waits until n_pending is zero
+struct job_batch{
+    boost::mutex m_mutex;
+    boost::condition_variable m_condition;
+    size_t n_pending;
+};
+
+struct pool_job{
+    const std::function<void()>* run;
+    job_batch* batch;
+};
+
+struct job_pool{
+    std::deque<pool_job> jobs;
+    boost::mutex m_mutex;
+    boost::condition_variable m_condition;
+};
+
+static void job_worker(job_pool* pool);
+
+job_pool* create_job_pool(const size_t n_threads){
+    if(n_threads == 0)
+        return nullptr;
+
+    job_pool* pool = new job_pool();
+    for(size_t i = 0; i < n_threads; i++)
+        boost::thread(job_worker, pool).detach();
+    return pool;
+}
+
+void run_jobs(job_pool* pool, const std::vector<std::function<void()>> &jobs){
+    if(pool == nullptr){
+        for(size_t i = 0; i < jobs.size(); i++)
+            jobs[i]();
+        return;
+    }
+
+    job_batch batch;
+    batch.n_pending = jobs.size();
+    {
+        boost::mutex::scoped_lock lk(pool->m_mutex);
+        for(size_t i = 0; i < jobs.size(); i++){
+            pool_job job = {&jobs[i], &batch};
+            pool->jobs.push_back(job);
+        }
+    }
+    pool->m_condition.notify_all();
+
+    boost::mutex::scoped_lock lk(batch.m_mutex);
+    while(batch.n_pending > 0)
+        batch.m_condition.wait(lk);
+}
+
+static void job_worker(job_pool* pool){
+    while(1){
+        pool_job job;
+        {
+            boost::mutex::scoped_lock lk(pool->m_mutex);
+            while(pool->jobs.empty())
+                pool->m_condition.wait(lk);
+            job = pool->jobs.front();
+            pool->jobs.pop_front();
+        }
+        (*job.run)();
+
+        boost::mutex::scoped_lock lk(job.batch->m_mutex);
+        job.batch->n_pending--;
+        if(job.batch->n_pending == 0)
+            job.batch->m_condition.notify_one();
+    }
+}
+}
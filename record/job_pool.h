@@ -0,0 +1,46 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CHANNELSOUNDER_JOB_POOL_H
+#define CHANNELSOUNDER_JOB_POOL_H
+
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+namespace channelsounder
+{
+struct job_pool;
+
+/*!
+ * Starts a pool of worker threads, e.g. one per processing stage shared by all pipelines.
+ * The pool is never freed, the workers wait for jobs until the process ends.
+ *
+ * n_threads                    number of worker threads
+ * return                       the pool, nullptr if n_threads is 0
+*/
+job_pool* create_job_pool(const size_t n_threads);
+
+/*!
+ * Runs all jobs on the pool and blocks until all are done. Jobs of several callers are run in the order they were queued.
+ *
+ * pool                         see create_job_pool(), nullptr to run the jobs one after the other in the calling thread
+ * jobs                         jobs to run, must not be changed until run_jobs() returns
+*/
+void run_jobs(job_pool* pool, const std::vector<std::function<void()>> &jobs);
+}
+
+#endif
@@ -0,0 +1,153 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <boost/thread/thread.hpp>
+
+#include "latency_histogram.h"
+#include "metrics.h"
+
+#define LATENCY_CALIBRATION_MS      20
+
+namespace channelsounder
+{
+latency_histogram latency_histograms[LATENCY_N_HISTOGRAMS][MAX_PIPELINES];
+
+// name in the endpoint and in the debug output, in the order of latency_histogram_enum
+static const char* const histogram_names[LATENCY_N_HISTOGRAMS][2] = {
+    {"rx_recv",         "duration of rx_stream->recv()"},
+    {"ring_wakeup",     "delay from publishing an rx ring slot to the process thread picking it up"},
+    {"fifo_feed",       "duration of feeding one rx ring slot into the fifo"},
+    {"fifo_save",       "duration of saving one fifo buffer including compression and cir extraction"},
+    {"file_write",      "duration of writing one fifo buffer to its file"}
+};
+
+static const double quantiles[] = {0.5, 0.99, 0.999};
+
+static double ns_per_tick = 1.0;
+
+static unsigned long long bucket_upper(const size_t bucket);
+static void format_latency_metrics(std::ostream &out);
+
+void init_latency_histogram(){
+    for(size_t h = 0; h < LATENCY_N_HISTOGRAMS; h++){
+        for(size_t id = 0; id < MAX_PIPELINES; id++){
+            latency_histogram &hist = latency_histograms[h][id];
+            hist.n = 0;
+            hist.sum = 0;
+            hist.max = 0;
+            for(size_t b = 0; b < LATENCY_N_BUCKETS; b++)
+                hist.counts[b] = 0;
+        }
+    }
+    
+    // ticks of the time stamp counter per ns, constant on all cpus of the last decade
+    const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    const unsigned long long c0 = latency_clock();
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(LATENCY_CALIBRATION_MS));
+    const unsigned long long c1 = latency_clock();
+    const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    ns_per_tick = std::chrono::duration<double, std::nano>(t1 - t0).count()/(c1 - c0);
+    
+    add_metrics_text(format_latency_metrics);
+}
+
+double get_latency_clock_ns_per_tick(){
+    return ns_per_tick;
+}
+
+double get_latency_quantile(const latency_histogram_enum histogram, const double quantile, const size_t id){
+    const latency_histogram &h = latency_histograms[histogram][id];
+    
+    // the counts are read once, durations recorded meanwhile are left out consistently
+    static thread_local unsigned long long counts[LATENCY_N_BUCKETS];
+    unsigned long long n = 0;
+    for(size_t b = 0; b < LATENCY_N_BUCKETS; b++){
+        counts[b] = h.counts[b].load(std::memory_order_relaxed);
+        n += counts[b];
+    }
+    if(n == 0)
+        return 0.0;
+    
+    // highest duration of the bucket holding the rank, but never more than the maximum seen
+    const unsigned long long rank = std::max<unsigned long long>(1, (unsigned long long) (quantile*n + 0.5));
+    unsigned long long seen = 0;
+    size_t b = 0;
+    for(; b < LATENCY_N_BUCKETS - 1; b++){
+        seen += counts[b];
+        if(seen >= rank)
+            break;
+    }
+    return std::min(bucket_upper(b), h.max.load(std::memory_order_relaxed))*ns_per_tick;
+}
+
+void show_debug_information_latency_histogram(){
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Latency histograms in us:" << std::endl;
+    std::cout << "ns_per_tick: " << ns_per_tick << std::endl;
+    std::cout << std::left << std::setw(14) << "histogram" << std::right << std::setw(9) << "pipeline" << std::setw(14) << "n"
+              << std::setw(12) << "mean" << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12) << "p99.9" << std::setw(12) << "max" << std::endl;
+    for(size_t h = 0; h < LATENCY_N_HISTOGRAMS; h++){
+        for(size_t id = 0; id < MAX_PIPELINES; id++){
+            const latency_histogram &hist = latency_histograms[h][id];
+            const unsigned long long n = hist.n.load();
+            if(n == 0)
+                continue;
+            const latency_histogram_enum e = static_cast<latency_histogram_enum>(h);
+            std::cout << std::left << std::setw(14) << histogram_names[h][0] << std::right << std::setw(9) << id << std::setw(14) << n
+                      << std::fixed << std::setprecision(2)
+                      << std::setw(12) << hist.sum.load()*ns_per_tick/n/1e3
+                      << std::setw(12) << get_latency_quantile(e, 0.5, id)/1e3
+                      << std::setw(12) << get_latency_quantile(e, 0.99, id)/1e3
+                      << std::setw(12) << get_latency_quantile(e, 0.999, id)/1e3
+                      << std::setw(12) << hist.max.load()*ns_per_tick/1e3 << std::endl;
+            std::cout.unsetf(std::ios_base::floatfield);
+        }
+    }
+    std::cout << "--------------------------" << std::endl;
+}
+
+// largest duration falling into a bucket, see latency_bucket()
+static unsigned long long bucket_upper(const size_t bucket){
+    const size_t half = (size_t) 1 << (LATENCY_SUB_BITS - 1);
+    const unsigned int e = (bucket < 2*half) ? 0 : (bucket >> (LATENCY_SUB_BITS - 1)) - 1;
+    const unsigned long long mantissa = bucket - ((size_t) e << (LATENCY_SUB_BITS - 1));
+    return ((mantissa + 1) << e) - 1;
+}
+
+// one summary per histogram with a series per pipeline, in seconds
+static void format_latency_metrics(std::ostream &out){
+    for(size_t h = 0; h < LATENCY_N_HISTOGRAMS; h++){
+        out << "# HELP channelsounder_latency_" << histogram_names[h][0] << "_seconds " << histogram_names[h][1] << "\n";
+        out << "# TYPE channelsounder_latency_" << histogram_names[h][0] << "_seconds summary\n";
+        for(size_t id = 0; id < MAX_PIPELINES; id++){
+            const latency_histogram &hist = latency_histograms[h][id];
+            const unsigned long long n = hist.n.load(std::memory_order_relaxed);
+            if(n == 0)
+                continue;
+            const latency_histogram_enum e = static_cast<latency_histogram_enum>(h);
+            for(size_t q = 0; q < sizeof(quantiles)/sizeof(quantiles[0]); q++)
+                out << "channelsounder_latency_" << histogram_names[h][0] << "_seconds{pipeline=\"" << id << "\",quantile=\"" << quantiles[q] << "\"} " << get_latency_quantile(e, quantiles[q], id)*1e-9 << "\n";
+            out << "channelsounder_latency_" << histogram_names[h][0] << "_seconds{pipeline=\"" << id << "\",quantile=\"1\"} " << hist.max.load(std::memory_order_relaxed)*ns_per_tick*1e-9 << "\n";
+            out << "channelsounder_latency_" << histogram_names[h][0] << "_seconds_sum{pipeline=\"" << id << "\"} " << hist.sum.load(std::memory_order_relaxed)*ns_per_tick*1e-9 << "\n";
+            out << "channelsounder_latency_" << histogram_names[h][0] << "_seconds_count{pipeline=\"" << id << "\"} " << n << "\n";
+        }
+    }
+}
+}
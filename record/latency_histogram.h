@@ -0,0 +1,121 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_LATENCY_HISTOGRAM_H
+#define CHANNELSOUNDER_LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "config.h"
+
+// log-linear buckets as in HdrHistogram, 2^(LATENCY_SUB_BITS-1) buckets per power of two, i.e. a resolution of 1.6%
+#define LATENCY_SUB_BITS        7
+#define LATENCY_MAX_BITS        40          // larger durations in clock ticks are counted in the last bucket, about 5 minutes at 4 GHz
+#define LATENCY_N_BUCKETS       ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 2) << (LATENCY_SUB_BITS - 1))
+
+namespace channelsounder
+{
+// measured durations, each histogram of a pipeline is written by a single thread only
+enum latency_histogram_enum{
+    LATENCY_RX_RECV = 0,                // duration of rx_stream->recv(), rx thread
+    LATENCY_RING_WAKEUP,                // from publishing a slot of the rx ring to the process thread picking it up, process thread
+    LATENCY_FIFO_FEED,                  // feed_new_ch_measurement() for one slot of the rx ring, process thread
+    LATENCY_FIFO_SAVE,                  // saving one fifo buffer including compression and cir extraction, save thread
+    LATENCY_FILE_WRITE,                 // writing one fifo buffer to its file without compression and cir extraction, save thread
+    LATENCY_N_HISTOGRAMS
+};
+
+struct alignas(64) latency_histogram{
+    std::atomic<unsigned long long> n;
+    std::atomic<unsigned long long> sum;
+    std::atomic<unsigned long long> max;
+    std::atomic<unsigned long long> counts[LATENCY_N_BUCKETS];
+};
+extern latency_histogram latency_histograms[LATENCY_N_HISTOGRAMS][MAX_PIPELINES];
+
+/*!
+ * Inits unit internally and calibrates the clock. Must be called before any pipeline thread is started.
+ * Takes about 20 ms.
+*/
+void init_latency_histogram();
+
+/*!
+ * return                       clock ticks, the time stamp counter on x86 and nanoseconds otherwise
+*/
+inline unsigned long long latency_clock(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/*!
+ * return                       nanoseconds per tick of latency_clock(), as calibrated by init_latency_histogram()
+*/
+double get_latency_clock_ns_per_tick();
+
+/*!
+ * Bucket of a duration, values below 2^LATENCY_SUB_BITS have a bucket each.
+*/
+inline size_t latency_bucket(unsigned long long ticks){
+    if(ticks >= (1ULL << LATENCY_MAX_BITS))
+        ticks = (1ULL << LATENCY_MAX_BITS) - 1;
+    const unsigned int msb = 63 - __builtin_clzll(ticks | 1);
+    const unsigned int e = (msb < LATENCY_SUB_BITS) ? 0 : msb - LATENCY_SUB_BITS + 1;
+    return ((size_t) e << (LATENCY_SUB_BITS - 1)) + (ticks >> e);
+}
+
+/*!
+ * Counts one duration, plain stores without lock, only the thread owning the histogram may call it.
+ *
+ * histogram                    LATENCY_RX_RECV etc.
+ * ticks                        duration as difference of two latency_clock() values
+ * id                           pipeline
+*/
+inline void record_latency(const latency_histogram_enum histogram, const unsigned long long ticks, const size_t id){
+    latency_histogram &h = latency_histograms[histogram][id];
+    std::atomic<unsigned long long> &c = h.counts[latency_bucket(ticks)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    h.sum.store(h.sum.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+    if(ticks > h.max.load(std::memory_order_relaxed))
+        h.max.store(ticks, std::memory_order_relaxed);
+    h.n.store(h.n.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/*!
+ * May be called by any thread while the histogram is written.
+ *
+ * histogram                    LATENCY_RX_RECV etc.
+ * quantile                     e.g. 0.99
+ * id                           pipeline
+ * return                       duration in ns not exceeded by this fraction of all durations, within the resolution of a bucket
+*/
+double get_latency_quantile(const latency_histogram_enum histogram, const double quantile, const size_t id);
+
+/*!
+ * Shows count, p50, p99, p99.9 and max of all histograms with at least one duration.
+*/
+void show_debug_information_latency_histogram();
+}
+ 
+#endif
@@ -0,0 +1,334 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <boost/thread/thread.hpp>
+
+#include "metrics.h"
+
+#define METRICS_MAX_THREADS             64
+#define METRICS_PREFIX                  "channelsounder_"
+#define METRICS_POLL_INTERVAL_MS        100         // how often serve_metrics() checks burst_timer_elapsed
+#define METRICS_REQUEST_TIMEOUT_MS      100         // a client sending its request slower than this is answered anyway
+#define METRICS_MAX_REQUEST_BYTES       4096
+
+namespace channelsounder
+{
+thread_local metrics_slot* metrics_thread_slot = nullptr;
+
+// name in the endpoint and description, in the order of metrics_counter_enum
+static const char* const counter_names[METRIC_N_COUNTERS][2] = {
+    {"rx_samples_total",                "received samples of all channels"},
+    {"rx_overruns_total",               "overruns reported by uhd"},
+    {"rx_dropped_samples_total",        "samples lost in overruns according to the time stamps"},
+    {"rx_sequence_errors_total",        "rx sequence errors reported by uhd"},
+    {"rx_late_commands_total",          "late stream commands reported by uhd"},
+    {"rx_timeouts_total",               "recv calls ending in a timeout"},
+    {"tx_samples_total",                "transmitted samples of all channels"},
+    {"tx_underruns_total",              "underruns reported by uhd"},
+    {"tx_sequence_errors_total",        "tx sequence errors reported by uhd"},
+    {"tx_timeouts_total",               "send calls ending in a timeout"},
+    {"tx_bursts_total",                 "timed bursts sent completely"},
+    {"tx_late_bursts_total",            "timed bursts reported late by uhd"},
+    {"ring_slots_overwritten_total",    "rx ring slots written again because the process thread was behind"},
+    {"windows_captured_total",          "measurement windows finished by the fifo"},
+    {"windows_incomplete_total",        "measurement windows missing samples"},
+    {"windows_dropped_total",           "measurement windows lost because all fifo buffers were waiting for the save thread"},
+    {"samples_lost_total",              "samples missing in the fifo according to the time stamps"},
+    {"files_written_total",             "measurement files completed"},
+    {"write_errors_total",              "failed writes of measurement files"},
+    {"bytes_written_total",             "bytes written to measurement files"}
+};
+
+// one slot per registered thread, slots are never given back
+static metrics_slot slots[METRICS_MAX_THREADS];
+static std::string slot_roles[METRICS_MAX_THREADS];
+static size_t slot_indices[METRICS_MAX_THREADS];
+static std::atomic<size_t> n_slots(0);
+static metrics_slot shared_slot;                    // threads without a slot, counted with atomic read-modify-write
+static boost::mutex m_mutex;                        // registration and gauges
+
+struct metrics_gauge{
+    std::string name;
+    std::string help;
+    metrics_gauge_function_t function;
+    size_t id;
+};
+static std::vector<metrics_gauge> gauges;
+static std::vector<metrics_text_function_t> texts;
+
+static unsigned int port;
+static double status_interval_sec;
+static int listen_fd = -1;
+static std::chrono::steady_clock::time_point tstart;
+static unsigned long long n_scrapes;
+static unsigned long long n_status_lines;
+
+static void serve_client();
+static std::string format_metrics();
+static void print_status(const double interval_sec);
+
+int init_metrics(const unsigned int port_arg, const double status_interval_sec_arg){
+    port = port_arg;
+    status_interval_sec = status_interval_sec_arg;
+    tstart = std::chrono::steady_clock::now();
+    n_scrapes = 0;
+    n_status_lines = 0;
+
+    if(status_interval_sec < 0.0){
+        std::cerr << "metrics: the status interval must not be negative." << std::endl;
+        return 0;
+    }
+    if(port == 0)
+        return 1;
+
+    // local only, the endpoint is scraped by an agent on the same host
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listen_fd < 0){
+        std::cerr << "metrics: could not create socket: " << strerror(errno) << std::endl;
+        return 0;
+    }
+    const int on = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 8) != 0){
+        std::cerr << "metrics: could not listen on 127.0.0.1:" << port << ": " << strerror(errno) << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return 0;
+    }
+    std::cout << "metrics: serving http://127.0.0.1:" << port << "/metrics" << std::endl;
+
+    return 1;
+}
+
+bool is_metrics_enabled(){
+    return listen_fd >= 0 || status_interval_sec > 0.0;
+}
+
+void register_metrics_thread(const std::string &role, const size_t index){
+    boost::mutex::scoped_lock lk(m_mutex);
+
+    // a thread started again continues the counters of its predecessor
+    const size_t n = n_slots.load(std::memory_order_relaxed);
+    for(size_t i = 0; i < n; i++){
+        if(slot_roles[i] == role && slot_indices[i] == index){
+            metrics_thread_slot = &slots[i];
+            return;
+        }
+    }
+    if(n == METRICS_MAX_THREADS){
+        std::cerr << "metrics: more than " << METRICS_MAX_THREADS << " threads, " << role << " " << index << " shares the counters of unregistered threads." << std::endl;
+        return;
+    }
+    slot_roles[n] = role;
+    slot_indices[n] = index;
+    n_slots.store(n + 1, std::memory_order_release);
+    metrics_thread_slot = &slots[n];
+}
+
+void add_metric_shared(const metrics_counter_enum counter, const unsigned long long n){
+    shared_slot.counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void add_metrics_gauge(const std::string &name, const std::string &help, const metrics_gauge_function_t function, const size_t id){
+    boost::mutex::scoped_lock lk(m_mutex);
+    // gauges of the same name stay next to each other, they share one header in the endpoint
+    metrics_gauge g = {name, help, function, id};
+    std::vector<metrics_gauge>::iterator it = gauges.end();
+    for(std::vector<metrics_gauge>::iterator i = gauges.begin(); i != gauges.end(); i++){
+        if(i->name == name)
+            it = i + 1;
+    }
+    gauges.insert(it, g);
+}
+
+void add_metrics_text(const metrics_text_function_t function){
+    boost::mutex::scoped_lock lk(m_mutex);
+    texts.push_back(function);
+}
+
+unsigned long long get_metric_total(const metrics_counter_enum counter){
+    unsigned long long total = shared_slot.counters[counter].load(std::memory_order_relaxed);
+    const size_t n = n_slots.load(std::memory_order_acquire);
+    for(size_t i = 0; i < n; i++)
+        total += slots[i].counters[counter].load(std::memory_order_relaxed);
+    return total;
+}
+
+void serve_metrics(std::atomic<bool>& burst_timer_elapsed){
+    std::chrono::steady_clock::time_point t_status = std::chrono::steady_clock::now();
+    const std::chrono::microseconds interval((long long) (status_interval_sec*1e6));
+
+    while(burst_timer_elapsed == false){
+        if(listen_fd >= 0){
+            struct pollfd p = {listen_fd, POLLIN, 0};
+            if(poll(&p, 1, METRICS_POLL_INTERVAL_MS) > 0 && (p.revents & POLLIN))
+                serve_client();
+        }
+        else{
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(METRICS_POLL_INTERVAL_MS));
+        }
+
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(status_interval_sec > 0.0 && now - t_status >= interval){
+            print_status(std::chrono::duration<double>(now - t_status).count());
+            t_status = now;
+        }
+    }
+
+    if(listen_fd >= 0){
+        close(listen_fd);
+        listen_fd = -1;
+    }
+}
+
+void show_debug_information_metrics(){
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Metrics:" << std::endl;
+    std::cout << "port: " << port << std::endl;
+    std::cout << "status_interval_sec: " << status_interval_sec << std::endl;
+    std::cout << "n_scrapes: " << n_scrapes << std::endl;
+    std::cout << "n_status_lines: " << n_status_lines << std::endl;
+    std::cout << "threads:";
+    for(size_t i = 0; i < n_slots.load(); i++)
+        std::cout << " " << slot_roles[i] << slot_indices[i];
+    std::cout << std::endl;
+    for(size_t c = 0; c < METRIC_N_COUNTERS; c++)
+        std::cout << counter_names[c][0] << ": " << get_metric_total(static_cast<metrics_counter_enum>(c)) << std::endl;
+    std::cout << "--------------------------" << std::endl;
+}
+
+// any request is answered with all metrics, the connection is closed afterwards
+static void serve_client(){
+    const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if(fd < 0)
+        return;
+
+    // read until the end of the request header, the request itself is ignored
+    std::string request;
+    char buf[512];
+    while(request.size() < METRICS_MAX_REQUEST_BYTES && request.find("\r\n\r\n") == std::string::npos){
+        struct pollfd p = {fd, POLLIN, 0};
+        if(poll(&p, 1, METRICS_REQUEST_TIMEOUT_MS) <= 0)
+            break;
+        const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if(n <= 0)
+            break;
+        request.append(buf, n);
+    }
+
+    const std::string body = format_metrics();
+    std::ostringstream ss;
+    ss << "HTTP/1.0 200 OK\r\n"
+       << "Content-Type: text/plain; version=0.0.4\r\n"
+       << "Content-Length: " << body.size() << "\r\n"
+       << "Connection: close\r\n\r\n"
+       << body;
+    const std::string response = ss.str();
+    size_t sent = 0;
+    while(sent < response.size()){
+        const ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if(n <= 0)
+            break;
+        sent += n;
+    }
+    close(fd);
+    n_scrapes++;
+}
+
+// Prometheus text format, counters per thread and gauges per pipeline
+static std::string format_metrics(){
+    std::ostringstream ss;
+    const size_t n = n_slots.load(std::memory_order_acquire);
+    for(size_t c = 0; c < METRIC_N_COUNTERS; c++){
+        ss << "# HELP " << METRICS_PREFIX << counter_names[c][0] << " " << counter_names[c][1] << "\n";
+        ss << "# TYPE " << METRICS_PREFIX << counter_names[c][0] << " counter\n";
+        for(size_t i = 0; i < n; i++)
+            ss << METRICS_PREFIX << counter_names[c][0] << "{thread=\"" << slot_roles[i] << "\",index=\"" << slot_indices[i] << "\"} " << slots[i].counters[c].load(std::memory_order_relaxed) << "\n";
+        ss << METRICS_PREFIX << counter_names[c][0] << "{thread=\"other\",index=\"0\"} " << shared_slot.counters[c].load(std::memory_order_relaxed) << "\n";
+    }
+
+    boost::mutex::scoped_lock lk(m_mutex);
+    for(size_t g = 0; g < gauges.size(); g++){
+        if(g == 0 || gauges[g].name != gauges[g - 1].name){
+            ss << "# HELP " << METRICS_PREFIX << gauges[g].name << " " << gauges[g].help << "\n";
+            ss << "# TYPE " << METRICS_PREFIX << gauges[g].name << " gauge\n";
+        }
+        ss << METRICS_PREFIX << gauges[g].name << "{pipeline=\"" << gauges[g].id << "\"} " << gauges[g].function(gauges[g].id) << "\n";
+    }
+    for(size_t t = 0; t < texts.size(); t++)
+        texts[t](ss);
+    ss << "# HELP " << METRICS_PREFIX << "uptime_seconds seconds since the metrics were initialized\n";
+    ss << "# TYPE " << METRICS_PREFIX << "uptime_seconds gauge\n";
+    ss << METRICS_PREFIX << "uptime_seconds " << std::chrono::duration<double>(std::chrono::steady_clock::now() - tstart).count() << "\n";
+
+    return ss.str();
+}
+
+// rates since the last line, totals of all error counters and the gauges of each pipeline
+static void print_status(const double interval_sec){
+    static unsigned long long last[METRIC_N_COUNTERS] = {0};
+    unsigned long long total[METRIC_N_COUNTERS];
+    for(size_t c = 0; c < METRIC_N_COUNTERS; c++)
+        total[c] = get_metric_total(static_cast<metrics_counter_enum>(c));
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    ss << "[metrics " << std::chrono::duration<double>(std::chrono::steady_clock::now() - tstart).count() << "s]";
+    ss << " rx " << (total[METRIC_RX_SAMPLES] - last[METRIC_RX_SAMPLES])/interval_sec/1e6 << " MS/s";
+    ss << " tx " << (total[METRIC_TX_SAMPLES] - last[METRIC_TX_SAMPLES])/interval_sec/1e6 << " MS/s";
+    ss << " windows " << (total[METRIC_WINDOWS_CAPTURED] - last[METRIC_WINDOWS_CAPTURED])/interval_sec << "/s";
+    ss << " write " << (total[METRIC_BYTES_WRITTEN] - last[METRIC_BYTES_WRITTEN])/interval_sec/1e6 << " MB/s";
+    ss << " | overruns " << total[METRIC_RX_OVERRUNS];
+    ss << " underruns " << total[METRIC_TX_UNDERRUNS];
+    ss << " incomplete " << total[METRIC_WINDOWS_INCOMPLETE];
+    ss << " dropped " << total[METRIC_WINDOWS_DROPPED];
+    ss << " lost " << total[METRIC_SAMPLES_LOST];
+    ss << " write_errors " << total[METRIC_WRITE_ERRORS];
+    {
+        boost::mutex::scoped_lock lk(m_mutex);
+        for(size_t g = 0; g < gauges.size(); g++){
+            if(g == 0 || gauges[g].name != gauges[g - 1].name)
+                ss << (g == 0 ? " | " : " ") << gauges[g].name << " ";
+            else
+                ss << "/";
+            ss << gauges[g].function(gauges[g].id);
+        }
+    }
+    std::cout << ss.str() << std::endl;
+
+    for(size_t c = 0; c < METRIC_N_COUNTERS; c++)
+        last[c] = total[c];
+    n_status_lines++;
+}
+}
@@ -0,0 +1,143 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_METRICS_H
+#define CHANNELSOUNDER_METRICS_H
+
+#include <atomic>
+#include <string>
+#include <iosfwd>
+#include <cstddef>
+
+// size of a cache line, the counters of two threads never share one
+#define METRICS_CACHE_LINE      64
+
+namespace channelsounder
+{
+// counters of the pipeline, summed over all threads when read
+enum metrics_counter_enum{
+    METRIC_RX_SAMPLES = 0,              // received samples of all channels
+    METRIC_RX_OVERRUNS,
+    METRIC_RX_DROPPED_SAMPLES,          // samples lost in overruns according to the time stamps
+    METRIC_RX_SEQUENCE_ERRORS,
+    METRIC_RX_LATE_COMMANDS,
+    METRIC_RX_TIMEOUTS,
+    METRIC_TX_SAMPLES,                  // transmitted samples of all channels
+    METRIC_TX_UNDERRUNS,
+    METRIC_TX_SEQUENCE_ERRORS,
+    METRIC_TX_TIMEOUTS,
+    METRIC_TX_BURSTS,
+    METRIC_TX_LATE_BURSTS,
+    METRIC_RING_SLOTS_OVERWRITTEN,      // rx ring slots written again because the process thread was behind
+    METRIC_WINDOWS_CAPTURED,            // measurements finished by the fifo, complete or not
+    METRIC_WINDOWS_INCOMPLETE,          // measurements missing samples
+    METRIC_WINDOWS_DROPPED,             // measurements lost because all fifo buffers were waiting for the save thread
+    METRIC_SAMPLES_LOST,                // samples missing in the fifo according to the time stamps
+    METRIC_FILES_WRITTEN,
+    METRIC_WRITE_ERRORS,
+    METRIC_BYTES_WRITTEN,
+    METRIC_N_COUNTERS
+};
+
+// counters of one thread, only written by that thread
+struct alignas(METRICS_CACHE_LINE) metrics_slot{
+    std::atomic<unsigned long long> counters[METRIC_N_COUNTERS];
+};
+
+// set by register_metrics_thread(), threads without a slot of their own share one
+extern thread_local metrics_slot* metrics_thread_slot;
+void add_metric_shared(const metrics_counter_enum counter, const unsigned long long n);
+
+// value of a gauge of one pipeline, called when the metrics are read, must only read atomics
+typedef unsigned long long (*metrics_gauge_function_t)(const size_t id);
+
+// appends whole metric families in the Prometheus text format, e.g. summaries, called when the metrics are served
+typedef void (*metrics_text_function_t)(std::ostream &out);
+
+/*!
+ * Inits unit internally. Must be called before any pipeline thread is started.
+ *
+ * port_arg                     TCP port on 127.0.0.1 serving the metrics in the Prometheus text format at any path, 0 to disable
+ * status_interval_sec_arg      print a one-line status to stdout every this many seconds, 0 to disable
+ * return                       1 on success and 0 on failure, e.g. if the port is in use
+*/
+int init_metrics(const unsigned int port_arg, const double status_interval_sec_arg);
+
+/*!
+ * return                       true if the endpoint or the status line is enabled, so serve_metrics() needs a thread
+*/
+bool is_metrics_enabled();
+
+/*!
+ * Gives the calling thread counters of its own, labeled role and index in the endpoint. Not needed for counting.
+ *
+ * role                         e.g. "rx", "process", "save", see thread_placement.h
+ * index                        index of the thread within its role, e.g. the pipeline id
+*/
+void register_metrics_thread(const std::string &role, const size_t index);
+
+/*!
+ * Counts an event of the calling thread, a plain store to memory of this thread without any lock.
+ *
+ * counter                      METRIC_RX_SAMPLES etc.
+ * n                            increment
+*/
+inline void add_metric(const metrics_counter_enum counter, const unsigned long long n){
+    metrics_slot* s = metrics_thread_slot;
+    if(s == nullptr){
+        add_metric_shared(counter, n);
+        return;
+    }
+    s->counters[counter].store(s->counters[counter].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/*!
+ * Adds a gauge of one pipeline, e.g. the occupancy of a buffer pool, read when the metrics are served.
+ *
+ * name                         name in the endpoint without prefix, e.g. "fifo_buffers_used"
+ * help                         one line of description
+ * function                     returns the current value
+ * id                           pipeline, passed on to function
+*/
+void add_metrics_gauge(const std::string &name, const std::string &help, const metrics_gauge_function_t function, const size_t id);
+
+/*!
+ * Adds metrics formatted by another unit, e.g. latency percentiles.
+ *
+ * function                     writes the metric families, must not block
+*/
+void add_metrics_text(const metrics_text_function_t function);
+
+/*!
+ * counter                      METRIC_RX_SAMPLES etc.
+ * return                       sum over all threads
+*/
+unsigned long long get_metric_total(const metrics_counter_enum counter);
+
+/*!
+ * Serves the endpoint and prints the status line until burst_timer_elapsed is set, runs in a thread of its own.
+ * The pipeline threads are never waited for.
+*/
+void serve_metrics(std::atomic<bool>& burst_timer_elapsed);
+
+/*!
+ * Shows the registered threads and the totals of all counters.
+*/
+void show_debug_information_metrics();
+}
+ 
+#endif
@@ -14,162 +14,243 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 */
-
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
 #include <boost/thread/thread.hpp>
 
 #include "debug.h"
+#include "config.h"
 #include "ringbuffer_rx.h"
+#include "buffer_allocator.h"
 #include "fifo_ch_measurement.h"
+#include "metrics.h"
+#include "latency_histogram.h"
+#include "event_trace.h"
 
 #define N_COMPLEX_SAMPLES_PER_BUFFER        1000000
+#define N_WORKER_POLL_INTERVAL_US           100
 
 namespace channelsounder
 {
-static size_t n_channels;                   // number of channels/antennas, set in init function
-static size_t n_bytes_per_item;             // size of complex sample
-static size_t max_items_per_packet;         // maximum number of samples passed on by uhd driver
-
-enum buffer_enum{
-    NO_BUFFER = -1,
-    BUFFER0 = 0,
-    BUFFER1 = 1
-};
-static buffer_enum buffer2write;
-static buffer_enum buffer2process;
-static unsigned long long n_samples;        // number of samples written to current write buffer
-static unsigned long long n_samples_old;    // number of samples written to last buffer used
-
-// the static memory uhd will write to
+// one slot of the ring
 // columns: number of rx channels (antennas)
 // rows: container for samples
-static std::vector<std::vector<char>> buffs0;
-static std::vector<std::vector<char>> buffs1;
+struct slot{
+    std::vector<buffer_t> buffs01;
+    unsigned long long n_samples;           // number of samples written to this slot, set before the slot is published
+    long long first_tick;                   // device time of the first sample, samples within a slot are always contiguous
+    unsigned long long t_published;         // latency_clock() when the slot was handed to the process thread
+};
 
-// actual output given to uhd, points to buffs0 and buffs1
-static std::vector<void*> buffs;
+// one independent ring per rx pipeline
+struct ringbuffer_rx_unit{
+    size_t id;                              // index of the pipeline, passed on to the fifo
+    size_t n_channels;                      // number of channels/antennas, set in init function
+    size_t n_bytes_per_item;                // size of complex sample
+    size_t max_items_per_packet;            // maximum number of samples passed on by uhd driver
+    size_t n_slots;                         // depth of the ring, at least two slots
 
-static boost::mutex m_mutex;
-static boost::condition_variable m_condition;
-    
-static struct stats local_stats;
+    std::vector<slot> slots;
+
+    // single producer (uhd recv thread) and single consumer (process thread), both indices only ever increase
+    // head: number of slots published by the producer, the producer writes into slots[head % n_slots]
+    // tail: number of slots released by the consumer, the consumer reads from slots[tail % n_slots]
+    std::atomic<unsigned long long> head;
+    std::atomic<unsigned long long> tail;
+
+    unsigned long long n_samples;           // number of samples written to current write slot
 
-int init_ringbuffer_rx(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const size_t max_items_per_packet_arg){
-    n_channels = n_channels_arg;
-    n_bytes_per_item = n_bytes_per_item_arg;
-    max_items_per_packet = max_items_per_packet_arg;
+    // actual output given to uhd, points into the current write slot
+    std::vector<void*> buffs;
+
+    struct stats local_stats;
+};
+static ringbuffer_rx_unit units[MAX_PIPELINES];
+
+static void point_to_slot(ringbuffer_rx_unit &u, const unsigned long long slot_index, const unsigned long long n_samples_offset);
+static unsigned long long ring_slots_used(const size_t id);
+
+int init_ringbuffer_rx(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const size_t max_items_per_packet_arg, const size_t n_slots_arg, const size_t id){
+    if(n_slots_arg < 2){
+        std::cerr << "ringbuffer_rx: At least two slots are required." << std::endl;
+        return 0;
+    }
+    if(id >= MAX_PIPELINES){
+        std::cerr << "ringbuffer_rx: id exceeds MAX_PIPELINES." << std::endl;
+        return 0;
+    }
+    ringbuffer_rx_unit &u = units[id];
 
-    buffer2write = BUFFER0;
-    buffer2process = NO_BUFFER;
-    n_samples = 0;
-    n_samples_old = 0;
+    u.id = id;
+    u.n_channels = n_channels_arg;
+    u.n_bytes_per_item = n_bytes_per_item_arg;
+    u.max_items_per_packet = max_items_per_packet_arg;
+    u.n_slots = n_slots_arg;
+
+    u.head = 0;
+    u.tail = 0;
+    u.n_samples = 0;
     
-    // initialize buffers
-    std::vector<char> buff_template((N_COMPLEX_SAMPLES_PER_BUFFER + max_items_per_packet*2) * n_bytes_per_item);
-    for (size_t ch = 0; ch < n_channels; ch++){
-        // create one row for each channel/antenna
-        buffs0.push_back(buff_template);
-        buffs1.push_back(buff_template);
+    // initialize slots, memory is taken from the pre-faulted arena
+    const size_t n_bytes_per_buffer = (N_COMPLEX_SAMPLES_PER_BUFFER + u.max_items_per_packet*2) * u.n_bytes_per_item;
+    u.slots.resize(u.n_slots);
+    for (size_t s = 0; s < u.n_slots; s++){
+        u.slots[s].n_samples = 0;
+        u.slots[s].first_tick = 0;
+        u.slots[s].t_published = 0;
         
-        if(buffer2write == BUFFER0)
-            buffs.push_back(&buffs0[ch].front());
-        else if (buffer2write == BUFFER1)
-            buffs.push_back(&buffs1[ch].front());
+        // create one row for each channel/antenna
+        for (size_t ch = 0; ch < u.n_channels; ch++)
+            u.slots[s].buffs01.push_back(buffer_t(n_bytes_per_buffer));
     }
     
-    local_stats.reset();
+    u.buffs.resize(u.n_channels);
+    point_to_slot(u, 0, 0);
+    
+    add_metrics_gauge("ring_slots_used", "rx ring slots published but not yet processed", ring_slots_used, id);
+    u.local_stats.reset();
     
     return 1;
 }
     
-std::vector<void*> get_ringbuffer_rx_pointers(const unsigned long long n_new_samples){
-    DBG_RB(local_stats.n_samples_total += n_new_samples;)
-    n_samples += n_new_samples;
-
-    // current write buffer not full yet
-    if(n_samples < N_COMPLEX_SAMPLES_PER_BUFFER){
-        unsigned int offset = n_new_samples*n_bytes_per_item;
-        if(buffer2write == BUFFER0){
-            for (size_t ch = 0; ch < n_channels; ch++)
-                buffs[ch] = static_cast<void*>(&buffs0[ch][offset]);
-        }
-        else{
-            for (size_t ch = 0; ch < n_channels; ch++)
-                buffs[ch] = static_cast<void*>(&buffs1[ch][offset]);            
+std::vector<void*> get_ringbuffer_rx_pointers(const unsigned long long n_new_samples, const long long tick, const size_t id){
+    ringbuffer_rx_unit &u = units[id];
+    
+    DBG_RB(u.local_stats.n_samples_total += n_new_samples;)
+
+    // only the producer writes head, so a relaxed load is sufficient
+    unsigned long long head_local = u.head.load(std::memory_order_relaxed);
+    
+    if(n_new_samples > 0){
+        slot &s = u.slots[head_local % u.n_slots];
+        
+        if(u.n_samples == 0){
+            s.first_tick = tick;
         }
-    }
-    // buffer full, so switch buffer
-    else{
-        DBG_RB(local_stats.n_full++;)
-        n_samples_old = n_samples;
-        n_samples = 0;
-        {
-            boost::mutex::scoped_lock lock(m_mutex, boost::try_to_lock);
+        // samples were lost, close the slot early so slots stay contiguous in time
+        else if(tick != s.first_tick + (long long) u.n_samples){
+            slot *s_next = &s;
             
-            // if we were able to lock the mutex, the processing thread must be in waiting state, so we prepare processing and then notify worker thread
-            if(lock){
-                if(buffer2write == BUFFER0){
-                    buffer2write = BUFFER1;
-                    buffer2process = BUFFER0;
-                    for (size_t ch = 0; ch < n_channels; ch++)
-                        buffs[ch] = static_cast<void*>(&buffs1[ch].front());
-                }
-                else{
-                    buffer2write = BUFFER0;
-                    buffer2process = BUFFER1;
-                    for (size_t ch = 0; ch < n_channels; ch++)
-                        buffs[ch] = static_cast<void*>(&buffs0[ch].front());
-                }
+            const unsigned long long n_used = head_local - u.tail.load(std::memory_order_acquire);
+            if(n_used + 1 < u.n_slots){
+                s.n_samples = u.n_samples;
+                s.t_published = latency_clock();
+                u.head.store(head_local + 1, std::memory_order_release);
+                trace_instant(TRACE_RING_PUBLISH, n_used + 1, u.id);
+                head_local++;
+                s_next = &u.slots[head_local % u.n_slots];
             }
-            // if we were unable to lock the mutex, the processing thread is not done yet and we write data into the same buffer again, therefore losing samples
             else{
-                DBG_RB(local_stats.n_worker_not_done++;)
-                buffer2process = NO_BUFFER;
-                if(buffer2write == BUFFER0){
-                    for (size_t ch = 0; ch < n_channels; ch++)
-                        buffs[ch] = static_cast<void*>(&buffs0[ch].front());
-                }
-                else{
-                    for (size_t ch = 0; ch < n_channels; ch++)
-                        buffs[ch] = static_cast<void*>(&buffs1[ch].front());
-                }            
+                DBG_RB(u.local_stats.n_worker_not_done++;)
+                add_metric(METRIC_RING_SLOTS_OVERWRITTEN, 1);
+                trace_instant(TRACE_RING_OVERWRITE, n_used, u.id);
             }
+            
+            // move the new samples to the beginning of the next slot, rare and at most one packet
+            for (size_t ch = 0; ch < u.n_channels; ch++)
+                std::memmove(&s_next->buffs01[ch].front(), &s.buffs01[ch][u.n_samples*u.n_bytes_per_item], n_new_samples*u.n_bytes_per_item);
+            s_next->first_tick = tick;
+            u.n_samples = 0;
         }
-        m_condition.notify_all();
     }
     
-    return buffs;
+    u.n_samples += n_new_samples;
+    
+    // current write slot not full yet
+    if(u.n_samples < N_COMPLEX_SAMPLES_PER_BUFFER){
+        point_to_slot(u, head_local, u.n_samples);
+    }
+    // slot full, so publish it if there is a spare slot
+    else{
+        DBG_RB(u.local_stats.n_full++;)
+        
+        const unsigned long long n_used = head_local - u.tail.load(std::memory_order_acquire);
+        
+        // at least one spare slot, hand current slot to the process thread and continue in the next one
+        if(n_used + 1 < u.n_slots){
+            u.slots[head_local % u.n_slots].n_samples = u.n_samples;
+            u.slots[head_local % u.n_slots].t_published = latency_clock();
+            u.head.store(head_local + 1, std::memory_order_release);
+            trace_instant(TRACE_RING_PUBLISH, n_used + 1, u.id);
+            DBG_RB(u.local_stats.n_slots_high_water = std::max(u.local_stats.n_slots_high_water, n_used + 1);)
+            
+            point_to_slot(u, head_local + 1, 0);
+        }
+        // all other slots are still waiting to be processed, we write data into the same slot again, therefore losing samples
+        else{
+            DBG_RB(u.local_stats.n_worker_not_done++;)
+            add_metric(METRIC_RING_SLOTS_OVERWRITTEN, 1);
+            trace_instant(TRACE_RING_OVERWRITE, n_used, u.id);
+            point_to_slot(u, head_local, 0);
+        }
+        u.n_samples = 0;
+    }
+    
+    return u.buffs;
 }
     
-void process_ringbuffer_rx(std::atomic<bool>& burst_timer_elapsed){
+void process_ringbuffer_rx(std::atomic<bool>& burst_timer_elapsed, const size_t id){
+    ringbuffer_rx_unit &u = units[id];
+    
+    bool waiting = false;
+    std::vector<const char*> buffs01(u.n_channels);
     
     while(1){
-            boost::mutex::scoped_lock lock(m_mutex);
-
-            while(buffer2process == NO_BUFFER){
-                DBG_RB(local_stats.n_worker_wait++;)
-                                    
-                // from time to time we check if "burst_timer_elapsed" was set to true
-                m_condition.wait_for(lock, boost::chrono::milliseconds(1000));
-                
-                // is set in main thread to stop execution
-                if(burst_timer_elapsed == true)
-                    return;
-            }    
-
-            DBG_RB(local_stats.n_worker_executed++;)
-
-            if(buffer2process == BUFFER0)
-                feed_new_ch_measurement(buffs0, n_samples_old);
-            else if(buffer2process == BUFFER1)
-                feed_new_ch_measurement(buffs1, n_samples_old);
-
-            // we are done, make sure we enter wait loop
-            buffer2process = NO_BUFFER;
+        // only the consumer writes tail, so a relaxed load is sufficient
+        const unsigned long long tail_local = u.tail.load(std::memory_order_relaxed);
+        
+        // nothing published, poll again after a short sleep instead of blocking the recv thread with a mutex
+        if(tail_local == u.head.load(std::memory_order_acquire)){
+            if(waiting == false){
+                DBG_RB(u.local_stats.n_worker_wait++;)
+                waiting = true;
+            }
+            
+            // is set in main thread to stop execution
+            if(burst_timer_elapsed == true)
+                return;
+            
+            boost::this_thread::sleep_for(boost::chrono::microseconds(N_WORKER_POLL_INTERVAL_US));
+            continue;
+        }
+        waiting = false;
+
+        DBG_RB(u.local_stats.n_worker_executed++;)
+
+        const slot &s = u.slots[tail_local % u.n_slots];
+        const unsigned long long t_feed = latency_clock();
+        record_latency(LATENCY_RING_WAKEUP, t_feed - s.t_published, u.id);
+        for (size_t ch = 0; ch < u.n_channels; ch++)
+            buffs01[ch] = &s.buffs01[ch].front();
+        feed_new_ch_measurement(buffs01, s.n_samples, s.first_tick, u.id);
+        const unsigned long long t_fed = latency_clock();
+        record_latency(LATENCY_FIFO_FEED, t_fed - t_feed, u.id);
+        trace_span(TRACE_FIFO_FEED, t_feed, t_fed, s.n_samples, u.id);
+
+        // we are done, the producer may reuse this slot
+        u.tail.store(tail_local + 1, std::memory_order_release);
     }
 }
     
-void show_debug_information_ringbuffer_rx(){
-    local_stats.print_data("Ringbuffer RX:");
+void show_debug_information_ringbuffer_rx(const size_t id){
+    std::ostringstream ss;
+    ss << "Ringbuffer RX " << id << ":";
+    units[id].local_stats.print_data(ss.str());
+}
+
+static void point_to_slot(ringbuffer_rx_unit &u, const unsigned long long slot_index, const unsigned long long n_samples_offset){
+    slot &s = u.slots[slot_index % u.n_slots];
+    const size_t offset = n_samples_offset*u.n_bytes_per_item;
+    for (size_t ch = 0; ch < u.n_channels; ch++)
+        u.buffs[ch] = static_cast<void*>(&s.buffs01[ch][offset]);
+}
+
+// read by the metrics thread, both indices are atomic
+static unsigned long long ring_slots_used(const size_t id){
+    const ringbuffer_rx_unit &u = units[id];
+    const unsigned long long tail = u.tail.load(std::memory_order_relaxed);
+    return u.head.load(std::memory_order_relaxed) - tail;
 }
 }
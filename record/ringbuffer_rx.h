@@ -25,35 +25,41 @@ namespace channelsounder
 {
 /*!
  * Inits unit internally. Must be called first.
+ * There is one independent ring per rx pipeline, all other functions must be called with the same id.
  *
  * num_channels_arg             in our case this is the number of rx antennas
  * num_bytes_per_item_arg       one item is one complex sample with real and imag, e.g. with data type "float" it is num_bytes_per_item_arg=8
  * max_items_per_packet_arg     depends on what uhd driver does, tries to fully utilize 10Gbit/s bandwidth of ethernet NIC, needed for size of internal static memory
+ * n_slots_arg                  depth of the lock-free ring, spare slots absorb short stalls of the process thread, must be at least 2
+ * id                           index of the pipeline, smaller than MAX_PIPELINES, the fifo with the same id is fed
  * return                       1 on success and 0 on failure
 */
-int init_ringbuffer_rx(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const size_t max_items_per_packet_arg);
+int init_ringbuffer_rx(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const size_t max_items_per_packet_arg, const size_t n_slots_arg, const size_t id);
 
 /*!
  * Must be called initially with n_new_samples=0.
  * Breaks unit encapsulation, better solution needed.
+ * Never blocks, if no spare slot is left the current slot is overwritten.
+ * A gap in the time stamps closes the current slot early, so samples within a slot are contiguous.
  *
  * n_new_samples                number of new samples written per channel to pointers from last call
+ * tick                         device time of the first new sample in samples, e.g. md.time_spec.to_ticks(rate)
  * return                       vector of pointers pointing to internal static vectors (faster than dedicated write function), this is where uhd writes to
 */
-std::vector<void*> get_ringbuffer_rx_pointers(const unsigned long long n_new_samples);
+std::vector<void*> get_ringbuffer_rx_pointers(const unsigned long long n_new_samples, const long long tick, const size_t id);
 
 /*!
- * Must be started in additional thread, processes unused half of ringbuffer.
- * Must process faster than it takes to fill one buffer, otherwise samples are dropped.
+ * Must be started in additional thread, processes published slots of the ringbuffer in order.
+ * Must on average process faster than it takes to fill one slot, otherwise samples are dropped.
  *
  * burst_timer_elapsed          when set to true, the thread has to finish
 */    
-void process_ringbuffer_rx(std::atomic<bool>& burst_timer_elapsed);
+void process_ringbuffer_rx(std::atomic<bool>& burst_timer_elapsed, const size_t id);
     
 /*!
  * Shows some stats of the ring buffer.
 */    
-void show_debug_information_ringbuffer_rx();
+void show_debug_information_ringbuffer_rx(const size_t id);
 }
  
 #endif
@@ -17,18 +17,26 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
 #include <fstream>
-#include <stdlib.h>
-#include <math.h>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "debug.h"
 #include "config.h"
 #include "ringbuffer_tx.h"
+#include "buffer_allocator.h"
+#include "sequence.h"
+#include "seq_format.h"
 
-//#define ONE_AND_MINUS_ONE
-#define SINE_1MHZ
+// legacy lengths if none is given
+#define SEQ_LENGTH_ONE_AND_MINUS_ONE    4000
+#define SEQ_PERIOD_SINE_1MHZ            1000000     // samp_rate/SEQ_PERIOD_SINE_1MHZ samples
 
-#define SCALE_SC16  4096.0f
-#define SCALE_FC32  0.5f
+// waveform pages are read this far ahead of the play position and released once played, per channel
+#define WAVEFORM_READAHEAD_BYTES        (64*1024*1024)
 
 namespace channelsounder
 {
@@ -39,50 +47,84 @@ static unsigned int samp_rate;          // S/s
 
 static size_t n_seq;                    // number of sequence repetitions
 static size_t n_seq_len;                // length of the sequence in complex samples
+static uint32_t seq_type;               // SEQ_TYPE_SINE_1MHZ etc., see seq_format.h
+static unsigned int seq_root;           // zadoff-chu only
+static size_t n_active;                 // samples at the start of each period carrying the sequence
+static size_t cyclic_shift;             // between two neighbouring channels, 0 if unrelated
 
 static size_t n_samples;                // at which samples index within the sequence are we?
 
 // the static memory uhd will read from
-// columns: number of rx channels (antennas)
+// columns: number of rx channels (antennas), a single one if all channels are cyclic shifts of channel 0
 // rows: container for samples
-static std::vector<std::vector<char>> buffs0;
+static std::vector<buffer_t> buffs0;
+
+// period of channel ch starts at sample channel_offset[ch] of channel_buffer[ch], the buffers hold at least two periods
+static std::vector<char*> channel_buffer;
+static std::vector<size_t> channel_offset;
+static bool shared_buffer;
 
 // actual output given to uhd, points to buffs0 and buffs1
 static std::vector<void*> buffs;
+
+// waveform playback, only used if init_ringbuffer_tx_waveform() was called
+static bool waveform;
+static bool waveform_loop;
+static bool waveform_populate;
+static std::string waveform_file;
+static char* waveform_map;
+static size_t waveform_map_bytes;
+static size_t waveform_data_offset;                 // bytes in front of channel 0
+static unsigned long long n_waveform_samples;       // per channel
+static unsigned long long n_waveform_pos;           // next sample to be sent
+static unsigned long long n_waveform_readahead;     // position at which the next readahead is issued
+static unsigned long long n_waveform_loops;
+static unsigned long long n_waveform_readaheads;
     
 static struct stats local_stats;
 
 // after initializing buffer we generate the actual sequence
-static void generate_sequence();
+static int generate_sequence();
+static void save_sequence();
+static unsigned long long sequence_checksum();
 static void print_data_init();
+static void waveform_readahead();
+static void quantize(const std::vector<std::complex<float>> &seq, char* out);
+static inline void set_sequence_pointers();
 
-int init_ringbuffer_tx(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const size_t max_items_per_packet_arg, const unsigned int samp_rate_arg){
+int init_ringbuffer_tx(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const size_t max_items_per_packet_arg, const unsigned int samp_rate_arg,
+                       const uint32_t seq_type_arg, const size_t seq_length_arg, const unsigned int seq_root_arg){
+    if(n_bytes_per_item_arg != 4 && n_bytes_per_item_arg != 8){
+        std::cerr << "ringbuffer_tx: Unknown data type." << std::endl;
+        return 0;
+    }
     n_channels = n_channels_arg;
     n_bytes_per_item = n_bytes_per_item_arg;
     max_items_per_packet = max_items_per_packet_arg;
     samp_rate = samp_rate_arg;
+    seq_type = seq_type_arg;
+    seq_root = seq_root_arg;
+    waveform = false;
 
-#ifdef ONE_AND_MINUS_ONE
-    n_seq_len = 4000;
-#endif    
-#ifdef SINE_1MHZ
-    n_seq_len = samp_rate/1000000;
-#endif
+    n_seq_len = seq_length_arg;
+    if(n_seq_len == 0 && seq_type == SEQ_TYPE_ONE_AND_MINUS_ONE)
+        n_seq_len = SEQ_LENGTH_ONE_AND_MINUS_ONE;
+    if(n_seq_len == 0 && seq_type == SEQ_TYPE_SINE_1MHZ)
+        n_seq_len = samp_rate/SEQ_PERIOD_SINE_1MHZ;
+    if(n_seq_len == 0){
+        std::cerr << "ringbuffer_tx: sequence length must be larger than 0." << std::endl;
+        return 0;
+    }
     
     n_samples = 0;
     
     // how often do we need to repeat the sequence?
     n_seq = max_items_per_packet/n_seq_len + 2;
     
-    // initialize buffers and pointers
-    std::vector<char> buff_template(n_seq * n_seq_len * n_bytes_per_item);
-    for (size_t ch = 0; ch < n_channels; ch++){
-        // create one row for each channel/antenna
-        buffs0.push_back(buff_template);
-        buffs.push_back(&buffs0[ch].front());
-    }
-    
-    generate_sequence();
+    // buffers and pointers are initialized with the sequence
+    if(generate_sequence() == 0)
+        return 0;
+    save_sequence();
     print_data_init();
     local_stats.reset();
     
@@ -90,121 +132,327 @@ int init_ringbuffer_tx(const size_t n_channels_arg, const size_t n_bytes_per_ite
 }
     
 std::vector<void*> get_ringbuffer_tx_pointers(const size_t n_new_samples){
+    if(waveform){
+        size_t n_samples_max;
+        return get_ringbuffer_tx_pointers(n_new_samples, n_samples_max);
+    }
+    
     DBG_RB(local_stats.n_samples_total += n_new_samples;)
     n_samples += n_new_samples;
     n_samples = n_samples % n_seq_len;
 
-    unsigned int byte_offset = n_samples*n_bytes_per_item;
-    for (size_t ch = 0; ch < n_channels; ch++)
-        buffs[ch] = static_cast<void*>(&buffs0[ch][byte_offset]);
+    set_sequence_pointers();
     
     return buffs;
 }
-    
-void show_debug_information_ringbuffer_tx(){
-    local_stats.print_data("Ringbuffer TX:");
-}
 
-static void generate_sequence(){
+int init_ringbuffer_tx_waveform(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const size_t max_items_per_packet_arg,
+                                const std::string &file_name, const bool loop_arg, const bool populate_arg){
+    n_channels = n_channels_arg;
+    n_bytes_per_item = n_bytes_per_item_arg;
+    max_items_per_packet = max_items_per_packet_arg;
+    waveform = true;
+    waveform_loop = loop_arg;
+    waveform_populate = populate_arg;
+    waveform_file = file_name;
     
-    // single sequence without repetitions
-    std::vector<std::vector<float>> seq(n_channels);
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if(fd < 0){
+        std::cerr << "ringbuffer_tx: could not open " << file_name << ": " << strerror(errno) << std::endl;
+        return 0;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0){
+        std::cerr << "ringbuffer_tx: " << file_name << " is empty." << std::endl;
+        close(fd);
+        return 0;
+    }
+    waveform_map_bytes = st.st_size;
     
-    for(int ch=0; ch<n_channels; ch++){
-        
-        for(int j=0; j<n_seq_len; j++){
-            
-#ifdef ONE_AND_MINUS_ONE
-            float real = 2*(rand() % 2) - 1;
-            float imag = 2*(rand() % 2) - 1;
-#endif            
-#ifdef SINE_1MHZ
-            double samp_rate_d = (double) samp_rate;
-            double T = 1.0/samp_rate_d;
-            double t = T* (double) j;
-            double f = 1e6 + 1e6 * (double) ch;   // we variate the frequency for each channel
-            double pi = 3.141592654;
-            float real = cos(2.0*pi*f*t);
-            float imag = sin(2.0*pi*f*t);
-#endif
-            seq[ch].push_back(real);
-            seq[ch].push_back(imag);
-        }
+    // the kernel reads the file in large sequential chunks, with populate all of it now
+    void* p = mmap(nullptr, waveform_map_bytes, PROT_READ, MAP_SHARED | (waveform_populate ? MAP_POPULATE : 0), fd, 0);
+    close(fd);
+    if(p == MAP_FAILED){
+        std::cerr << "ringbuffer_tx: could not map " << file_name << ": " << strerror(errno) << std::endl;
+        return 0;
     }
+    waveform_map = static_cast<char*>(p);
+    madvise(waveform_map, waveform_map_bytes, MADV_SEQUENTIAL);
     
-    // repeat the sequence
-    for(int ch=0; ch<n_channels; ch++){
-        std::vector<float> cpy = seq[ch];
-        for(int j=0; j<n_seq; j++)
-            std::copy(cpy.begin(), cpy.end(), std::back_inserter(seq[ch]));
+    // header of seq.bin or raw samples
+    unsigned long long file_samp_rate;
+    if(parse_sequence_file(waveform_map, waveform_map_bytes, n_channels, n_bytes_per_item, file_name, waveform_data_offset, n_waveform_samples, file_samp_rate) == 0){
+        munmap(waveform_map, waveform_map_bytes);
+        waveform_map = nullptr;
+        return 0;
     }
+    samp_rate = file_samp_rate;
     
-    // sanity check the size
-    for(int ch=0; ch<n_channels; ch++){
-        unsigned int size_in_bytes_0 = buffs0[ch].size()*sizeof(buffs0[ch][0]);
-        unsigned int size_in_bytes_1 = seq[ch].size()*sizeof(seq[ch][0]);
-        if(size_in_bytes_0 != size_in_bytes_0)
-            std::cerr << "ERROR: Sizes are not correct." << std::endl;
+    seq_type = 0;
+    n_seq_len = n_waveform_samples;
+    n_active = n_waveform_samples;
+    cyclic_shift = 0;
+    shared_buffer = false;
+    n_seq = 1;
+    n_samples = 0;
+    n_waveform_pos = 0;
+    n_waveform_readahead = 0;
+    n_waveform_loops = 0;
+    n_waveform_readaheads = 0;
+    buffs.assign(n_channels, nullptr);
+    
+    print_data_init();
+    local_stats.reset();
+    
+    return 1;
+}
+
+std::vector<void*> get_ringbuffer_tx_pointers(const size_t n_new_samples, size_t &n_samples_max){
+    if(waveform == false){
+        n_samples_max = max_items_per_packet;
+        return get_ringbuffer_tx_pointers(n_new_samples);
     }
     
-    // finally copy all samples into desired buffer
-    // sc16
-    if (n_bytes_per_item == 4){
-        
-        std::vector<int16_t*> buff_s16;
-
-        for(int i=0; i<n_channels; i++){
-            
-            buff_s16.push_back(static_cast<int16_t*>(buffs[i]));
-            
-            for(int j=0; j<n_seq*n_seq_len; j++){                
-                buff_s16[i][2*j] = (int16_t) (SCALE_SC16*seq[i][2*j]);
-                buff_s16[i][2*j+1] = (int16_t) (SCALE_SC16*seq[i][2*j+1]);
+    DBG_RB(local_stats.n_samples_total += n_new_samples;)
+    n_waveform_pos += n_new_samples;
+    if(n_waveform_pos >= n_waveform_samples && waveform_loop){
+        n_waveform_pos = 0;
+        n_waveform_readahead = 0;
+        n_waveform_loops++;
+    }
+    if(n_waveform_pos >= n_waveform_readahead)
+        waveform_readahead();
+    
+    // uhd reads straight from the mapping, a packet never crosses the end of the file
+    n_samples_max = std::min<unsigned long long>(max_items_per_packet, n_waveform_samples - std::min(n_waveform_pos, n_waveform_samples));
+    for (size_t ch = 0; ch < n_channels; ch++)
+        buffs[ch] = static_cast<void*>(waveform_map + waveform_data_offset + (ch*n_waveform_samples + std::min(n_waveform_pos, n_waveform_samples - 1))*n_bytes_per_item);
+    
+    return buffs;
+}
+
+std::vector<void*> get_ringbuffer_tx_pointers_at(const size_t n_new_samples, const long long tick){
+    DBG_RB(local_stats.n_samples_total += n_new_samples;)
+    n_samples = (tick % (long long) n_seq_len + n_seq_len) % n_seq_len;
+
+    set_sequence_pointers();
+    
+    return buffs;
+}
+    
+void get_sequence_identity(std::string &seq_name, unsigned long long &seq_length, unsigned long long &seq_checksum){
+    seq_name = waveform ? "waveform" : get_sequence_type_name(seq_type);
+    seq_length = n_seq_len;
+    seq_checksum = waveform ? 0 : sequence_checksum();
+}
+
+void get_sequence(std::vector<std::vector<std::complex<float>>> &seq){
+    // a waveform is no periodic sequence
+    if(waveform){
+        seq.assign(n_channels, std::vector<std::complex<float>>());
+        return;
+    }
+    seq.assign(n_channels, std::vector<std::complex<float>>(n_seq_len));
+    for(size_t ch = 0; ch < n_channels; ch++){
+        const char* period = channel_buffer[ch] + channel_offset[ch]*n_bytes_per_item;
+        for(size_t j = 0; j < n_seq_len; j++){
+            if(n_bytes_per_item == 4){
+                const int16_t* p = reinterpret_cast<const int16_t*>(period);
+                seq[ch][j] = std::complex<float>(p[2*j], p[2*j + 1]);
+            }
+            else{
+                const float* p = reinterpret_cast<const float*>(period);
+                seq[ch][j] = std::complex<float>(p[2*j], p[2*j + 1]);
             }
         }
     }
-    // fc32
-    else if(n_bytes_per_item == 8){
-        
-        std::vector<float*> buff_f32;
+}
+
+void show_debug_information_ringbuffer_tx(){
+    local_stats.print_data("Ringbuffer TX:");
+    
+    if(waveform){
+        std::cout << "--------------------------" << std::endl;
+        std::cout << "Ringbuffer TX waveform:" << std::endl;
+        std::cout << "file: " << waveform_file << std::endl;
+        std::cout << "n_waveform_samples: " << n_waveform_samples << std::endl;
+        std::cout << "n_waveform_pos: " << n_waveform_pos << std::endl;
+        std::cout << "n_waveform_loops: " << n_waveform_loops << std::endl;
+        std::cout << "n_waveform_readaheads: " << n_waveform_readaheads << std::endl;
+        std::cout << "--------------------------" << std::endl;
+    }
+}
+
+// asks the kernel to read the next pages of each channel in the background and to release the played ones, a system call every WAVEFORM_READAHEAD_BYTES/2
+static void waveform_readahead(){
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const unsigned long long n_samples_ahead = WAVEFORM_READAHEAD_BYTES/n_bytes_per_item;
+    for(size_t ch = 0; ch < n_channels; ch++){
+        const size_t channel_begin = waveform_data_offset + ch*n_waveform_samples*n_bytes_per_item;
+        const size_t channel_end = channel_begin + n_waveform_samples*n_bytes_per_item;
+        const size_t begin = (channel_begin + n_waveform_pos*n_bytes_per_item)/page*page;
+        const size_t end = std::min<size_t>(begin + WAVEFORM_READAHEAD_BYTES, channel_end);
+        if(begin < end)
+            madvise(waveform_map + begin, end - begin, MADV_WILLNEED);
         
-        for(int i=0; i<n_channels; i++){
-            
-            buff_f32.push_back(static_cast<float*>(buffs[i]));
-            
-            for(int j=0; j<n_seq*n_seq_len; j++){
-                buff_f32[i][2*j] = SCALE_FC32*seq[i][2*j];
-                buff_f32[i][2*j+1] = SCALE_FC32*seq[i][2*j+1];
-            }
+        // pages already played, looped files are kept if they were read into memory at once
+        if(waveform_populate == false && n_waveform_pos > n_samples_ahead){
+            const size_t behind = (channel_begin + (n_waveform_pos - n_samples_ahead)*n_bytes_per_item)/page*page;
+            const size_t behind_begin = (channel_begin + page - 1)/page*page;
+            if(behind_begin < behind)
+                madvise(waveform_map + behind_begin, behind - behind_begin, MADV_DONTNEED);
+        }
+    }
+    n_waveform_readahead = n_waveform_pos + n_samples_ahead/2;
+    n_waveform_readaheads++;
+}
+
+// the pointer of each channel advances through its buffer, cyclic shifts start further into the shared one
+static inline void set_sequence_pointers(){
+    for (size_t ch = 0; ch < n_channels; ch++){
+        size_t j = n_samples + channel_offset[ch];
+        if(j >= n_seq_len)
+            j -= n_seq_len;
+        buffs[ch] = static_cast<void*>(channel_buffer[ch] + j*n_bytes_per_item);
+    }
+}
+
+static void quantize(const std::vector<std::complex<float>> &seq, char* out){
+    if(n_bytes_per_item == 4){
+        int16_t* p = reinterpret_cast<int16_t*>(out);
+        for(size_t j = 0; j < n_seq_len; j++){
+            p[2*j] = (int16_t) (SEQ_SCALE_SC16*seq[j].real());
+            p[2*j + 1] = (int16_t) (SEQ_SCALE_SC16*seq[j].imag());
         }
     }
     else{
-        std::cerr << "ringbuffer_tx: Unknown data type." << std::endl;
+        float* p = reinterpret_cast<float*>(out);
+        for(size_t j = 0; j < n_seq_len; j++){
+            p[2*j] = SEQ_SCALE_FC32*seq[j].real();
+            p[2*j + 1] = SEQ_SCALE_FC32*seq[j].imag();
+        }
+    }
+}
+
+// one period is quantized straight into the start of each buffer, the repetitions are copies of it
+// if every channel is found as a cyclic shift of channel 0, all channels read from the buffer of channel 0 at an offset,
+// so the memory streamed to uhd does not grow with the number of channels
+static int generate_sequence(){
+    std::vector<std::vector<std::complex<float>>> seq;
+    if(generate_sequence_period(seq_type, n_seq_len, n_channels, samp_rate, seq_root, seq, n_active, cyclic_shift) == 0)
+        return 0;
+    
+    const size_t n_bytes_per_seq = n_seq_len*n_bytes_per_item;
+    buffs0.clear();
+    buffs0.push_back(buffer_t(n_seq*n_bytes_per_seq));
+    quantize(seq[0], &buffs0[0][0]);
+    for(size_t k = 1; k < n_seq; k++)
+        memcpy(&buffs0[0][k*n_bytes_per_seq], &buffs0[0][0], n_bytes_per_seq);
+    
+    // channel ch transmits channel 0 delayed by ch*cyclic_shift, compared as quantized
+    channel_offset.assign(n_channels, 0);
+    shared_buffer = true;
+    std::vector<char> period(n_bytes_per_seq);
+    for(size_t ch = 1; ch < n_channels && shared_buffer; ch++){
+        channel_offset[ch] = (n_seq_len - (ch*cyclic_shift) % n_seq_len) % n_seq_len;
+        quantize(seq[ch], period.data());
+        shared_buffer = memcmp(period.data(), &buffs0[0][channel_offset[ch]*n_bytes_per_item], n_bytes_per_seq) == 0;
     }
+    
+    channel_buffer.assign(n_channels, &buffs0[0][0]);
+    if(shared_buffer == false){
+        channel_offset.assign(n_channels, 0);
+        for(size_t ch = 1; ch < n_channels; ch++){
+            // create one row for each channel/antenna
+            buffs0.push_back(buffer_t(n_seq*n_bytes_per_seq));
+            quantize(seq[ch], &buffs0[ch][0]);
+            for(size_t k = 1; k < n_seq; k++)
+                memcpy(&buffs0[ch][k*n_bytes_per_seq], &buffs0[ch][0], n_bytes_per_seq);
+        }
+        for(size_t ch = 0; ch < n_channels; ch++)
+            channel_buffer[ch] = &buffs0[ch][0];
+    }
+    
+    buffs.assign(n_channels, nullptr);
+    set_sequence_pointers();
+    
+    return 1;
+}
 
-    // save the sequence
+// header with the metadata, followed by one period per channel as transmitted, see seq_format.h
+static void save_sequence(){
+    seq_file_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SEQ_FILE_MAGIC, sizeof(SEQ_FILE_MAGIC));
+    h.version = SEQ_FILE_VERSION;
+    h.header_bytes = sizeof(h);
+    h.n_channels = n_channels;
+    h.n_bytes_per_item = n_bytes_per_item;
+    strncpy(h.data_type, (n_bytes_per_item == 4) ? "sc16" : "fc32", sizeof(h.data_type) - 1);
+    h.samp_rate = samp_rate;
+    h.seq_length = n_seq_len;
+    h.n_active = n_active;
+    h.cyclic_shift = cyclic_shift;
+    h.type = seq_type;
+    h.seq_root = (seq_type == SEQ_TYPE_ZADOFF_CHU) ? seq_root : 0;
+    h.scale = (n_bytes_per_item == 4) ? SEQ_SCALE_SC16 : SEQ_SCALE_FC32;
+    h.seq_checksum = sequence_checksum();
+    strncpy(h.seq_name, get_sequence_type_name(seq_type), sizeof(h.seq_name) - 1);
+    
     std::string folder_path = SAVE_PATH;
     std::string file_name = "seq";
     std::string full_file_path = folder_path + file_name + ".bin";
     std::ofstream fout(full_file_path, std::ios::out | std::ios::binary);
+    fout.write(reinterpret_cast<const char*>(&h), sizeof(h));
     for(size_t ch = 0; ch < n_channels; ch++)
-        fout.write((char*)&buffs0[ch][0], buffs0[ch].size()*sizeof(buffs0[ch][0]));
-    fout.close();    
+        fout.write(channel_buffer[ch] + channel_offset[ch]*n_bytes_per_item, n_seq_len*n_bytes_per_item);
+    fout.close();
+}
+
+// FNV-1a
+static unsigned long long sequence_checksum(){
+    unsigned long long seq_checksum = 14695981039346656037ULL;
+    for(size_t ch = 0; ch < n_channels; ch++){
+        const char* period = channel_buffer[ch] + channel_offset[ch]*n_bytes_per_item;
+        for(size_t i = 0; i < n_seq_len*n_bytes_per_item; i++){
+            seq_checksum ^= (unsigned char) period[i];
+            seq_checksum *= 1099511628211ULL;
+        }
+    }
+    return seq_checksum;
 }
     
 static void print_data_init(){
     std::cout << "--------------------------" << std::endl;
     std::cout << "Ringbuffer TX start:" << std::endl;
+    if(waveform){
+        std::cout << "waveform: " << waveform_file << std::endl;
+        std::cout << "n_channels: " << n_channels << std::endl;
+        std::cout << "n_bytes_per_item: " << n_bytes_per_item << std::endl;
+        std::cout << "max_items_per_packet: " << max_items_per_packet << std::endl;
+        std::cout << "n_waveform_samples: " << n_waveform_samples << std::endl;
+        std::cout << "loop: " << waveform_loop << std::endl;
+        std::cout << "populate: " << waveform_populate << std::endl;
+        std::cout << "--------------------------" << std::endl;
+        return;
+    }
     std::cout << "n_channels: " << n_channels << std::endl;
     std::cout << "n_bytes_per_item: " << n_bytes_per_item << std::endl;
     std::cout << "max_items_per_packet: " << max_items_per_packet << std::endl;
     std::cout << "samp_rate: " << samp_rate << std::endl;
+    std::cout << "seq_type: " << get_sequence_type_name(seq_type) << std::endl;
     std::cout << "n_seq_len: " << n_seq_len << std::endl;    
+    std::cout << "n_active: " << n_active << std::endl;
+    std::cout << "cyclic_shift: " << cyclic_shift << std::endl;
     std::cout << "n_seq: " << n_seq << std::endl;
+    std::cout << "shared_buffer: " << shared_buffer << std::endl;
     std::cout << "buffs0.size(): " << buffs0.size() << std::endl;
-    for (size_t ch = 0; ch < n_channels; ch++){
+    for (size_t ch = 0; ch < buffs0.size(); ch++){
         std::cout << "buffs0[" << ch << "].size(): " << buffs0[ch].size() << std::endl;
     }
+    for (size_t ch = 0; ch < n_channels; ch++){
+        std::cout << "channel_offset[" << ch << "]: " << channel_offset[ch] << std::endl;
+    }
     std::cout << "n_seq*n_seq_len*n_bytes_per_item: " << n_seq*n_seq_len*n_bytes_per_item << std::endl;
     std::cout << "--------------------------" << std::endl;        
 }
@@ -20,18 +20,44 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <atomic>
+#include <string>
+#include <complex>
+#include <cstdint>
 
 namespace channelsounder
 {
 /*!
  * Inits unit internally. Must be called first.
+ * If the sequences of all channels are cyclic shifts of channel 0, e.g. zadoff-chu, all channels read from one buffer at different offsets.
  *
  * num_channels_arg             in our case this is the number of rx antennas
  * num_bytes_per_item_arg       one item is one complex sample with real and imag, e.g. with data type "float" it is num_bytes_per_item_arg=8
  * max_items_per_packet_arg     depends on what uhd driver does, tries to fully utilize 10Gbit/s bandwidth of ethernet NIC, needed for size of internal static memory
+ * samp_rate_arg                S/s
+ * seq_type_arg                 SEQ_TYPE_SINE_1MHZ etc., see seq_format.h and sequence.h
+ * seq_length_arg               complex samples per period, 0 for the legacy length of SEQ_TYPE_SINE_1MHZ and SEQ_TYPE_ONE_AND_MINUS_ONE
+ * seq_root_arg                 root index of zadoff-chu
  * return                       1 on success and 0 on failure
 */
-int init_ringbuffer_tx(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const size_t max_items_per_packet_arg, const unsigned int samp_rate_arg);
+int init_ringbuffer_tx(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const size_t max_items_per_packet_arg, const unsigned int samp_rate_arg,
+                       const uint32_t seq_type_arg, const size_t seq_length_arg, const unsigned int seq_root_arg);
+
+/*!
+ * Inits unit internally to play a waveform file instead of a generated sequence. Alternative to init_ringbuffer_tx().
+ * The file is mapped and uhd reads directly from the mapping, pages ahead of the play position are read in the background.
+ * Files in the layout of seq.bin (see seq_format.h) are played as described by their header, any other file is taken as raw
+ * samples, all samples of channel 0 followed by all samples of channel 1 etc.
+ *
+ * num_channels_arg             number of tx channels, must match the file
+ * num_bytes_per_item_arg       size of one complex sample, must match the file
+ * max_items_per_packet_arg     maximum number of samples requested by uhd driver
+ * file_name                    waveform to play, on a hugetlbfs mount the mapping uses hugepages
+ * loop_arg                     true to start over at the end of the file, false to stop
+ * populate_arg                 true to read the whole file into memory before playing, e.g. for looped files fitting into RAM
+ * return                       1 on success and 0 on failure
+*/
+int init_ringbuffer_tx_waveform(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const size_t max_items_per_packet_arg,
+                                const std::string &file_name, const bool loop_arg, const bool populate_arg);
 
 /*!
  * Must be called initially with n_new_samples=0.
@@ -41,7 +67,42 @@ int init_ringbuffer_tx(const size_t n_channels_arg, const size_t n_bytes_per_ite
  * return                       vector of pointers pointing to internal static vectors, this is where uhd reads from
 */
 std::vector<void*> get_ringbuffer_tx_pointers(const size_t n_new_samples);
+
+/*!
+ * Like get_ringbuffer_tx_pointers(), but also for waveforms, which end or wrap at the end of the file.
+ *
+ * n_new_samples                number of new samples read per channel to pointers from last call
+ * n_samples_max                set to the number of samples that can be read from the pointers, 0 once a waveform played without loop has ended
+ * return                       vector of pointers pointing to internal static vectors or into the mapped waveform
+*/
+std::vector<void*> get_ringbuffer_tx_pointers(const size_t n_new_samples, size_t &n_samples_max);
+
+/*!
+ * Like get_ringbuffer_tx_pointers(), but the phase of the sequence follows device time, e.g. for timed bursts.
+ * Sample tick%seq_length of the sequence is sent at tick, so it repeats at the same phase in each measurement if the period is a multiple of seq_length.
+ *
+ * n_new_samples                number of new samples read per channel to pointers from last call, only counted
+ * tick                         device time of the next sample to be sent at the tx rate
+ * return                       vector of pointers pointing to internal static vectors, at least max_items_per_packet samples can be read
+*/
+std::vector<void*> get_ringbuffer_tx_pointers_at(const size_t n_new_samples, const long long tick);
     
+/*!
+ * Identity of the transmitted sequence, recorded in the header of measurement files.
+ *
+ * seq_name                     e.g. "zadoff_chu", see get_sequence_type_name(), or "waveform"
+ * seq_length                   length of one period in complex samples, of a waveform its length
+ * seq_checksum                 FNV-1a over one period of all channels as transmitted, 0 for a waveform, it is not read just for this
+*/
+void get_sequence_identity(std::string &seq_name, unsigned long long &seq_length, unsigned long long &seq_checksum);
+
+/*!
+ * One period of the transmitted sequence, e.g. as reference for the cir extraction.
+ *
+ * seq                          set to one vector per tx channel with seq_length samples as transmitted, sc16 converted to float, empty for a waveform
+*/
+void get_sequence(std::vector<std::vector<std::complex<float>>> &seq);
+
 /*!
  * Shows some stats of the ring buffer.
 */    
@@ -0,0 +1,127 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CHANNELSOUNDER_SC16_CODEC_H
+#define CHANNELSOUNDER_SC16_CODEC_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// lossless codec for sc16 windows, used by the saver and by ch_measurement_reader.h
+// each int16 value is coded as the difference to the same value in the previous window of the channel (or to 0 in a keyframe),
+// zigzag mapped and bit-packed in blocks of SC16_CODEC_BLOCK values: [1 byte bit width][SC16_CODEC_BLOCK*width bits]
+#define SC16_CODEC_BLOCK                128     // values per bit-packed block
+#define SC16_CODEC_KEYFRAME_INTERVAL    16      // every n-th window of a channel is coded without reference, random access decodes at most this many windows
+#define SC16_CODEC_MAX_BITS             17      // difference of two int16 needs 17 bits
+
+namespace channelsounder
+{
+// worst case size of one coded window
+inline size_t sc16_codec_max_bytes(const size_t window_length){
+    const size_t n_values = 2*window_length;
+    const size_t n_blocks = (n_values + SC16_CODEC_BLOCK - 1)/SC16_CODEC_BLOCK;
+    return n_blocks*(1 + (SC16_CODEC_BLOCK*SC16_CODEC_MAX_BITS + 7)/8);
+}
+
+/*!
+ * in                           window_length complex samples, real and imag interleaved
+ * ref                          previous window of the same channel, nullptr for a keyframe
+ * out                          at least sc16_codec_max_bytes(window_length) bytes
+ * return                       number of bytes written to out
+*/
+inline size_t sc16_encode_window(const int16_t* in, const int16_t* ref, const size_t window_length, char* out){
+    const size_t n_values = 2*window_length;
+    uint32_t z[SC16_CODEC_BLOCK];
+    unsigned char* p = reinterpret_cast<unsigned char*>(out);
+
+    for(size_t i0 = 0; i0 < n_values; i0 += SC16_CODEC_BLOCK){
+        const size_t n = (n_values - i0 < SC16_CODEC_BLOCK) ? n_values - i0 : SC16_CODEC_BLOCK;
+
+        // difference and zigzag, the or-reduction gives the bit width, vectorized by the compiler
+        uint32_t acc = 0;
+        if(ref != nullptr){
+            for(size_t i = 0; i < n; i++){
+                const int32_t d = (int32_t) in[i0 + i] - (int32_t) ref[i0 + i];
+                z[i] = ((uint32_t) d << 1) ^ (uint32_t) (d >> 31);
+                acc |= z[i];
+            }
+        }
+        else{
+            for(size_t i = 0; i < n; i++){
+                const int32_t d = in[i0 + i];
+                z[i] = ((uint32_t) d << 1) ^ (uint32_t) (d >> 31);
+                acc |= z[i];
+            }
+        }
+        const unsigned int bits = (acc == 0) ? 0 : 32 - __builtin_clz(acc);
+        *p++ = (unsigned char) bits;
+
+        // bit-packing, little endian bit order
+        uint64_t buf = 0;
+        unsigned int n_buf = 0;
+        for(size_t i = 0; i < n; i++){
+            buf |= (uint64_t) z[i] << n_buf;
+            n_buf += bits;
+            while(n_buf >= 8){
+                *p++ = (unsigned char) buf;
+                buf >>= 8;
+                n_buf -= 8;
+            }
+        }
+        if(n_buf > 0)
+            *p++ = (unsigned char) buf;
+    }
+
+    return p - reinterpret_cast<unsigned char*>(out);
+}
+
+/*!
+ * in                           coded window
+ * ref                          previous decoded window of the same channel, nullptr for a keyframe
+ * out                          window_length complex samples
+ * return                       number of bytes read from in
+*/
+inline size_t sc16_decode_window(const char* in, const int16_t* ref, const size_t window_length, int16_t* out){
+    const size_t n_values = 2*window_length;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+
+    for(size_t i0 = 0; i0 < n_values; i0 += SC16_CODEC_BLOCK){
+        const size_t n = (n_values - i0 < SC16_CODEC_BLOCK) ? n_values - i0 : SC16_CODEC_BLOCK;
+        const unsigned int bits = *p++;
+        const uint32_t mask = (bits == 0) ? 0 : (uint32_t) ((1ULL << bits) - 1);
+
+        uint64_t buf = 0;
+        unsigned int n_buf = 0;
+        for(size_t i = 0; i < n; i++){
+            while(n_buf < bits){
+                buf |= (uint64_t) *p++ << n_buf;
+                n_buf += 8;
+            }
+            const uint32_t z = (uint32_t) buf & mask;
+            buf >>= bits;
+            n_buf -= bits;
+
+            const int32_t d = (int32_t) (z >> 1) ^ -(int32_t) (z & 1);
+            out[i0 + i] = (int16_t) (((ref != nullptr) ? ref[i0 + i] : 0) + d);
+        }
+    }
+
+    return p - reinterpret_cast<const unsigned char*>(in);
+}
+}
+
+#endif
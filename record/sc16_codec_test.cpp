@@ -0,0 +1,111 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cstring>
+
+#include "sc16_codec.h"
+
+/***********************************************************************
+ * Round trip of the lossless sc16 codec for every window length up to
+ * MAX_WINDOW_LENGTH, as keyframe and against a reference window, with
+ * random, constant and extreme samples. Coded windows must fit into
+ * sc16_codec_max_bytes(), which is reached exactly in the worst case.
+ **********************************************************************/
+#define MAX_WINDOW_LENGTH       1000
+#define GUARD_BYTES             64
+#define GUARD_VALUE             0x5a
+
+enum pattern_enum{
+    PATTERN_RANDOM,             // full int16 range
+    PATTERN_SMALL,              // small steps to the reference, few bits per value
+    PATTERN_EQUAL,              // identical to the reference, 0 bits per value
+    PATTERN_EXTREME             // -32768 and 32767 alternating, opposite to the reference, 17 bits per value
+};
+
+static void fill(const pattern_enum pattern, std::mt19937 &gen, const std::vector<int16_t> &ref, std::vector<int16_t> &in){
+    std::uniform_int_distribution<int> full(-32768, 32767), small(-3, 3);
+    for(size_t i = 0; i < in.size(); i++){
+        switch(pattern){
+            case PATTERN_RANDOM:    in[i] = (int16_t) full(gen); break;
+            case PATTERN_SMALL:     in[i] = (int16_t) std::max(-32768, std::min(32767, ref[i] + small(gen))); break;
+            case PATTERN_EQUAL:     in[i] = ref[i]; break;
+            case PATTERN_EXTREME:   in[i] = (ref[i] < 0) ? 32767 : -32768; break;
+        }
+    }
+}
+
+static int round_trip(const std::vector<int16_t> &in, const int16_t* ref, const size_t window_length){
+    const size_t max_bytes = channelsounder::sc16_codec_max_bytes(window_length);
+    std::vector<char> coded(max_bytes + GUARD_BYTES, GUARD_VALUE);
+    std::vector<int16_t> out(2*window_length);
+
+    const size_t n_written = channelsounder::sc16_encode_window(&in[0], ref, window_length, &coded[0]);
+    const size_t n_read = channelsounder::sc16_decode_window(&coded[0], ref, window_length, &out[0]);
+
+    if(n_written > max_bytes || coded[max_bytes] != GUARD_VALUE){
+        std::cerr << "window length " << window_length << ": " << n_written << " bytes coded, at most " << max_bytes << " expected" << std::endl;
+        return 0;
+    }
+    if(n_read != n_written){
+        std::cerr << "window length " << window_length << ": " << n_written << " bytes coded but " << n_read << " bytes decoded" << std::endl;
+        return 0;
+    }
+    if(memcmp(&in[0], &out[0], in.size()*sizeof(int16_t)) != 0){
+        std::cerr << "window length " << window_length << ": decoded window differs" << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+int main()
+{
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> full(-32768, 32767);
+    const pattern_enum patterns[] = {PATTERN_RANDOM, PATTERN_SMALL, PATTERN_EQUAL, PATTERN_EXTREME};
+
+    for(size_t window_length = 1; window_length <= MAX_WINDOW_LENGTH; window_length++){
+        std::vector<int16_t> ref(2*window_length), in(2*window_length);
+        for(size_t i = 0; i < ref.size(); i++)
+            ref[i] = (i % 7 == 0) ? ((i % 2) ? 32767 : -32768) : (int16_t) full(gen);
+
+        for(size_t p = 0; p < sizeof(patterns)/sizeof(patterns[0]); p++){
+            fill(patterns[p], gen, ref, in);
+            if (not round_trip(in, nullptr, window_length) or not round_trip(in, &ref[0], window_length)) {
+                std::cerr << "FAILED for pattern " << p << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // the worst case of full blocks is exactly the bound
+    const size_t window_length = 4*SC16_CODEC_BLOCK;
+    std::vector<int16_t> ref(2*window_length), in(2*window_length);
+    for(size_t i = 0; i < ref.size(); i++){
+        ref[i] = (i % 2) ? 32767 : -32768;
+        in[i] = (i % 2) ? -32768 : 32767;
+    }
+    std::vector<char> coded(channelsounder::sc16_codec_max_bytes(window_length));
+    if(channelsounder::sc16_encode_window(&in[0], &ref[0], window_length, &coded[0]) != coded.size()){
+        std::cerr << "FAILED, worst case does not reach sc16_codec_max_bytes()" << std::endl;
+        return 1;
+    }
+
+    std::cout << "sc16 codec round trip passed for window lengths 1 to " << MAX_WINDOW_LENGTH << std::endl;
+    return 0;
+}
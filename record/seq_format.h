@@ -0,0 +1,65 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_SEQ_FORMAT_H
+#define CHANNELSOUNDER_SEQ_FORMAT_H
+
+#include <cstdint>
+
+// layout of seq.bin, all values little endian:
+// [seq_file_header][channel 0][channel 1]..., each channel holds one period of seq_length complex samples of data_type as transmitted
+// the first n_active samples of a period carry the sequence, the rest is zero
+#define SEQ_FILE_MAGIC                  "CHSEQ"
+#define SEQ_FILE_VERSION                1
+
+// sample value of a chip with magnitude 1 as transmitted, stored as scale in the header
+#define SEQ_SCALE_SC16                  4096.0f
+#define SEQ_SCALE_FC32                  0.5f
+
+// types of sequences, see sequence.h
+#define SEQ_TYPE_SINE_1MHZ              0           // complex sine of (ch + 1) MHz
+#define SEQ_TYPE_ONE_AND_MINUS_ONE      1           // random +-1 +-1j
+#define SEQ_TYPE_ZADOFF_CHU             2           // zadoff-chu of root seq_root, one cyclic shift per channel
+#define SEQ_TYPE_M_SEQUENCE             3           // maximum length sequence of 2^m - 1 chips, one cyclic shift per channel
+#define SEQ_TYPE_GOLAY                  4           // complementary pair [a b] of 2^k chips each, one cyclic shift of a and b per channel
+
+namespace channelsounder
+{
+struct seq_file_header{
+    char magic[8];                      // SEQ_FILE_MAGIC
+    uint32_t version;                   // SEQ_FILE_VERSION
+    uint32_t header_bytes;              // offset of channel 0
+    uint32_t n_channels;                // number of tx channels
+    uint32_t n_bytes_per_item;          // size of one complex sample
+    char data_type[8];                  // "sc16" or "fc32"
+    uint64_t samp_rate;                 // S/s
+    uint64_t seq_length;                // complex samples per period and channel
+    uint64_t n_active;                  // samples at the start of each period carrying the sequence
+    uint64_t cyclic_shift;              // channel c is channel 0 delayed cyclically by c*cyclic_shift samples, for golay within a and b separately, 0 if unrelated
+    uint32_t type;                      // SEQ_TYPE_SINE_1MHZ etc.
+    uint32_t seq_root;                  // zadoff-chu: root index
+    float scale;                        // sample value of a chip with magnitude 1
+    uint32_t reserved0;
+    uint64_t seq_checksum;              // FNV-1a over one period of all channels as transmitted, as in the measurement files
+    char seq_name[32];                  // e.g. "zadoff_chu"
+    char reserved[136];                 // zero, for future use
+};
+
+static_assert(sizeof(seq_file_header) == 256, "seq file header layout changed");
+}
+
+#endif
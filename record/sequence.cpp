@@ -0,0 +1,289 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstring>
+
+#include "sequence.h"
+#include "seq_format.h"
+
+// degrees of the m-sequences, 2^m - 1 chips
+#define SEQ_M_DEGREE_MIN    2
+#define SEQ_M_DEGREE_MAX    24
+
+namespace channelsounder
+{
+// feedback taps of a primitive polynomial per degree, bit t-1 is set for x^t, used in galois form
+static const uint32_t m_taps[SEQ_M_DEGREE_MAX + 1] = {
+    0, 0,
+    (1u<<1)|(1u<<0),                                // 2: x^2 + x + 1
+    (1u<<2)|(1u<<1),                                // 3
+    (1u<<3)|(1u<<2),                                // 4
+    (1u<<4)|(1u<<2),                                // 5
+    (1u<<5)|(1u<<4),                                // 6
+    (1u<<6)|(1u<<5),                                // 7
+    (1u<<7)|(1u<<5)|(1u<<4)|(1u<<3),                // 8
+    (1u<<8)|(1u<<4),                                // 9
+    (1u<<9)|(1u<<6),                                // 10
+    (1u<<10)|(1u<<8),                               // 11
+    (1u<<11)|(1u<<5)|(1u<<3)|(1u<<0),               // 12
+    (1u<<12)|(1u<<3)|(1u<<2)|(1u<<0),               // 13
+    (1u<<13)|(1u<<4)|(1u<<2)|(1u<<0),               // 14
+    (1u<<14)|(1u<<13),                              // 15
+    (1u<<15)|(1u<<14)|(1u<<12)|(1u<<3),             // 16
+    (1u<<16)|(1u<<13),                              // 17
+    (1u<<17)|(1u<<10),                              // 18
+    (1u<<18)|(1u<<5)|(1u<<1)|(1u<<0),               // 19
+    (1u<<19)|(1u<<16),                              // 20
+    (1u<<20)|(1u<<18),                              // 21
+    (1u<<21)|(1u<<20),                              // 22
+    (1u<<22)|(1u<<17),                              // 23
+    (1u<<23)|(1u<<22)|(1u<<21)|(1u<<16)             // 24
+};
+
+static void sine(const size_t seq_length, const size_t ch, const unsigned int samp_rate, std::vector<std::complex<float>> &out);
+static void one_and_minus_one(const size_t seq_length, const size_t ch, std::vector<std::complex<float>> &out);
+static void zadoff_chu(const size_t seq_length, const unsigned int seq_root, std::vector<std::complex<float>> &out);
+static void m_sequence(const unsigned int degree, std::vector<std::complex<float>> &out);
+static void golay(const size_t n_chips, std::vector<std::complex<float>> &a, std::vector<std::complex<float>> &b);
+static void place_shifted(const std::vector<std::complex<float>> &root, const size_t shift, std::complex<float>* out);
+static unsigned long long gcd(unsigned long long a, unsigned long long b);
+
+int parse_sequence_type(const std::string &str, uint32_t &type){
+    if(str == "sine_1mhz")
+        type = SEQ_TYPE_SINE_1MHZ;
+    else if(str == "one_and_minus_one")
+        type = SEQ_TYPE_ONE_AND_MINUS_ONE;
+    else if(str == "zadoff_chu")
+        type = SEQ_TYPE_ZADOFF_CHU;
+    else if(str == "m_sequence")
+        type = SEQ_TYPE_M_SEQUENCE;
+    else if(str == "golay")
+        type = SEQ_TYPE_GOLAY;
+    else
+        return 0;
+    return 1;
+}
+
+const char* get_sequence_type_name(const uint32_t type){
+    switch(type){
+        case SEQ_TYPE_SINE_1MHZ:            return "sine_1mhz";
+        case SEQ_TYPE_ONE_AND_MINUS_ONE:    return "one_and_minus_one";
+        case SEQ_TYPE_ZADOFF_CHU:           return "zadoff_chu";
+        case SEQ_TYPE_M_SEQUENCE:           return "m_sequence";
+        case SEQ_TYPE_GOLAY:                return "golay";
+        default:                            return "unknown";
+    }
+}
+
+size_t get_matching_sequence_length(const unsigned long long n_samples_per_period, const size_t max_length){
+    for(size_t len = std::min<unsigned long long>(max_length, n_samples_per_period); len > 1; len--){
+        if(n_samples_per_period % len == 0)
+            return len;
+    }
+    return 1;
+}
+
+int generate_sequence_period(const uint32_t type, const size_t seq_length, const size_t n_channels, const unsigned int samp_rate, const unsigned int seq_root,
+                             std::vector<std::vector<std::complex<float>>> &seq, size_t &n_active, size_t &cyclic_shift){
+    if(seq_length == 0 || n_channels == 0){
+        std::cerr << "sequence: length and number of channels must be larger than 0." << std::endl;
+        return 0;
+    }
+    seq.assign(n_channels, std::vector<std::complex<float>>(seq_length, std::complex<float>(0.0f, 0.0f)));
+    n_active = seq_length;
+    cyclic_shift = 0;
+    
+    switch(type){
+        case SEQ_TYPE_SINE_1MHZ:
+            for(size_t ch = 0; ch < n_channels; ch++)
+                sine(seq_length, ch, samp_rate, seq[ch]);
+            return 1;
+        
+        case SEQ_TYPE_ONE_AND_MINUS_ONE:
+            for(size_t ch = 0; ch < n_channels; ch++)
+                one_and_minus_one(seq_length, ch, seq[ch]);
+            return 1;
+        
+        // constant amplitude and ideal periodic autocorrelation for any length, cyclic shifts of one root are orthogonal
+        case SEQ_TYPE_ZADOFF_CHU:
+        {
+            if(seq_root == 0 || seq_root >= seq_length || gcd(seq_root, seq_length) != 1){
+                std::cerr << "sequence: zadoff-chu root " << seq_root << " must be coprime to and smaller than the length " << seq_length << "." << std::endl;
+                return 0;
+            }
+            std::vector<std::complex<float>> root;
+            zadoff_chu(seq_length, seq_root, root);
+            cyclic_shift = seq_length/n_channels;
+            for(size_t ch = 0; ch < n_channels; ch++)
+                place_shifted(root, ch*cyclic_shift, &seq[ch][0]);
+            return 1;
+        }
+        
+        // periodic autocorrelation of -1 outside the peak
+        case SEQ_TYPE_M_SEQUENCE:
+        {
+            unsigned int degree = SEQ_M_DEGREE_MIN;
+            while(degree < SEQ_M_DEGREE_MAX && (2ULL << degree) - 1 <= seq_length)
+                degree++;
+            if((1ULL << degree) - 1 > seq_length){
+                std::cerr << "sequence: an m-sequence needs at least " << (1u << SEQ_M_DEGREE_MIN) - 1 << " samples." << std::endl;
+                return 0;
+            }
+            std::vector<std::complex<float>> root;
+            m_sequence(degree, root);
+            n_active = root.size();
+            cyclic_shift = n_active/n_channels;
+            for(size_t ch = 0; ch < n_channels; ch++)
+                place_shifted(root, ch*cyclic_shift, &seq[ch][0]);
+            return 1;
+        }
+        
+        // the autocorrelations of a and b add up to a single peak only if a and b are correlated separately and summed, e.g. offline,
+        // a and b are sent back to back without guard, so any correlation of the whole period keeps the a/b cross terms and --cir_taps rejects golay
+        case SEQ_TYPE_GOLAY:
+        {
+            if(seq_length < 2){
+                std::cerr << "sequence: a golay pair needs at least 2 samples." << std::endl;
+                return 0;
+            }
+            size_t n_chips = 1;
+            while(4*n_chips <= seq_length)
+                n_chips *= 2;
+            std::vector<std::complex<float>> a, b;
+            golay(n_chips, a, b);
+            n_active = 2*n_chips;
+            cyclic_shift = n_chips/n_channels;
+            for(size_t ch = 0; ch < n_channels; ch++){
+                place_shifted(a, ch*cyclic_shift, &seq[ch][0]);
+                place_shifted(b, ch*cyclic_shift, &seq[ch][n_chips]);
+            }
+            return 1;
+        }
+        
+        default:
+            std::cerr << "sequence: unknown type " << type << "." << std::endl;
+            return 0;
+    }
+}
+
+int parse_sequence_file(const char* data, const unsigned long long n_bytes, const size_t n_channels, const size_t n_bytes_per_item, const std::string &file_name,
+                        size_t &data_offset, unsigned long long &n_samples, unsigned long long &samp_rate){
+    const seq_file_header &h = *reinterpret_cast<const seq_file_header*>(data);
+    if(n_bytes >= sizeof(seq_file_header) && memcmp(h.magic, SEQ_FILE_MAGIC, sizeof(SEQ_FILE_MAGIC)) == 0){
+        if(h.n_channels != n_channels || h.n_bytes_per_item != n_bytes_per_item || h.header_bytes + h.seq_length*n_channels*n_bytes_per_item > n_bytes){
+            std::cerr << "sequence: " << file_name << " holds " << h.n_channels << " channels of " << h.data_type << ", expected " << n_channels << " channels of " << n_bytes_per_item << " bytes." << std::endl;
+            return 0;
+        }
+        data_offset = h.header_bytes;
+        n_samples = h.seq_length;
+        samp_rate = h.samp_rate;
+    }
+    else{
+        if(n_bytes % (n_channels*n_bytes_per_item) != 0){
+            std::cerr << "sequence: size of " << file_name << " is not a multiple of " << n_channels << " channels of " << n_bytes_per_item << " bytes." << std::endl;
+            return 0;
+        }
+        data_offset = 0;
+        n_samples = n_bytes/(n_channels*n_bytes_per_item);
+        samp_rate = 0;
+    }
+    return 1;
+}
+
+// a different frequency for each channel
+static void sine(const size_t seq_length, const size_t ch, const unsigned int samp_rate, std::vector<std::complex<float>> &out){
+    const double f = 1e6 + 1e6 * (double) ch;
+    for(size_t j = 0; j < seq_length; j++){
+        const double t = (double) j/samp_rate;
+        out[j] = std::complex<float>(cos(2.0*M_PI*f*t), sin(2.0*M_PI*f*t));
+    }
+}
+
+// seeded per channel, so the sequence is the same in every run
+static void one_and_minus_one(const size_t seq_length, const size_t ch, std::vector<std::complex<float>> &out){
+    std::minstd_rand gen(ch + 1);
+    for(size_t j = 0; j < seq_length; j++){
+        const float real = 2.0f*(gen() % 2) - 1.0f;
+        const float imag = 2.0f*(gen() % 2) - 1.0f;
+        out[j] = std::complex<float>(real, imag);
+    }
+}
+
+// x[n] = exp(-j pi u n (n + L%2)/L), the phase is reduced modulo 2L in integers, so long sequences keep their precision
+static void zadoff_chu(const size_t seq_length, const unsigned int seq_root, std::vector<std::complex<float>> &out){
+    const unsigned long long L = seq_length;
+    const unsigned long long cf = L % 2;
+    out.resize(L);
+    for(unsigned long long n = 0; n < L; n++){
+        const unsigned long long k = (seq_root * ((n * (n + cf)) % (2*L))) % (2*L);
+        const double phase = -M_PI*(double) k/(double) L;
+        out[n] = std::complex<float>(cos(phase), sin(phase));
+    }
+}
+
+// chips on the diagonal of the complex plane, magnitude 1
+static void m_sequence(const unsigned int degree, std::vector<std::complex<float>> &out){
+    const float c = (float) M_SQRT1_2;
+    const size_t n_chips = (1u << degree) - 1;
+    uint32_t state = 1;
+    out.resize(n_chips);
+    for(size_t n = 0; n < n_chips; n++){
+        const uint32_t bit = state & 1u;
+        state >>= 1;
+        if(bit)
+            state ^= m_taps[degree];
+        out[n] = bit ? std::complex<float>(-c, -c) : std::complex<float>(c, c);
+    }
+}
+
+// a' = [a b], b' = [a -b], chips on the diagonal of the complex plane
+static void golay(const size_t n_chips, std::vector<std::complex<float>> &a, std::vector<std::complex<float>> &b){
+    const float c = (float) M_SQRT1_2;
+    a.assign(1, std::complex<float>(c, c));
+    b.assign(1, std::complex<float>(c, c));
+    while(a.size() < n_chips){
+        const size_t n = a.size();
+        std::vector<std::complex<float>> a_next(2*n), b_next(2*n);
+        for(size_t i = 0; i < n; i++){
+            a_next[i] = a[i];
+            a_next[n + i] = b[i];
+            b_next[i] = a[i];
+            b_next[n + i] = -b[i];
+        }
+        a.swap(a_next);
+        b.swap(b_next);
+    }
+}
+
+// out[n] = root[n - shift], cyclic within the root
+static void place_shifted(const std::vector<std::complex<float>> &root, const size_t shift, std::complex<float>* out){
+    const size_t n = root.size();
+    for(size_t i = 0; i < n; i++)
+        out[(i + shift) % n] = root[i];
+}
+
+static unsigned long long gcd(unsigned long long a, unsigned long long b){
+    while(b != 0){
+        const unsigned long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+}
@@ -0,0 +1,90 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_SEQUENCE_H
+#define CHANNELSOUNDER_SEQUENCE_H
+
+#include <vector>
+#include <string>
+#include <complex>
+#include <cstdint>
+#include <cstddef>
+
+namespace channelsounder
+{
+/*!
+ * Converts a command line string to a type of sequence.
+ *
+ * str                          "sine_1mhz", "one_and_minus_one", "zadoff_chu", "m_sequence" or "golay"
+ * type                         set on success to SEQ_TYPE_SINE_1MHZ etc., see seq_format.h
+ * return                       1 on success and 0 on failure
+*/
+int parse_sequence_type(const std::string &str, uint32_t &type);
+
+/*!
+ * type                         SEQ_TYPE_SINE_1MHZ etc.
+ * return                       name as accepted by parse_sequence_type()
+*/
+const char* get_sequence_type_name(const uint32_t type);
+
+/*!
+ * Length of a sequence repeating at the same phase in every measurement, a whole period fits into a measurement window.
+ *
+ * n_samples_per_period         number of complex samples between the start of two measurements
+ * max_length                   upper limit, e.g. the measurement length
+ * return                       largest divisor of n_samples_per_period not exceeding max_length
+*/
+size_t get_matching_sequence_length(const unsigned long long n_samples_per_period, const size_t max_length);
+
+/*!
+ * Generates one period of the sequence of each tx channel with chips of magnitude 1.
+ * Zadoff-chu, m-sequences and golay pairs are cyclically shifted by seq_length/n_channels (n_active/n_channels) per channel,
+ * so the impulse responses of all tx channels appear side by side in a single correlation.
+ * M-sequences and golay pairs take the longest length fitting into seq_length, the rest of the period is zero.
+ *
+ * type                         SEQ_TYPE_SINE_1MHZ etc.
+ * seq_length                   complex samples per period
+ * n_channels                   number of tx channels
+ * samp_rate                    S/s, sets the frequency of SEQ_TYPE_SINE_1MHZ
+ * seq_root                     root index of zadoff-chu, coprime to seq_length
+ * seq                          set to one vector of seq_length samples per channel
+ * n_active                     set to the number of samples at the start of each period carrying the sequence
+ * cyclic_shift                 set to the shift between two neighbouring channels, 0 if unrelated
+ * return                       1 on success and 0 on failure, e.g. if seq_length is too short for the type
+*/
+int generate_sequence_period(const uint32_t type, const size_t seq_length, const size_t n_channels, const unsigned int samp_rate, const unsigned int seq_root,
+                             std::vector<std::vector<std::complex<float>>> &seq, size_t &n_active, size_t &cyclic_shift);
+
+/*!
+ * Locates the samples of a waveform file, either a seq.bin with seq_file_header or raw samples without header.
+ * The samples of each channel follow those of the previous channel.
+ *
+ * data                         start of the file in memory
+ * n_bytes                      size of the file
+ * n_channels                   number of channels expected
+ * n_bytes_per_item             bytes per complex sample expected, 4 for sc16 and 8 for fc32
+ * file_name                    used in error messages
+ * data_offset                  set to the bytes in front of channel 0
+ * n_samples                    set to the complex samples per channel
+ * samp_rate                    set to the S/s of the header, 0 for raw samples
+ * return                       1 on success and 0 if the file does not match n_channels and n_bytes_per_item
+*/
+int parse_sequence_file(const char* data, const unsigned long long n_bytes, const size_t n_channels, const size_t n_bytes_per_item, const std::string &file_name,
+                        size_t &data_offset, unsigned long long &n_samples, unsigned long long &samp_rate);
+}
+
+#endif
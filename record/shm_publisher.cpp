@@ -0,0 +1,155 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "shm_publisher.h"
+#include "shm_ring_format.h"
+#include "storage_format.h"
+
+namespace channelsounder
+{
+// one ring per rx pipeline, only touched by the thread calling publish_window()
+struct shm_unit{
+    std::string name;
+    shm_ring_header* header;
+    char* slots;
+    size_t n_bytes;
+    unsigned long long n_published;
+};
+static shm_unit units[MAX_PIPELINES];
+
+static std::string name_prefix;
+static size_t n_slots;
+
+int init_shm_publisher(const std::string &name_prefix_arg, const size_t n_slots_arg){
+    name_prefix = name_prefix_arg;
+    n_slots = n_slots_arg;
+
+    if(name_prefix.empty() == false && n_slots == 0){
+        std::cerr << "shm_publisher: the ring needs at least one slot." << std::endl;
+        return 0;
+    }
+
+    return 1;
+}
+
+bool is_shm_publisher_enabled(){
+    return name_prefix.empty() == false;
+}
+
+int create_shm_ring(const size_t n_channels, const size_t n_bytes_per_item, const size_t n_bytes_per_window, const uint32_t storage_format,
+                    const unsigned int samp_rate, const unsigned int n_samples_per_period, const unsigned int measurement_length, const size_t id){
+    shm_unit &u = units[id];
+    u.name = name_prefix + std::to_string(id);
+
+    const size_t header_bytes = (sizeof(shm_ring_header) + SHM_RING_ALIGNMENT - 1)/SHM_RING_ALIGNMENT*SHM_RING_ALIGNMENT;
+    const size_t slot_bytes = (sizeof(shm_slot_header) + n_channels*n_bytes_per_window + SHM_RING_ALIGNMENT - 1)/SHM_RING_ALIGNMENT*SHM_RING_ALIGNMENT;
+    u.n_bytes = header_bytes + n_slots*slot_bytes;
+
+    // readers still attached to an old ring keep their mapping, new readers get the new ring
+    shm_unlink(u.name.c_str());
+    const int fd = shm_open(u.name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0){
+        std::cerr << "shm_publisher: could not create " << u.name << ": " << strerror(errno) << std::endl;
+        return 0;
+    }
+    if(ftruncate(fd, u.n_bytes) != 0){
+        std::cerr << "shm_publisher: could not resize " << u.name << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return 0;
+    }
+    void* p = mmap(nullptr, u.n_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED){
+        std::cerr << "shm_publisher: could not map " << u.name << ": " << strerror(errno) << std::endl;
+        return 0;
+    }
+
+    // pre-fault, the first pass over the ring must not page fault in the rx thread
+    memset(p, 0, u.n_bytes);
+
+    u.header = static_cast<shm_ring_header*>(p);
+    u.slots = static_cast<char*>(p) + header_bytes;
+    u.n_published = 0;
+
+    shm_ring_header &h = *u.header;
+    h.version = SHM_RING_VERSION;
+    h.header_bytes = header_bytes;
+    h.slot_bytes = slot_bytes;
+    h.n_slots = n_slots;
+    h.n_channels = n_channels;
+    h.n_bytes_per_item = n_bytes_per_item;
+    h.n_bytes_per_window = n_bytes_per_window;
+    strncpy(h.data_type, get_storage_data_type(storage_format, n_bytes_per_item), sizeof(h.data_type) - 1);
+    h.storage_format = storage_format;
+    h.storage_scale = get_storage_scale(storage_format, n_bytes_per_item);
+    h.samp_rate = samp_rate;
+    h.n_samples_per_period = n_samples_per_period;
+    h.measurement_length = measurement_length;
+    h.writer_pid = getpid();
+
+    // readers check the magic first
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(h.magic, SHM_RING_MAGIC, sizeof(SHM_RING_MAGIC));
+
+    return 1;
+}
+
+void publish_window(const std::vector<const char*> &windows, const unsigned long long measurement, const long long tick, const uint32_t flags, const size_t id){
+    shm_unit &u = units[id];
+    const shm_ring_header &h = *u.header;
+    const uint64_t s = u.n_published;
+    shm_slot_header &slot = *reinterpret_cast<shm_slot_header*>(u.slots + (s % h.n_slots)*h.slot_bytes);
+
+    // seqlock, readers detect a slot being overwritten by an odd or newer seq
+    __atomic_store_n(&slot.seq, 2*s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot.measurement = measurement;
+    slot.tick = tick;
+    slot.publish_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    slot.flags = flags;
+    char* data = reinterpret_cast<char*>(&slot) + sizeof(shm_slot_header);
+    for(size_t ch = 0; ch < windows.size(); ch++)
+        memcpy(data + ch*h.n_bytes_per_window, windows[ch], h.n_bytes_per_window);
+
+    __atomic_store_n(&slot.seq, 2*s + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&u.header->write_seq, s + 1, __ATOMIC_RELEASE);
+    u.n_published++;
+}
+
+void show_debug_information_shm_publisher(const size_t id){
+    const shm_unit &u = units[id];
+    if(u.header == nullptr)
+        return;
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Shared memory ring " << id << ":" << std::endl;
+    std::cout << "name: " << u.name << std::endl;
+    std::cout << "n_bytes: " << u.n_bytes << std::endl;
+    std::cout << "n_slots: " << u.header->n_slots << std::endl;
+    std::cout << "n_published: " << u.n_published << std::endl;
+    std::cout << "--------------------------" << std::endl;
+}
+}
@@ -0,0 +1,73 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CHANNELSOUNDER_SHM_PUBLISHER_H
+#define CHANNELSOUNDER_SHM_PUBLISHER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace channelsounder
+{
+/*!
+ * Inits unit internally. Must be called before the first fifo is initialized.
+ *
+ * name_prefix_arg              shared memory objects are named <name_prefix_arg><id>, e.g. "/channelsounder_", empty to disable publishing
+ * n_slots_arg                  windows kept in each ring, readers lagging more than this many windows lose windows
+ * return                       1 on success and 0 on failure
+*/
+int init_shm_publisher(const std::string &name_prefix_arg, const size_t n_slots_arg);
+
+/*!
+ * return                       true if init_shm_publisher() was called with a name
+*/
+bool is_shm_publisher_enabled();
+
+/*!
+ * Creates the ring of one pipeline, an existing ring of the same name is replaced. Layout see shm_ring_format.h.
+ *
+ * n_channels                   number of channels
+ * n_bytes_per_item             size of a native complex sample
+ * n_bytes_per_window           bytes of one window of one channel in the storage format
+ * storage_format               CH_MEASUREMENT_STORAGE_NATIVE etc.
+ * samp_rate                    S/s
+ * n_samples_per_period         number of complex samples between the start of two measurements
+ * measurement_length           number of complex samples per measurement
+ * id                           pipeline
+ * return                       1 on success and 0 on failure
+*/
+int create_shm_ring(const size_t n_channels, const size_t n_bytes_per_item, const size_t n_bytes_per_window, const uint32_t storage_format,
+                    const unsigned int samp_rate, const unsigned int n_samples_per_period, const unsigned int measurement_length, const size_t id);
+
+/*!
+ * Copies one window of all channels into the next slot, never waits for readers.
+ *
+ * windows                      one pointer per channel to n_bytes_per_window bytes
+ * measurement                  absolute number of the measurement in device time
+ * tick                         device time of the first sample
+ * flags                        CH_MEASUREMENT_COMPLETE etc.
+ * id                           pipeline
+*/
+void publish_window(const std::vector<const char*> &windows, const unsigned long long measurement, const long long tick, const uint32_t flags, const size_t id);
+
+/*!
+ * Shows some stats of the ring, e.g. number of published windows.
+*/
+void show_debug_information_shm_publisher(const size_t id);
+}
+ 
+#endif
@@ -0,0 +1,143 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+// reference reader of the shared memory ring, tails the windows of one pipeline and reports rate, lag and latency once per second
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "shm_ring_reader.h"
+#include "ch_measurement_format.h"
+
+namespace po = boost::program_options;
+
+// without new windows for this long we check if the recorder has restarted with a new ring
+#define REOPEN_TIMEOUT_MS   2000
+
+static long long now_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// mean power of one window, read in place
+static double window_power(const channelsounder::shm_ring_header &h, const char* w){
+    double power = 0.0;
+    if(h.storage_format != CH_MEASUREMENT_STORAGE_NATIVE)
+        return 0.0;
+    for(size_t i = 0; i < 2*h.measurement_length; i++){
+        const double v = (h.n_bytes_per_item == 4) ? reinterpret_cast<const int16_t*>(w)[i] : reinterpret_cast<const float*>(w)[i];
+        power += v*v;
+    }
+    return power/h.measurement_length;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string name;
+    double duration;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "help message")
+        ("name", po::value<std::string>(&name)->default_value("/channelsounder_0"), "shared memory ring, <shm_name><pipeline> of channelsounder")
+        ("duration", po::value<double>(&duration)->default_value(0), "seconds to run, 0 to run until interrupted")
+    ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+    if (vm.count("help")) {
+        std::cout << "channelsounder shared memory reader " << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    channelsounder::shm_ring_reader r;
+    while (not r.open(name))
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    std::cout << "Attached to " << name << ", " << r.header().n_channels << " channels, " << r.header().data_type << ", " << r.header().n_slots << " slots" << std::endl;
+
+    // start with the next window
+    uint64_t next = r.write_seq();
+
+    const long long t_start = now_ns();
+    long long t_report = t_start;
+    long long t_last_window = t_start;
+    unsigned long long n_read = 0, n_lost = 0, n_torn = 0, n_incomplete = 0;
+    long long latency_sum_ns = 0, latency_max_ns = 0;
+    double power = 0.0;
+
+    while (duration <= 0 or now_ns() - t_start < duration*1e9) {
+        uint64_t token;
+        const int state = r.begin_read(next, token);
+
+        if (state == channelsounder::SHM_WINDOW_NOT_YET) {
+            // a new ring starts at window 0
+            if (now_ns() - t_last_window > REOPEN_TIMEOUT_MS*1000000LL) {
+                if (r.replaced(name) and r.open(name)) {
+                    std::cout << "Attached to new ring " << name << std::endl;
+                    next = 0;
+                }
+                t_last_window = now_ns();
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        // we are more than a ring behind, continue with the oldest window that is not about to be overwritten
+        else if (state == channelsounder::SHM_WINDOW_OVERWRITTEN) {
+            const uint64_t w = r.write_seq();
+            const uint64_t resume = w - std::min<uint64_t>(w, r.header().n_slots/2);
+            n_lost += std::max(resume, next + 1) - next;
+            next = std::max(resume, next + 1);
+        }
+        else {
+            const channelsounder::shm_slot_header &slot = r.slot(next);
+            const long long publish_time_ns = slot.publish_time_ns;
+            const uint32_t flags = slot.flags;
+            const double p = window_power(r.header(), r.window(next, 0));
+
+            // the writer overtook us while we were reading, the values are garbage
+            if (not r.end_read(next, token)) {
+                n_torn++;
+                n_lost++;
+            }
+            else {
+                const long long latency = now_ns() - publish_time_ns;
+                latency_sum_ns += latency;
+                latency_max_ns = std::max(latency_max_ns, latency);
+                if ((flags & CH_MEASUREMENT_COMPLETE) == 0)
+                    n_incomplete++;
+                power = p;
+                n_read++;
+            }
+            next++;
+            t_last_window = now_ns();
+        }
+
+        const long long t = now_ns();
+        if (t - t_report >= 1000000000LL) {
+            const double sec = (t - t_report)*1e-9;
+            std::cout << "measurements/s: " << n_read/sec
+                      << "  lag: " << r.write_seq() - next << " windows"
+                      << "  latency avg/max us: " << (n_read > 0 ? latency_sum_ns/n_read/1000 : 0) << "/" << latency_max_ns/1000
+                      << "  lost: " << n_lost << "  torn: " << n_torn << "  incomplete: " << n_incomplete
+                      << "  power ch0: " << power << std::endl;
+            t_report = t;
+            n_read = n_lost = n_torn = n_incomplete = 0;
+            latency_sum_ns = latency_max_ns = 0;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CHANNELSOUNDER_SHM_RING_FORMAT_H
+#define CHANNELSOUNDER_SHM_RING_FORMAT_H
+
+#include <cstdint>
+
+// layout of the shared memory ring /dev/shm/<name><pipeline id>, all values little endian:
+// [shm_ring_header][slot 0][slot 1]...[slot n_slots - 1], slot i starts at header_bytes + i*slot_bytes
+// slot:    [shm_slot_header][channel 0 window][channel 1 window]..., each window has n_bytes_per_window bytes in the storage format of data_type
+//
+// window number s (counted from 0 since the recorder started) is written to slot s % n_slots, the writer never waits for readers:
+//   writer:  slot.seq = 2s + 1, release fence, header and samples, slot.seq = 2s + 2 (release), write_seq = s + 1 (release)
+//   reader:  seq1 = slot.seq (acquire), seq1 == 2s + 2 means window s is in the slot, smaller means not yet written, larger means overwritten
+//            read samples in place, acquire fence, seq2 = slot.seq, the samples were valid if seq2 == seq1
+// see shm_ring_reader.h
+#define SHM_RING_MAGIC          "CHSHMRG"
+#define SHM_RING_VERSION        1
+#define SHM_RING_ALIGNMENT      64          // header_bytes and slot_bytes are multiples of a cache line
+
+namespace channelsounder
+{
+struct shm_ring_header{
+    char magic[8];                      // SHM_RING_MAGIC, written last by the writer once the ring is initialized
+    uint32_t version;                   // SHM_RING_VERSION
+    uint32_t header_bytes;              // offset of slot 0
+    uint64_t slot_bytes;                // bytes between the start of two slots
+    uint32_t n_slots;
+    uint32_t n_channels;
+    uint32_t n_bytes_per_item;          // size of one complex sample as received
+    uint32_t n_bytes_per_window;        // bytes of one window of one channel as stored in the slot
+    char data_type[8];                  // "sc16", "fc32", "sc12", "sc8" or "fp16", see ch_measurement_format.h
+    uint32_t storage_format;            // CH_MEASUREMENT_STORAGE_NATIVE etc.
+    float storage_scale;                // stored value times storage_scale is the native sample value
+    uint64_t samp_rate;                 // S/s
+    uint32_t n_samples_per_period;      // number of complex samples between the start of two measurements
+    uint32_t measurement_length;        // number of complex samples per measurement and channel
+    uint64_t writer_pid;                // process id of the recorder
+    uint64_t write_seq;                 // number of windows published, atomic
+    char reserved[40];                  // zero, for future use
+};
+
+struct shm_slot_header{
+    uint64_t seq;                       // 2s + 2 once window s is complete, odd while it is written, atomic
+    uint64_t measurement;               // absolute number of the measurement in device time, tick/n_samples_per_period
+    int64_t tick;                       // device time of the first sample
+    int64_t publish_time_ns;            // steady clock of the host (CLOCK_MONOTONIC) when the window was published
+    uint32_t flags;                     // CH_MEASUREMENT_COMPLETE etc.
+    uint32_t reserved[7];
+};
+
+static_assert(sizeof(shm_ring_header) == 128, "shm ring header layout changed");
+static_assert(sizeof(shm_slot_header) == 64, "shm slot header layout changed");
+}
+
+#endif
@@ -0,0 +1,174 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CHANNELSOUNDER_SHM_RING_READER_H
+#define CHANNELSOUNDER_SHM_RING_READER_H
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "shm_ring_format.h"
+
+namespace channelsounder
+{
+// state of a window in the ring, see shm_ring_reader::begin_read()
+enum shm_window_state{
+    SHM_WINDOW_OVERWRITTEN = -1,
+    SHM_WINDOW_NOT_YET = 0,
+    SHM_WINDOW_READY = 1
+};
+
+/*!
+ * Header-only reader of the shared memory ring written by the recorder, maps the ring read-only.
+ * Windows are read in place, the reader never blocks the writer and is told afterwards if a window was overwritten while it was read.
+ *
+ * shm_ring_reader r;
+ * if(r.open("/channelsounder_0"))
+ *     uint64_t s = r.write_seq() - 1, token;                    // newest window
+ *     if(r.begin_read(s, token) == SHM_WINDOW_READY)
+ *         const char* w = r.window(s, ch);                     // use the samples
+ *         if(r.end_read(s, token))                              // samples were valid
+*/
+class shm_ring_reader{
+public:
+    shm_ring_reader() : fd(-1), base(nullptr), n_bytes(0) {}
+    ~shm_ring_reader(){ close(); }
+
+    shm_ring_reader(const shm_ring_reader&) = delete;
+    shm_ring_reader& operator=(const shm_ring_reader&) = delete;
+
+    /*!
+     * name                     shared memory object, e.g. "/channelsounder_0"
+     * return                   1 on success and 0 on failure, e.g. if the recorder has not initialized the ring yet
+    */
+    int open(const std::string &name){
+        close();
+
+        fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if(fd < 0){
+            std::cerr << "shm_ring_reader: could not open " << name << std::endl;
+            return 0;
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(shm_ring_header)){
+            std::cerr << "shm_ring_reader: ring too small " << name << std::endl;
+            close();
+            return 0;
+        }
+        n_bytes = st.st_size;
+
+        void* p = mmap(nullptr, n_bytes, PROT_READ, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED){
+            std::cerr << "shm_ring_reader: could not map " << name << std::endl;
+            base = nullptr;
+            close();
+            return 0;
+        }
+        base = static_cast<const char*>(p);
+
+        // the magic is written last
+        const shm_ring_header &h = header();
+        const bool initialized = memcmp(h.magic, SHM_RING_MAGIC, sizeof(SHM_RING_MAGIC)) == 0;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(initialized == false
+           || h.version != SHM_RING_VERSION
+           || h.n_slots == 0
+           || h.slot_bytes < sizeof(shm_slot_header) + (uint64_t) h.n_channels*h.n_bytes_per_window
+           || h.header_bytes + h.n_slots*h.slot_bytes > n_bytes){
+            std::cerr << "shm_ring_reader: invalid header " << name << std::endl;
+            close();
+            return 0;
+        }
+
+        return 1;
+    }
+
+    void close(){
+        if(base != nullptr)
+            munmap(const_cast<char*>(base), n_bytes);
+        if(fd >= 0)
+            ::close(fd);
+        fd = -1;
+        base = nullptr;
+        n_bytes = 0;
+    }
+
+    /*!
+     * name                     name passed to open()
+     * return                   true if the recorder has replaced the ring since it was opened, e.g. after a restart
+    */
+    bool replaced(const std::string &name) const{
+        const int fd_new = shm_open(name.c_str(), O_RDONLY, 0);
+        if(fd_new < 0)
+            return false;
+        struct stat st_old, st_new;
+        const bool same = fstat(fd, &st_old) == 0 && fstat(fd_new, &st_new) == 0 && st_old.st_ino == st_new.st_ino;
+        ::close(fd_new);
+        return same == false;
+    }
+
+    const shm_ring_header& header() const{
+        return *reinterpret_cast<const shm_ring_header*>(base);
+    }
+
+    // number of windows published so far, the newest is write_seq() - 1
+    uint64_t write_seq() const{
+        return __atomic_load_n(&header().write_seq, __ATOMIC_ACQUIRE);
+    }
+
+    const shm_slot_header& slot(const uint64_t s) const{
+        return *reinterpret_cast<const shm_slot_header*>(base + header().header_bytes + (s % header().n_slots)*header().slot_bytes);
+    }
+
+    /*!
+     * s                        number of the window
+     * token                    set if the window is ready, pass to end_read()
+     * return                   SHM_WINDOW_READY, SHM_WINDOW_NOT_YET or SHM_WINDOW_OVERWRITTEN
+    */
+    int begin_read(const uint64_t s, uint64_t &token) const{
+        token = __atomic_load_n(&slot(s).seq, __ATOMIC_ACQUIRE);
+        if(token == 2*s + 2)
+            return SHM_WINDOW_READY;
+        return (token < 2*s + 2) ? SHM_WINDOW_NOT_YET : SHM_WINDOW_OVERWRITTEN;
+    }
+
+    // samples of channel ch of window s, only valid between begin_read() and a successful end_read()
+    const char* window(const uint64_t s, const size_t ch) const{
+        return reinterpret_cast<const char*>(&slot(s)) + sizeof(shm_slot_header) + ch*header().n_bytes_per_window;
+    }
+
+    /*!
+     * return                   true if window s was not overwritten since begin_read()
+    */
+    bool end_read(const uint64_t s, const uint64_t token) const{
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&slot(s).seq, __ATOMIC_RELAXED) == token;
+    }
+
+private:
+    int fd;
+    const char* base;
+    size_t n_bytes;
+};
+}
+
+#endif
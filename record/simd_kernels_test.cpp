@@ -0,0 +1,128 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstring>
+
+#include "cpu_features.h"
+#include "window_gate.h"
+#include "window_average.h"
+#include "storage_format.h"
+#include "ch_measurement_format.h"
+
+/***********************************************************************
+ * The AVX, AVX2 and F16C kernels of window_power(), the window average
+ * and the fp16 storage format must give the results of the scalar
+ * fallback, for window lengths with and without a scalar remainder.
+ **********************************************************************/
+#define MAX_WINDOW_LENGTH       70
+#define N_AVERAGE               5
+#define MAX_POWER_ERROR         1e-5            // relative, fc32 power is summed in float lanes by AVX
+
+struct results{
+    std::vector<float> power;
+    std::vector<char> average;
+    std::vector<char> fp16;
+};
+
+// sc16 with full scale values, fc32 with values beyond the fp16 range and below its normal range
+static void make_samples(const size_t n_bytes_per_item, const size_t n_values, std::mt19937 &gen, std::vector<char> &samples){
+    samples.resize(n_values*n_bytes_per_item/2);
+    if(n_bytes_per_item == 4){
+        std::uniform_int_distribution<int> dist(-32768, 32767);
+        int16_t* p = reinterpret_cast<int16_t*>(&samples[0]);
+        for(size_t i = 0; i < n_values; i++)
+            p[i] = (i % 5 == 0) ? ((i % 2) ? 32767 : -32768) : (int16_t) dist(gen);
+    }
+    else{
+        std::uniform_real_distribution<float> mant(-1.0f, 1.0f);
+        std::uniform_int_distribution<int> exp(-30, 20);
+        float* p = reinterpret_cast<float*>(&samples[0]);
+        for(size_t i = 0; i < n_values; i++)
+            p[i] = std::ldexp(mant(gen), exp(gen));
+    }
+}
+
+static void run_kernels(const bool simd, const size_t n_bytes_per_item, results &r){
+    channelsounder::set_cpu_features_enabled(simd);
+    channelsounder::init_window_gate(true, 0.0f, 1, 1);
+    channelsounder::init_window_average(N_AVERAGE);
+    channelsounder::init_storage_format(CH_MEASUREMENT_STORAGE_FP16);
+
+    std::mt19937 gen(n_bytes_per_item);
+    std::vector<char> samples, acc, window, stored;
+    for(size_t window_length = 1; window_length <= MAX_WINDOW_LENGTH; window_length++){
+        make_samples(n_bytes_per_item, 2*window_length, gen, samples);
+        r.power.push_back(channelsounder::window_power(&samples[0], n_bytes_per_item, window_length));
+
+        // the samples of the last window are added in two parts, like a window received in two packets
+        acc.assign(channelsounder::get_average_window_bytes(window_length), 0);
+        window.resize(window_length*n_bytes_per_item);
+        for(size_t k = 0; k < N_AVERAGE; k++){
+            make_samples(n_bytes_per_item, 2*window_length, gen, samples);
+            const size_t n_first = (k == N_AVERAGE - 1) ? window_length/2 : window_length;
+            channelsounder::accumulate_window(&acc[0], &samples[0], n_bytes_per_item, n_first);
+            channelsounder::accumulate_window(&acc[0] + (acc.size()/window_length)*n_first, &samples[0] + n_first*n_bytes_per_item, n_bytes_per_item, window_length - n_first);
+        }
+        channelsounder::finish_average(&acc[0], n_bytes_per_item, window_length, &window[0]);
+        r.average.insert(r.average.end(), window.begin(), window.end());
+
+        stored.resize(channelsounder::get_storage_window_bytes(CH_MEASUREMENT_STORAGE_FP16, n_bytes_per_item, window_length));
+        channelsounder::convert_window(&samples[0], n_bytes_per_item, window_length, &stored[0]);
+        r.fp16.insert(r.fp16.end(), stored.begin(), stored.end());
+    }
+}
+
+static int compare(const size_t n_bytes_per_item){
+    results scalar, simd;
+    run_kernels(false, n_bytes_per_item, scalar);
+    run_kernels(true, n_bytes_per_item, simd);
+
+    const char* type = (n_bytes_per_item == 4) ? "sc16" : "fc32";
+    for(size_t i = 0; i < scalar.power.size(); i++){
+        const double tolerance = (n_bytes_per_item == 4) ? 0.0 : MAX_POWER_ERROR*scalar.power[i];
+        if(std::fabs((double) simd.power[i] - scalar.power[i]) > tolerance){
+            std::cerr << type << " power of window length " << i + 1 << ": " << simd.power[i] << " instead of " << scalar.power[i] << std::endl;
+            return 0;
+        }
+    }
+    if(simd.average != scalar.average){
+        std::cerr << type << " average differs from the scalar fallback" << std::endl;
+        return 0;
+    }
+    if(simd.fp16 != scalar.fp16){
+        std::cerr << type << " fp16 conversion differs from the scalar fallback" << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+int main()
+{
+    if (not channelsounder::has_cpu_feature(channelsounder::CPU_FEATURE_AVX2) or not channelsounder::has_cpu_feature(channelsounder::CPU_FEATURE_F16C)) {
+        std::cout << "cpu without AVX2 or F16C, only the scalar kernels are compared" << std::endl;
+    }
+
+    if (not compare(4) or not compare(8)) {
+        std::cerr << "FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "simd kernels match the scalar fallback for window lengths 1 to " << MAX_WINDOW_LENGTH << std::endl;
+    return 0;
+}
@@ -0,0 +1,232 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "storage_format.h"
+#include "cpu_features.h"
+
+// values converted per step, the quantized block stays in L1 before it is packed
+#define STORAGE_BLOCK   256
+
+namespace channelsounder
+{
+static uint32_t format;
+static bool use_f16c;
+
+static void convert_sc12(const char* in, const size_t n_bytes_per_item, const size_t n_values, unsigned char* out);
+static void convert_sc8(const char* in, const size_t n_bytes_per_item, const size_t n_values, char* out);
+static void convert_fp16(const char* in, const size_t n_bytes_per_item, const size_t n_values, uint16_t* out);
+
+int init_storage_format(const uint32_t format_arg){
+    if(format_arg > CH_MEASUREMENT_STORAGE_FP16){
+        std::cerr << "storage_format: unknown storage format." << std::endl;
+        return 0;
+    }
+    format = format_arg;
+
+    use_f16c = has_cpu_feature(CPU_FEATURE_AVX) && has_cpu_feature(CPU_FEATURE_F16C);
+
+    return 1;
+}
+
+int parse_storage_format(const std::string &str, uint32_t &format_out){
+    if(str == "native")
+        format_out = CH_MEASUREMENT_STORAGE_NATIVE;
+    else if(str == "sc12")
+        format_out = CH_MEASUREMENT_STORAGE_SC12;
+    else if(str == "sc8")
+        format_out = CH_MEASUREMENT_STORAGE_SC8;
+    else if(str == "fp16")
+        format_out = CH_MEASUREMENT_STORAGE_FP16;
+    else
+        return 0;
+    return 1;
+}
+
+uint32_t get_storage_format(){
+    return format;
+}
+
+size_t get_storage_window_bytes(const uint32_t format_arg, const size_t n_bytes_per_item, const size_t window_length){
+    switch(format_arg){
+        case CH_MEASUREMENT_STORAGE_SC12:   return 3*window_length;
+        case CH_MEASUREMENT_STORAGE_SC8:    return sizeof(int32_t) + 2*window_length;
+        case CH_MEASUREMENT_STORAGE_FP16:   return 2*sizeof(uint16_t)*window_length;
+        default:                            return n_bytes_per_item*window_length;
+    }
+}
+
+float get_storage_scale(const uint32_t format_arg, const size_t n_bytes_per_item){
+    const bool sc16 = (n_bytes_per_item == 4);
+    switch(format_arg){
+        case CH_MEASUREMENT_STORAGE_SC12:   return sc16 ? 16.0f : 1.0f/2047.0f;
+        case CH_MEASUREMENT_STORAGE_FP16:   return sc16 ? 32768.0f : 1.0f;
+        default:                            return 1.0f;
+    }
+}
+
+const char* get_storage_data_type(const uint32_t format_arg, const size_t n_bytes_per_item){
+    switch(format_arg){
+        case CH_MEASUREMENT_STORAGE_SC12:   return "sc12";
+        case CH_MEASUREMENT_STORAGE_SC8:    return "sc8";
+        case CH_MEASUREMENT_STORAGE_FP16:   return "fp16";
+        default:                            return (n_bytes_per_item == 4) ? "sc16" : "fc32";
+    }
+}
+
+void convert_window(const char* in, const size_t n_bytes_per_item, const size_t window_length, char* out){
+    switch(format){
+        case CH_MEASUREMENT_STORAGE_NATIVE: std::copy_n(in, n_bytes_per_item*window_length, out);                                   break;
+        case CH_MEASUREMENT_STORAGE_SC12:   convert_sc12(in, n_bytes_per_item, 2*window_length, reinterpret_cast<unsigned char*>(out));  break;
+        case CH_MEASUREMENT_STORAGE_SC8:    convert_sc8(in, n_bytes_per_item, 2*window_length, out);                                  break;
+        case CH_MEASUREMENT_STORAGE_FP16:   convert_fp16(in, n_bytes_per_item, 2*window_length, reinterpret_cast<uint16_t*>(out));    break;
+    }
+}
+
+void show_debug_information_storage_format(){
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Storage format statistics:" << std::endl;
+    std::cout << "storage_format: " << format << std::endl;
+    std::cout << "fp16 kernel: " << (use_f16c ? "F16C" : "scalar") << std::endl;
+    std::cout << "--------------------------" << std::endl;
+}
+
+// round half away from zero and saturate, written branch free so the loops below are vectorized by the compiler
+static inline int16_t round_saturate(const float v, const float limit){
+    const float r = (v >= 0.0f) ? v + 0.5f : v - 0.5f;
+    return (int16_t) std::min(std::max(r, -limit), limit);
+}
+
+static void convert_sc12(const char* in, const size_t n_bytes_per_item, const size_t n_values, unsigned char* out){
+    int16_t q[STORAGE_BLOCK];
+
+    for(size_t i0 = 0; i0 < n_values; i0 += STORAGE_BLOCK){
+        const size_t n = std::min<size_t>(STORAGE_BLOCK, n_values - i0);
+
+        // sc16 drops the 4 lsbs, fc32 is scaled to full range
+        if(n_bytes_per_item == 4){
+            const int16_t* p = reinterpret_cast<const int16_t*>(in) + i0;
+            for(size_t i = 0; i < n; i++)
+                q[i] = (int16_t) std::min<int32_t>(((int32_t) p[i] + 8) >> 4, 2047);
+        }
+        else{
+            const float* p = reinterpret_cast<const float*>(in) + i0;
+            for(size_t i = 0; i < n; i++)
+                q[i] = round_saturate(p[i]*2047.0f, 2047.0f);
+        }
+
+        // real and imag of one complex sample in 3 bytes, n is always even
+        unsigned char* o = out + i0/2*3;
+        for(size_t i = 0; i < n; i += 2, o += 3){
+            const uint16_t re = (uint16_t) q[i];
+            const uint16_t im = (uint16_t) q[i + 1];
+            o[0] = (unsigned char) re;
+            o[1] = (unsigned char) (((re >> 8) & 0x0f) | ((im & 0x0f) << 4));
+            o[2] = (unsigned char) (im >> 4);
+        }
+    }
+}
+
+static void convert_sc8(const char* in, const size_t n_bytes_per_item, const size_t n_values, char* out){
+    // block exponent from the largest magnitude of the window
+    float max_abs = 0.0f;
+    if(n_bytes_per_item == 4){
+        const int16_t* p = reinterpret_cast<const int16_t*>(in);
+        int32_t m = 0;
+        for(size_t i = 0; i < n_values; i++)
+            m = std::max(m, std::abs((int32_t) p[i]));
+        max_abs = (float) m;
+    }
+    else{
+        const float* p = reinterpret_cast<const float*>(in);
+        for(size_t i = 0; i < n_values; i++)
+            max_abs = std::max(max_abs, std::fabs(p[i]));
+    }
+
+    // smallest exponent with max_abs*2^-exponent <= 127
+    int32_t exponent = 0;
+    if(max_abs > 0.0f){
+        int e;
+        std::frexp(max_abs/127.0f, &e);
+        exponent = e;
+    }
+    memcpy(out, &exponent, sizeof(exponent));
+
+    const float gain = std::ldexp(1.0f, -exponent);
+    int8_t* o = reinterpret_cast<int8_t*>(out + sizeof(exponent));
+    if(n_bytes_per_item == 4){
+        const int16_t* p = reinterpret_cast<const int16_t*>(in);
+        for(size_t i = 0; i < n_values; i++)
+            o[i] = (int8_t) round_saturate(p[i]*gain, 127.0f);
+    }
+    else{
+        const float* p = reinterpret_cast<const float*>(in);
+        for(size_t i = 0; i < n_values; i++)
+            o[i] = (int8_t) round_saturate(p[i]*gain, 127.0f);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 8 values per instruction, the target attribute keeps the rest of the build free of avx
+__attribute__((target("avx,f16c")))
+static size_t convert_fp16_f16c(const char* in, const size_t n_bytes_per_item, const size_t n_values, uint16_t* out){
+    size_t i = 0;
+    if(n_bytes_per_item == 4){
+        const int16_t* p = reinterpret_cast<const int16_t*>(in);
+        const __m256 gain = _mm256_set1_ps(1.0f/32768.0f);
+        for(; i + 8 <= n_values; i += 8){
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            const __m128i lo = _mm_cvtepi16_epi32(v);
+            const __m128i hi = _mm_cvtepi16_epi32(_mm_srli_si128(v, 8));
+            const __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1)), gain);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+        }
+    }
+    else{
+        const float* p = reinterpret_cast<const float*>(in);
+        for(; i + 8 <= n_values; i += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(p + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+    return i;
+}
+#endif
+
+static void convert_fp16(const char* in, const size_t n_bytes_per_item, const size_t n_values, uint16_t* out){
+    size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if(use_f16c)
+        i = convert_fp16_f16c(in, n_bytes_per_item, n_values, out);
+#endif
+
+    // remainder, or everything without F16C
+    if(n_bytes_per_item == 4){
+        const int16_t* p = reinterpret_cast<const int16_t*>(in);
+        for(; i < n_values; i++)
+            out[i] = float_to_half(p[i]*(1.0f/32768.0f));
+    }
+    else{
+        const float* p = reinterpret_cast<const float*>(in);
+        for(; i < n_values; i++)
+            out[i] = float_to_half(p[i]);
+    }
+}
+}
@@ -0,0 +1,197 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef CHANNELSOUNDER_STORAGE_FORMAT_H
+#define CHANNELSOUNDER_STORAGE_FORMAT_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+
+#include "ch_measurement_format.h"
+
+namespace channelsounder
+{
+/*!
+ * Inits unit internally. Must be called before the first fifo is initialized.
+ *
+ * format_arg                   CH_MEASUREMENT_STORAGE_NATIVE etc., see ch_measurement_format.h
+ * return                       1 on success and 0 on failure
+*/
+int init_storage_format(const uint32_t format_arg);
+
+/*!
+ * Converts a command line string to a storage format.
+ *
+ * str                          "native", "sc12", "sc8" or "fp16"
+ * format                       set on success
+ * return                       1 on success and 0 on failure
+*/
+int parse_storage_format(const std::string &str, uint32_t &format);
+
+/*!
+ * return                       storage format set in init_storage_format()
+*/
+uint32_t get_storage_format();
+
+/*!
+ * n_bytes_per_item             size of a native complex sample, 4 for sc16 and 8 for fc32
+ * window_length                complex samples per window
+ * return                       bytes of one stored window of one channel
+*/
+size_t get_storage_window_bytes(const uint32_t format, const size_t n_bytes_per_item, const size_t window_length);
+
+/*!
+ * return                       factor from stored values to native sample values, written to the file header
+*/
+float get_storage_scale(const uint32_t format, const size_t n_bytes_per_item);
+
+/*!
+ * return                       name of the stored samples, written to the file header
+*/
+const char* get_storage_data_type(const uint32_t format, const size_t n_bytes_per_item);
+
+/*!
+ * Converts one window of one channel to the format set in init_storage_format(), called once per captured window.
+ *
+ * in                           window_length native complex samples
+ * n_bytes_per_item             size of a native complex sample, 4 for sc16 and 8 for fc32
+ * window_length                complex samples per window
+ * out                          get_storage_window_bytes() bytes
+*/
+void convert_window(const char* in, const size_t n_bytes_per_item, const size_t window_length, char* out);
+
+/*!
+ * Shows the storage format and the conversion kernel in use.
+*/
+void show_debug_information_storage_format();
+
+// IEEE 754 half precision, round to nearest even, used if the cpu has no F16C
+inline uint16_t float_to_half(const float f){
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    const uint16_t sign = (x >> 16) & 0x8000;
+    uint32_t mant = x & 0x7fffff;
+    const int32_t exp = (int32_t) ((x >> 23) & 0xff) - 127 + 15;
+
+    // inf and nan
+    if(exp == 0xff - 127 + 15)
+        return sign | 0x7c00 | (mant != 0 ? 0x200 : 0);
+    if(exp >= 0x1f)
+        return sign | 0x7c00;
+
+    // subnormal or zero
+    if(exp <= 0){
+        if(exp < -10)
+            return sign;
+        mant |= 0x800000;
+        const uint32_t shift = 14 - exp;
+        uint32_t h = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1);
+        const uint32_t half = 1u << (shift - 1);
+        if(rem > half || (rem == half && (h & 1)))
+            h++;
+        return sign | h;
+    }
+
+    // a carry out of the mantissa increments the exponent, which is correct
+    uint32_t h = ((uint32_t) exp << 10) | (mant >> 13);
+    const uint32_t rem = mant & 0x1fff;
+    if(rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+        h++;
+    return sign | h;
+}
+
+inline float half_to_float(const uint16_t h){
+    const uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+    const uint32_t exp = (h >> 10) & 0x1f;
+    const uint32_t mant = h & 0x3ff;
+
+    uint32_t x;
+    if(exp == 0){
+        const float f = mant*(1.0f/16777216.0f);
+        return (sign != 0) ? -f : f;
+    }
+    else if(exp == 0x1f)
+        x = sign | 0x7f800000 | (mant << 13);
+    else
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+/*!
+ * Converts a stored window back to native sample values, used by ch_measurement_reader.h.
+ *
+ * format                       CH_MEASUREMENT_STORAGE_NATIVE etc.
+ * n_bytes_per_item             size of a native complex sample, 4 for sc16 and 8 for fc32
+ * scale                        storage_scale of the file header
+ * in                           one stored window
+ * window_length                complex samples per window
+ * out                          2*window_length values, real and imag interleaved
+*/
+inline void storage_decode_window(const uint32_t format, const size_t n_bytes_per_item, const float scale, const char* in, const size_t window_length, float* out){
+    const size_t n_values = 2*window_length;
+    switch(format){
+        case CH_MEASUREMENT_STORAGE_NATIVE:
+        {
+            if(n_bytes_per_item == 8){
+                memcpy(out, in, n_values*sizeof(float));
+            }
+            else{
+                const int16_t* p = reinterpret_cast<const int16_t*>(in);
+                for(size_t i = 0; i < n_values; i++)
+                    out[i] = p[i];
+            }
+            break;
+        }
+        case CH_MEASUREMENT_STORAGE_SC12:
+        {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+            for(size_t i = 0; i < window_length; i++, p += 3){
+                const int32_t re = (int32_t) ((uint32_t) (p[0] | ((p[1] & 0x0f) << 8)) << 20) >> 20;
+                const int32_t im = (int32_t) ((uint32_t) ((p[1] >> 4) | (p[2] << 4)) << 20) >> 20;
+                out[2*i] = re*scale;
+                out[2*i + 1] = im*scale;
+            }
+            break;
+        }
+        case CH_MEASUREMENT_STORAGE_SC8:
+        {
+            int32_t exponent;
+            memcpy(&exponent, in, sizeof(exponent));
+            const float gain = ldexpf(scale, exponent);
+            const int8_t* p = reinterpret_cast<const int8_t*>(in + sizeof(exponent));
+            for(size_t i = 0; i < n_values; i++)
+                out[i] = p[i]*gain;
+            break;
+        }
+        case CH_MEASUREMENT_STORAGE_FP16:
+        {
+            const uint16_t* p = reinterpret_cast<const uint16_t*>(in);
+            for(size_t i = 0; i < n_values; i++)
+                out[i] = half_to_float(p[i])*scale;
+            break;
+        }
+    }
+}
+}
+
+#endif
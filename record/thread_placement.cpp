@@ -0,0 +1,266 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <ifaddrs.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "thread_placement.h"
+#include "buffer_allocator.h"
+
+namespace channelsounder
+{
+struct placement{
+    std::vector<int> cores;     // n-th thread of a role is pinned to n-th core, empty for no pinning
+    bool has_policy;            // if false, scheduling is left to the caller
+    int policy;                 // SCHED_*
+    int priority;               // only for SCHED_FIFO and SCHED_RR
+};
+static std::map<std::string, placement> placements;
+
+static std::vector<std::string> split(const std::string &str, const char delim);
+static int parse_policy(const std::string &str, int &policy);
+static bool is_role(const std::string &role);
+static std::string policy_to_string(const int policy);
+
+int init_thread_placement(const std::string &spec_arg){
+    placements.clear();
+    
+    if(spec_arg.empty())
+        return 1;
+    
+    std::vector<std::string> entries = split(spec_arg, ',');
+    for(size_t i = 0; i < entries.size(); i++){
+        const size_t eq = entries[i].find('=');
+        if(eq == std::string::npos){
+            std::cerr << "thread_placement: Missing \"=\" in \"" << entries[i] << "\"." << std::endl;
+            return 0;
+        }
+        
+        const std::string role = entries[i].substr(0, eq);
+        if(is_role(role) == false){
+            std::cerr << "thread_placement: Unknown role \"" << role << "\", roles are rx, process, save, tx and tx_async." << std::endl;
+            return 0;
+        }
+        std::vector<std::string> fields = split(entries[i].substr(eq + 1), ':');
+        
+        placement p;
+        p.has_policy = false;
+        p.policy = SCHED_OTHER;
+        p.priority = 0;
+        
+        try{
+            if(fields.size() > 0 && !fields[0].empty()){
+                std::vector<std::string> cores = split(fields[0], '/');
+                for(size_t c = 0; c < cores.size(); c++)
+                    p.cores.push_back(std::stoi(cores[c]));
+            }
+            if(fields.size() > 1){
+                if(parse_policy(fields[1], p.policy) == 0){
+                    std::cerr << "thread_placement: Unknown policy \"" << fields[1] << "\"." << std::endl;
+                    return 0;
+                }
+                p.has_policy = true;
+            }
+            if(fields.size() > 2)
+                p.priority = std::stoi(fields[2]);
+        }
+        catch(const std::exception &e){
+            std::cerr << "thread_placement: Unable to parse \"" << entries[i] << "\"." << std::endl;
+            return 0;
+        }
+        
+        // CPU_SET() in apply_thread_placement() writes out of bounds beyond CPU_SETSIZE
+        const long n_cores_online = sysconf(_SC_NPROCESSORS_ONLN);
+        for(size_t c = 0; c < p.cores.size(); c++){
+            if(p.cores[c] < 0 || p.cores[c] >= CPU_SETSIZE || p.cores[c] >= n_cores_online){
+                std::cerr << "thread_placement: Core " << p.cores[c] << " of role " << role << " is out of range, " << n_cores_online << " cores are online." << std::endl;
+                return 0;
+            }
+        }
+        
+        if(p.has_policy && (p.policy == SCHED_FIFO || p.policy == SCHED_RR) && (p.priority < 1 || p.priority > 99)){
+            std::cerr << "thread_placement: Priority of role " << role << " must be between 1 and 99." << std::endl;
+            return 0;
+        }
+        
+        placements[role] = p;
+    }
+    
+    return 1;
+}
+
+int apply_thread_placement(const std::string &role, const size_t index){
+    std::map<std::string, placement>::const_iterator it = placements.find(role);
+    if(it == placements.end())
+        return 0;
+    const placement &p = it->second;
+    
+    int ret = 1;
+    
+    if(index < p.cores.size()){
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(p.cores[index], &cpuset);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0){
+            std::cerr << "thread_placement: Unable to pin " << role << " " << index << " to core " << p.cores[index] << "." << std::endl;
+            ret = 0;
+        }
+    }
+    
+    if(p.has_policy){
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = p.priority;
+        if(pthread_setschedparam(pthread_self(), p.policy, &param) != 0){
+            std::cerr << "thread_placement: Unable to set " << policy_to_string(p.policy) << " for " << role << " " << index << ", missing privileges?" << std::endl;
+            ret = 0;
+        }
+    }
+    
+    return ret;
+}
+
+bool has_thread_policy(const std::string &role){
+    std::map<std::string, placement>::const_iterator it = placements.find(role);
+    return it != placements.end() && it->second.has_policy;
+}
+
+int lock_all_memory(){
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0){
+        std::cerr << "thread_placement: mlockall failed, check ulimit -l." << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+int get_numa_node_of_address(const std::string &addr, std::string &iface){
+    iface.clear();
+    
+    struct in_addr target;
+    if(inet_pton(AF_INET, addr.c_str(), &target) != 1)
+        return -1;
+    
+    struct ifaddrs *ifap = nullptr;
+    if(getifaddrs(&ifap) != 0)
+        return -1;
+    
+    for(struct ifaddrs *ifa = ifap; ifa != nullptr; ifa = ifa->ifa_next){
+        if(ifa->ifa_addr == nullptr || ifa->ifa_netmask == nullptr || ifa->ifa_addr->sa_family != AF_INET)
+            continue;
+        const in_addr_t local = ((struct sockaddr_in*) ifa->ifa_addr)->sin_addr.s_addr;
+        const in_addr_t mask = ((struct sockaddr_in*) ifa->ifa_netmask)->sin_addr.s_addr;
+        if((local & mask) == (target.s_addr & mask)){
+            iface = ifa->ifa_name;
+            break;
+        }
+    }
+    freeifaddrs(ifap);
+    
+    if(iface.empty())
+        return -1;
+    
+    return get_numa_node_of_interface(iface);
+}
+
+void show_thread_placement(const std::string &device_args){
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Thread placement:" << std::endl;
+    if(placements.empty())
+        std::cout << "none, all threads are placed by the kernel" << std::endl;
+    for(std::map<std::string, placement>::const_iterator it = placements.begin(); it != placements.end(); ++it){
+        std::ostringstream ss;
+        for(size_t c = 0; c < it->second.cores.size(); c++)
+            ss << (c > 0 ? "/" : "") << it->second.cores[c];
+        std::cout << it->first << ": cores " << (it->second.cores.empty() ? "any" : ss.str());
+        if(it->second.has_policy)
+            std::cout << ", " << policy_to_string(it->second.policy) << " " << it->second.priority;
+        std::cout << std::endl;
+    }
+    
+    // every key containing "addr" except the management address is a streaming port
+    std::vector<std::string> pairs = split(device_args, ',');
+    for(size_t i = 0; i < pairs.size(); i++){
+        const size_t eq = pairs[i].find('=');
+        if(eq == std::string::npos)
+            continue;
+        const std::string key = pairs[i].substr(0, eq);
+        const std::string value = pairs[i].substr(eq + 1);
+        if(key.find("addr") == std::string::npos || key.find("mgmt_addr") != std::string::npos)
+            continue;
+        
+        std::string iface;
+        const int node = get_numa_node_of_address(value, iface);
+        std::cout << key << " " << value << ": interface " << (iface.empty() ? "unknown (DPDK?)" : iface) << ", NUMA node " << node << std::endl;
+    }
+    std::cout << "--------------------------" << std::endl;
+}
+
+static std::vector<std::string> split(const std::string &str, const char delim){
+    std::vector<std::string> ret;
+    std::stringstream ss(str);
+    std::string item;
+    while(std::getline(ss, item, delim))
+        ret.push_back(item);
+    return ret;
+}
+
+static int parse_policy(const std::string &str, int &policy){
+    if(str == "other")
+        policy = SCHED_OTHER;
+    else if(str == "batch")
+        policy = SCHED_BATCH;
+    else if(str == "idle")
+        policy = SCHED_IDLE;
+    else if(str == "fifo")
+        policy = SCHED_FIFO;
+    else if(str == "rr")
+        policy = SCHED_RR;
+    else
+        return 0;
+    return 1;
+}
+
+static bool is_role(const std::string &role){
+    return role == "rx" || role == "process" || role == "save" || role == "tx" || role == "tx_async";
+}
+
+static std::string policy_to_string(const int policy){
+    switch(policy){
+        case SCHED_OTHER:
+            return "SCHED_OTHER";
+        case SCHED_BATCH:
+            return "SCHED_BATCH";
+        case SCHED_IDLE:
+            return "SCHED_IDLE";
+        case SCHED_FIFO:
+            return "SCHED_FIFO";
+        case SCHED_RR:
+            return "SCHED_RR";
+        default:
+            return "unknown";
+    }
+}
+}
@@ -0,0 +1,74 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_THREAD_PLACEMENT_H
+#define CHANNELSOUNDER_THREAD_PLACEMENT_H
+
+#include <string>
+
+namespace channelsounder
+{
+/*!
+ * Inits unit internally. Must be called before any pipeline thread is started.
+ *
+ * spec_arg                     comma separated list of "role=cores[:policy[:priority]]", e.g. "rx=2/3:fifo:90,process=4/5,save=6:other"
+ *                              roles are rx, process, save, tx and tx_async
+ *                              cores are separated by "/", the n-th thread of a role (e.g. the pipeline id) is pinned to the n-th core
+ *                              policy is one of other, batch, idle, fifo or rr, priority is only used for fifo and rr (1 to 99)
+ * return                       1 on success and 0 on failure
+*/
+int init_thread_placement(const std::string &spec_arg);
+
+/*!
+ * Pins the calling thread and sets its scheduling policy. Threads of roles without placement are left untouched.
+ *
+ * role                         name of the thread's role, see init_thread_placement()
+ * index                        index of the thread within its role, e.g. the pipeline id
+ * return                       1 if a placement was applied successfully, 0 otherwise
+*/
+int apply_thread_placement(const std::string &role, const size_t index);
+
+/*!
+ * Checks if a role has an explicit scheduling policy, so the caller does not need to elevate its priority.
+*/
+bool has_thread_policy(const std::string &role);
+
+/*!
+ * Locks all current and future pages of the process into RAM.
+ *
+ * return                       1 on success and 0 on failure
+*/
+int lock_all_memory();
+
+/*!
+ * Reads the NUMA node of the local interface whose subnet contains an IPv4 address.
+ *
+ * addr                         IPv4 address of a remote device, e.g. "192.168.10.2"
+ * iface                        set to the name of the interface, empty if none was found
+ * return                       NUMA node or -1 if unknown, e.g. for ports bound to DPDK
+*/
+int get_numa_node_of_address(const std::string &addr, std::string &iface);
+
+/*!
+ * Shows the placement of all roles and the NUMA node of each USRP NIC.
+ *
+ * device_args                  uhd device address args, all addr and second_addr keys are looked up
+*/
+void show_thread_placement(const std::string &device_args);
+}
+ 
+#endif
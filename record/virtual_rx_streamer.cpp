@@ -0,0 +1,269 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/thread/thread.hpp>
+
+#include "virtual_rx_streamer.h"
+#include "sequence.h"
+#include "seq_format.h"
+
+// the synthetic source repeats whole periods of at least this many samples, long enough for the noise to look random
+#define N_SYNTHETIC_BLOCK_SAMPLES       (1024*1024)
+
+namespace channelsounder
+{
+virtual_rx_streamer::virtual_rx_streamer(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const double samp_rate_arg, const size_t max_samps_arg,
+                                         const bool paced_arg, const double buffer_sec_arg)
+    : n_channels(n_channels_arg), n_bytes_per_item(n_bytes_per_item_arg), samp_rate(samp_rate_arg), max_samps(max_samps_arg),
+      paced(paced_arg), n_buffer_samples((unsigned long long) (buffer_sec_arg*samp_rate_arg)),
+      map(nullptr), map_bytes(0), n_source_samples(0),
+      streaming(false), end_of_burst_pending(false), tick(0), tick_start(0), n_overflow_request(0),
+      n_samples_total(0), n_packets(0), n_overflows_injected(0), n_overflows_lag(0), n_samples_lost(0)
+{
+}
+
+virtual_rx_streamer::~virtual_rx_streamer(){
+    if(map != nullptr)
+        munmap(map, map_bytes);
+}
+
+int virtual_rx_streamer::init_synthetic(const std::vector<std::vector<std::complex<float>>> &seq, const double snr_db){
+    if(seq.empty() || seq[0].empty()){
+        std::cerr << "virtual_rx_streamer: sequence is empty." << std::endl;
+        return 0;
+    }
+    if(n_bytes_per_item != 4 && n_bytes_per_item != 8){
+        std::cerr << "virtual_rx_streamer: Unknown data type." << std::endl;
+        return 0;
+    }
+    
+    // what every rx channel receives without noise
+    const size_t seq_length = seq[0].size();
+    // chips as sent by ringbuffer_tx, the sum of all tx channels is divided by their number
+    const float scale = ((n_bytes_per_item == 4) ? SEQ_SCALE_SC16 : SEQ_SCALE_FC32)/seq.size();
+    std::vector<std::complex<float>> sum(seq_length);
+    double power = 0.0;
+    for(size_t j = 0; j < seq_length; j++){
+        for(size_t t = 0; t < seq.size(); t++)
+            sum[j] += seq[t][j]*scale;
+        power += std::norm(sum[j]);
+    }
+    power /= seq_length;
+    const float sigma = std::sqrt(power/2.0*std::pow(10.0, -snr_db/10.0));
+    
+    n_source_samples = seq_length*((N_SYNTHETIC_BLOCK_SAMPLES + seq_length - 1)/seq_length);
+    blocks.resize(n_channels);
+    source.resize(n_channels);
+    for(size_t ch = 0; ch < n_channels; ch++){
+        blocks[ch].resize(n_source_samples*n_bytes_per_item);
+        source[ch] = &blocks[ch][0];
+        
+        std::mt19937 generator(ch + 1);
+        std::normal_distribution<float> noise(0.0f, sigma);
+        for(unsigned long long j = 0; j < n_source_samples; j++){
+            const std::complex<float> v = sum[j % seq_length] + std::complex<float>(noise(generator), noise(generator));
+            if(n_bytes_per_item == 4){
+                int16_t* p = reinterpret_cast<int16_t*>(&blocks[ch][j*n_bytes_per_item]);
+                p[0] = (int16_t) std::max(-32768.0f, std::min(32767.0f, std::round(v.real())));
+                p[1] = (int16_t) std::max(-32768.0f, std::min(32767.0f, std::round(v.imag())));
+            }
+            else{
+                float* p = reinterpret_cast<float*>(&blocks[ch][j*n_bytes_per_item]);
+                p[0] = v.real();
+                p[1] = v.imag();
+            }
+        }
+    }
+    
+    source_name = "synthetic, " + std::to_string(seq.size()) + " tx channels, " + std::to_string(seq_length) + " samples per period, snr " + std::to_string(snr_db) + " dB";
+    
+    return 1;
+}
+
+int virtual_rx_streamer::init_replay(const std::string &file_name){
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if(fd < 0){
+        std::cerr << "virtual_rx_streamer: could not open " << file_name << ": " << strerror(errno) << std::endl;
+        return 0;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0){
+        std::cerr << "virtual_rx_streamer: " << file_name << " is empty." << std::endl;
+        close(fd);
+        return 0;
+    }
+    map_bytes = st.st_size;
+    
+    // replayed over and over again, so all of it is read now and not while streaming
+    void* p = mmap(nullptr, map_bytes, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED){
+        std::cerr << "virtual_rx_streamer: could not map " << file_name << ": " << strerror(errno) << std::endl;
+        map = nullptr;
+        return 0;
+    }
+    map = static_cast<char*>(p);
+    
+    // header of seq.bin or raw samples, parsed as by init_ringbuffer_tx_waveform()
+    size_t data_offset;
+    unsigned long long file_samp_rate;
+    if(parse_sequence_file(map, map_bytes, n_channels, n_bytes_per_item, file_name, data_offset, n_source_samples, file_samp_rate) == 0)
+        return 0;
+    
+    source.resize(n_channels);
+    for(size_t ch = 0; ch < n_channels; ch++)
+        source[ch] = map + data_offset + ch*n_source_samples*n_bytes_per_item;
+    
+    source_name = "replay of " + file_name + ", " + std::to_string(n_source_samples) + " samples per channel";
+    
+    return 1;
+}
+
+void virtual_rx_streamer::inject_overflow(const unsigned long long n_samples_lost_arg){
+    n_overflow_request.fetch_add(std::max<unsigned long long>(1, n_samples_lost_arg), std::memory_order_relaxed);
+}
+
+size_t virtual_rx_streamer::get_num_channels() const{
+    return n_channels;
+}
+
+size_t virtual_rx_streamer::get_max_num_samps() const{
+    return max_samps;
+}
+
+size_t virtual_rx_streamer::recv(const buffs_type& buffs, const size_t nsamps_per_buff, uhd::rx_metadata_t& metadata, const double timeout, const bool one_packet){
+    metadata.reset();
+    
+    // stopped, the first call after the stop command ends the burst
+    if(streaming == false){
+        if(end_of_burst_pending){
+            end_of_burst_pending = false;
+            metadata.has_time_spec = true;
+            metadata.time_spec = uhd::time_spec_t::from_ticks(tick, samp_rate);
+            metadata.end_of_burst = true;
+            return 0;
+        }
+        boost::this_thread::sleep_for(boost::chrono::microseconds((long long) (timeout*1e6)));
+        metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
+        return 0;
+    }
+    
+    // overflow on request or because the caller fell behind by more than the device buffers, the time stamp is that of the first sample lost
+    unsigned long long n_lost = n_overflow_request.exchange(0, std::memory_order_relaxed);
+    if(n_lost > 0)
+        n_overflows_injected++;
+    else if(paced){
+        const long long tick_now = tick_start + (long long) (std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count()*samp_rate);
+        if(tick_now - tick > (long long) n_buffer_samples){
+            n_lost = tick_now - tick;
+            n_overflows_lag++;
+        }
+    }
+    if(n_lost > 0){
+        metadata.has_time_spec = true;
+        metadata.time_spec = uhd::time_spec_t::from_ticks(tick, samp_rate);
+        metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_OVERFLOW;
+        tick += n_lost;
+        n_samples_lost += n_lost;
+        return 0;
+    }
+    
+    // paced, wait until the last sample would have arrived at the device
+    const size_t n = one_packet ? std::min(nsamps_per_buff, max_samps) : nsamps_per_buff;
+    if(paced){
+        const std::chrono::steady_clock::time_point t_ready = t_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((tick + (long long) n - tick_start)/samp_rate));
+        if(t_ready - std::chrono::steady_clock::now() > std::chrono::duration<double>(timeout)){
+            boost::this_thread::sleep_for(boost::chrono::microseconds((long long) (timeout*1e6)));
+            metadata.error_code = uhd::rx_metadata_t::ERROR_CODE_TIMEOUT;
+            return 0;
+        }
+        std::this_thread::sleep_until(t_ready);
+    }
+    
+    // the source repeats, sample tick is found at position tick modulo its length
+    unsigned long long pos = (unsigned long long) (((tick % (long long) n_source_samples) + n_source_samples) % n_source_samples);
+    size_t n_done = 0;
+    while(n_done < n){
+        const size_t n_piece = std::min<unsigned long long>(n - n_done, n_source_samples - pos);
+        for(size_t ch = 0; ch < n_channels; ch++)
+            memcpy(static_cast<char*>(buffs[ch]) + n_done*n_bytes_per_item, source[ch] + pos*n_bytes_per_item, n_piece*n_bytes_per_item);
+        n_done += n_piece;
+        pos = 0;
+    }
+    
+    metadata.has_time_spec = true;
+    metadata.time_spec = uhd::time_spec_t::from_ticks(tick, samp_rate);
+    metadata.start_of_burst = (tick == tick_start);
+    tick += n;
+    n_samples_total += n;
+    n_packets += (n + max_samps - 1)/max_samps;
+    
+    return n;
+}
+
+void virtual_rx_streamer::issue_stream_cmd(const uhd::stream_cmd_t& stream_cmd){
+    switch(stream_cmd.stream_mode){
+        // there is no device time to wait for, timed commands start right away at their tick
+        case uhd::stream_cmd_t::STREAM_MODE_START_CONTINUOUS:
+            if(stream_cmd.stream_now == false)
+                tick = stream_cmd.time_spec.to_ticks(samp_rate);
+            tick_start = tick;
+            t_start = std::chrono::steady_clock::now();
+            streaming = true;
+            break;
+            
+        case uhd::stream_cmd_t::STREAM_MODE_STOP_CONTINUOUS:
+            if(streaming)
+                end_of_burst_pending = true;
+            streaming = false;
+            break;
+            
+        default:
+            std::cerr << "virtual_rx_streamer: Only continuous streaming is supported." << std::endl;
+            break;
+    }
+}
+
+void virtual_rx_streamer::show_debug_information() const{
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Virtual rx streamer:" << std::endl;
+    std::cout << "source: " << source_name << std::endl;
+    std::cout << "n_channels: " << n_channels << std::endl;
+    std::cout << "n_bytes_per_item: " << n_bytes_per_item << std::endl;
+    std::cout << "samp_rate: " << samp_rate << std::endl;
+    std::cout << "max_samps: " << max_samps << std::endl;
+    std::cout << "paced: " << paced << std::endl;
+    std::cout << "n_buffer_samples: " << n_buffer_samples << std::endl;
+    std::cout << "n_samples_total: " << n_samples_total << std::endl;
+    std::cout << "n_packets: " << n_packets << std::endl;
+    std::cout << "n_overflows_injected: " << n_overflows_injected << std::endl;
+    std::cout << "n_overflows_lag: " << n_overflows_lag << std::endl;
+    std::cout << "n_samples_lost: " << n_samples_lost << std::endl;
+    std::cout << "--------------------------" << std::endl;
+}
+}
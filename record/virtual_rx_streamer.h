@@ -0,0 +1,130 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_VIRTUAL_RX_STREAMER_H
+#define CHANNELSOUNDER_VIRTUAL_RX_STREAMER_H
+
+#include <uhd/stream.hpp>
+#include <vector>
+#include <complex>
+#include <string>
+#include <atomic>
+#include <chrono>
+
+#include "buffer_allocator.h"
+
+// samples per packet of sc16 from an X310 over 10 GbE, as returned by get_max_num_samps() of its streamer
+#define VIRTUAL_RX_MAX_SAMPS            1996
+
+// lag tolerated before a paced streamer reports an overflow, about what the socket buffers of uhd hold at full rate
+#define VIRTUAL_RX_BUFFER_SEC           0.01
+
+namespace channelsounder
+{
+/*!
+ * Receive streamer without a device, to run the whole pipeline at any rate on any machine.
+ * Samples come from a synthetic sequence plus noise or from a file, both repeated endlessly, and are handed out in packets of
+ * max_samps like uhd. Paced, samples become available at samp_rate and a caller falling behind by more than the device buffer
+ * gets an overflow just like from a device, the samples in between are lost. Unpaced, samples are handed out as fast as they
+ * are received, to find the highest rate the pipeline sustains.
+ * 
+ * recv() and issue_stream_cmd() must be called from one thread, inject_overflow() from any thread.
+*/
+class virtual_rx_streamer : public uhd::rx_streamer{
+public:
+    /*!
+     * n_channels_arg               number of rx channels
+     * n_bytes_per_item_arg         size of one complex sample, 4 for sc16 and 8 for fc32
+     * samp_rate_arg                S/s
+     * max_samps_arg                maximum number of samples per packet, e.g. VIRTUAL_RX_MAX_SAMPS
+     * paced_arg                    true to follow samp_rate, false to hand out samples as fast as possible
+     * buffer_sec_arg               paced only, lag after which samples are dropped and an overflow is reported
+    */
+    virtual_rx_streamer(const size_t n_channels_arg, const size_t n_bytes_per_item_arg, const double samp_rate_arg, const size_t max_samps_arg,
+                        const bool paced_arg, const double buffer_sec_arg);
+    ~virtual_rx_streamer();
+    
+    /*!
+     * Every rx channel receives the sum of all tx channels plus independent white gaussian noise.
+     * One block of whole periods is generated here and repeated.
+     *
+     * seq                          one period of each tx channel with chips of magnitude 1, see generate_sequence_period()
+     * snr_db                       ratio of the mean power of the received sum to the noise power
+     * return                       1 on success and 0 on failure
+    */
+    int init_synthetic(const std::vector<std::vector<std::complex<float>>> &seq, const double snr_db);
+    
+    /*!
+     * Files in the layout of seq.bin (see seq_format.h) hold one period per channel, any other file is taken as raw samples,
+     * all samples of channel 0 followed by all samples of channel 1 etc., as for init_ringbuffer_tx_waveform().
+     * The file is mapped and read into memory here, so it should fit into RAM.
+     *
+     * file_name                    recording to replay
+     * return                       1 on success and 0 on failure
+    */
+    int init_replay(const std::string &file_name);
+    
+    /*!
+     * The next recv() reports an overflow and n_samples_lost samples are skipped, as after a real overflow.
+     *
+     * n_samples_lost               samples lost per channel, at least 1
+    */
+    void inject_overflow(const unsigned long long n_samples_lost);
+    
+    size_t get_num_channels() const override;
+    size_t get_max_num_samps() const override;
+    size_t recv(const buffs_type& buffs, const size_t nsamps_per_buff, uhd::rx_metadata_t& metadata, const double timeout = 0.1, const bool one_packet = false) override;
+    void issue_stream_cmd(const uhd::stream_cmd_t& stream_cmd) override;
+    
+    /*!
+     * Shows the source, the number of samples and packets handed out and the overflows.
+    */
+    void show_debug_information() const;
+    
+private:
+    size_t n_channels;
+    size_t n_bytes_per_item;
+    double samp_rate;
+    size_t max_samps;
+    bool paced;
+    unsigned long long n_buffer_samples;
+    
+    // source repeated endlessly, either generated into blocks or a mapped file
+    std::string source_name;
+    std::vector<buffer_t> blocks;
+    char* map;
+    size_t map_bytes;
+    std::vector<const char*> source;
+    unsigned long long n_source_samples;
+    
+    // stream state, the tick is the device time of the next sample
+    bool streaming;
+    bool end_of_burst_pending;
+    long long tick;
+    long long tick_start;
+    std::chrono::steady_clock::time_point t_start;
+    std::atomic<unsigned long long> n_overflow_request;
+    
+    unsigned long long n_samples_total;
+    unsigned long long n_packets;
+    unsigned long long n_overflows_injected;
+    unsigned long long n_overflows_lag;
+    unsigned long long n_samples_lost;
+};
+}
+ 
+#endif
@@ -0,0 +1,188 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "window_average.h"
+#include "cpu_features.h"
+
+// a sum of sc16 values fits into int32 up to this many windows
+#define WINDOW_AVERAGE_MAX_WINDOWS 65536
+
+namespace channelsounder
+{
+static size_t n_windows;
+static float scale;                             // 1/n_windows
+static bool use_avx2;
+static bool use_avx;
+
+// stats, fifos of all pipelines average concurrently
+static std::atomic<unsigned long long> n_averages;
+
+int init_window_average(const size_t n_windows_arg){
+    if(n_windows_arg == 0 || n_windows_arg > WINDOW_AVERAGE_MAX_WINDOWS){
+        std::cerr << "window_average: number of windows must be between 1 and " << WINDOW_AVERAGE_MAX_WINDOWS << "." << std::endl;
+        return 0;
+    }
+    n_windows = n_windows_arg;
+    scale = 1.0f/n_windows;
+
+    use_avx2 = has_cpu_feature(CPU_FEATURE_AVX2);
+    use_avx = has_cpu_feature(CPU_FEATURE_AVX);
+
+    n_averages = 0;
+
+    return 1;
+}
+
+size_t get_average_windows(){
+    return n_windows;
+}
+
+size_t get_average_window_bytes(const size_t window_length){
+    return 2*window_length*sizeof(int32_t);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 16 values per iteration, sign extended to int32
+__attribute__((target("avx2")))
+static size_t accumulate_sc16_avx2(int32_t* acc, const int16_t* p, const size_t n_values){
+    size_t i = 0;
+    for(; i + 16 <= n_values; i += 16){
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i* a = reinterpret_cast<__m256i*>(acc + i);
+        _mm256_storeu_si256(a, _mm256_add_epi32(_mm256_loadu_si256(a), _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v))));
+        _mm256_storeu_si256(a + 1, _mm256_add_epi32(_mm256_loadu_si256(a + 1), _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1))));
+    }
+    return i;
+}
+
+// 16 values per iteration, rounded to nearest and saturated, the pack works per 128 bit lane and is put back in order by the permute
+__attribute__((target("avx2")))
+static size_t finish_sc16_avx2(int32_t* acc, int16_t* p, const size_t n_values){
+    const __m256 s = _mm256_set1_ps(scale);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 16 <= n_values; i += 16){
+        __m256i* a = reinterpret_cast<__m256i*>(acc + i);
+        const __m256i lo = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(a)), s));
+        const __m256i hi = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(a + 1)), s));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8));
+        _mm256_storeu_si256(a, zero);
+        _mm256_storeu_si256(a + 1, zero);
+    }
+    return i;
+}
+
+// 8 values per instruction
+__attribute__((target("avx")))
+static size_t accumulate_fc32_avx(float* acc, const float* p, const size_t n_values){
+    size_t i = 0;
+    for(; i + 8 <= n_values; i += 8)
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_loadu_ps(p + i)));
+    return i;
+}
+
+__attribute__((target("avx")))
+static size_t finish_fc32_avx(float* acc, float* p, const size_t n_values){
+    const __m256 s = _mm256_set1_ps(scale);
+    const __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for(; i + 8 <= n_values; i += 8){
+        _mm256_storeu_ps(p + i, _mm256_mul_ps(_mm256_loadu_ps(acc + i), s));
+        _mm256_storeu_ps(acc + i, zero);
+    }
+    return i;
+}
+#endif
+
+void accumulate_window(char* acc, const char* samples, const size_t n_bytes_per_item, const size_t n_samples){
+    const size_t n_values = 2*n_samples;
+    size_t i = 0;
+
+    // remainder, or everything without avx
+    if(n_bytes_per_item == 4){
+        int32_t* a = reinterpret_cast<int32_t*>(acc);
+        const int16_t* p = reinterpret_cast<const int16_t*>(samples);
+#if defined(__x86_64__) || defined(__i386__)
+        if(use_avx2)
+            i = accumulate_sc16_avx2(a, p, n_values);
+#endif
+        for(; i < n_values; i++)
+            a[i] += p[i];
+    }
+    else{
+        float* a = reinterpret_cast<float*>(acc);
+        const float* p = reinterpret_cast<const float*>(samples);
+#if defined(__x86_64__) || defined(__i386__)
+        if(use_avx)
+            i = accumulate_fc32_avx(a, p, n_values);
+#endif
+        for(; i < n_values; i++)
+            a[i] += p[i];
+    }
+}
+
+void finish_average(char* acc, const size_t n_bytes_per_item, const size_t window_length, char* window){
+    const size_t n_values = 2*window_length;
+    size_t i = 0;
+
+    // the mean of sc16 values is within the sc16 range, no saturation needed in the remainder
+    if(n_bytes_per_item == 4){
+        int32_t* a = reinterpret_cast<int32_t*>(acc);
+        int16_t* p = reinterpret_cast<int16_t*>(window);
+#if defined(__x86_64__) || defined(__i386__)
+        if(use_avx2)
+            i = finish_sc16_avx2(a, p, n_values);
+#endif
+        for(; i < n_values; i++){
+            p[i] = (int16_t) std::lrint(a[i]*scale);
+            a[i] = 0;
+        }
+    }
+    else{
+        float* a = reinterpret_cast<float*>(acc);
+        float* p = reinterpret_cast<float*>(window);
+#if defined(__x86_64__) || defined(__i386__)
+        if(use_avx)
+            i = finish_fc32_avx(a, p, n_values);
+#endif
+        for(; i < n_values; i++){
+            p[i] = a[i]*scale;
+            a[i] = 0.0f;
+        }
+    }
+
+    n_averages++;
+}
+
+void show_debug_information_window_average(){
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Window average statistics:" << std::endl;
+    std::cout << "n_windows: " << n_windows << std::endl;
+    if(n_windows > 1){
+        std::cout << "kernel: " << (use_avx2 ? "AVX2" : "scalar") << " (sc16), " << (use_avx ? "AVX" : "scalar") << " (fc32)" << std::endl;
+        std::cout << "n_averages: " << n_averages << std::endl;
+    }
+    std::cout << "--------------------------" << std::endl;
+}
+}
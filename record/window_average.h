@@ -0,0 +1,74 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_WINDOW_AVERAGE_H
+#define CHANNELSOUNDER_WINDOW_AVERAGE_H
+
+#include <cstddef>
+
+namespace channelsounder
+{
+/*!
+ * Inits unit internally. Must be called before the first fifo is initialized.
+ * With averaging n consecutive windows are added up coherently and saved as a single measurement, so the file rate drops by n and the snr of static channels rises by n.
+ * The windows are phase aligned if the period between two measurements is a multiple of the tx sequence length.
+ *
+ * n_windows_arg                windows per saved measurement, 1 to save every window
+ * return                       1 on success and 0 on failure
+*/
+int init_window_average(const size_t n_windows_arg);
+
+/*!
+ * return                       parameter set in init_window_average()
+*/
+size_t get_average_windows();
+
+/*!
+ * Bytes of the accumulator of one window of one channel, int32 for sc16 and float for fc32, real and imag interleaved.
+ *
+ * window_length                complex samples per window
+ * return                       size of the accumulator
+*/
+size_t get_average_window_bytes(const size_t window_length);
+
+/*!
+ * Adds native samples to the accumulator, can be called for any part of a window.
+ *
+ * acc                          accumulator at the position of the first sample
+ * samples                      native samples, real and imag interleaved
+ * n_bytes_per_item             4 for sc16 and 8 for fc32
+ * n_samples                    complex samples to add
+*/
+void accumulate_window(char* acc, const char* samples, const size_t n_bytes_per_item, const size_t n_samples);
+
+/*!
+ * Writes the mean of the accumulated windows as native samples, sc16 is rounded to the nearest integer. The accumulator is cleared for the next group.
+ *
+ * acc                          accumulator of a whole window
+ * n_bytes_per_item             4 for sc16 and 8 for fc32
+ * window_length                complex samples per window
+ * window                       native samples, real and imag interleaved
+*/
+void finish_average(char* acc, const size_t n_bytes_per_item, const size_t window_length, char* window);
+
+/*!
+ * Shows some stats of the averaging, e.g. number of saved measurements.
+*/
+void show_debug_information_window_average();
+}
+
+#endif
@@ -0,0 +1,207 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "window_gate.h"
+#include "ch_measurement_format.h"
+#include "cpu_features.h"
+
+namespace channelsounder
+{
+static bool enabled;
+static float threshold_db;
+static float threshold;                         // linear power
+static size_t n_pre;
+static size_t n_post;
+static bool use_avx2;
+static bool use_avx;
+
+// stats, save threads of all pipelines select windows concurrently
+static std::atomic<unsigned long long> n_windows_total;
+static std::atomic<unsigned long long> n_windows_kept;
+static std::atomic<unsigned long long> n_triggers;
+
+static void mark(std::vector<char> &keep, const size_t begin, const size_t end);
+
+int init_window_gate(const bool enabled_arg, const float threshold_db_arg, const size_t n_pre_arg, const size_t n_post_arg){
+    if(enabled_arg && std::isfinite(threshold_db_arg) == false){
+        std::cerr << "window_gate: threshold must be a finite number of dB." << std::endl;
+        return 0;
+    }
+    enabled = enabled_arg;
+    threshold_db = threshold_db_arg;
+    threshold = std::pow(10.0f, threshold_db/10.0f);
+    n_pre = n_pre_arg;
+    n_post = n_post_arg;
+
+    use_avx2 = has_cpu_feature(CPU_FEATURE_AVX2);
+    use_avx = has_cpu_feature(CPU_FEATURE_AVX);
+
+    n_windows_total = 0;
+    n_windows_kept = 0;
+    n_triggers = 0;
+
+    return 1;
+}
+
+bool is_window_gate_enabled(){
+    return enabled;
+}
+
+float get_gate_threshold_db(){
+    return threshold_db;
+}
+
+size_t get_gate_pre(){
+    return n_pre;
+}
+
+size_t get_gate_post(){
+    return n_post;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 16 values per instruction, a pair of full scale values overflows int32 only as signed, so the pair sums are widened as unsigned
+__attribute__((target("avx2")))
+static size_t sum_squares_sc16_avx2(const int16_t* p, const size_t n_values, unsigned long long &sum){
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 16 <= n_values; i += 16){
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        const __m256i s = _mm256_madd_epi16(v, v);
+        acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(s)));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(s, 1)));
+    }
+    alignas(32) unsigned long long lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return i;
+}
+
+// 8 values per instruction, two accumulators hide the latency of the add
+__attribute__((target("avx")))
+static size_t sum_squares_fc32_avx(const float* p, const size_t n_values, double &sum){
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for(; i + 16 <= n_values; i += 16){
+        const __m256 v0 = _mm256_loadu_ps(p + i);
+        const __m256 v1 = _mm256_loadu_ps(p + i + 8);
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(v0, v0));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(v1, v1));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(acc0, acc1));
+    for(size_t j = 0; j < 8; j++)
+        sum += lanes[j];
+    return i;
+}
+#endif
+
+float window_power(const char* window, const size_t n_bytes_per_item, const size_t window_length){
+    const size_t n_values = 2*window_length;
+    size_t i = 0;
+
+    // remainder, or everything without avx
+    if(n_bytes_per_item == 4){
+        const int16_t* p = reinterpret_cast<const int16_t*>(window);
+        unsigned long long sum = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if(use_avx2)
+            i = sum_squares_sc16_avx2(p, n_values, sum);
+#endif
+        for(; i < n_values; i++)
+            sum += (unsigned long long) ((int32_t) p[i]*p[i]);
+        return (float) ((double) sum/window_length/(32768.0*32768.0));
+    }
+    else{
+        const float* p = reinterpret_cast<const float*>(window);
+        double sum = 0.0;
+#if defined(__x86_64__) || defined(__i386__)
+        if(use_avx)
+            i = sum_squares_fc32_avx(p, n_values, sum);
+#endif
+        for(; i < n_values; i++)
+            sum += p[i]*p[i];
+        return (float) (sum/window_length);
+    }
+}
+
+void select_windows(const float* power, const uint32_t* flags, const size_t n_windows,
+                    const float* power_next, const uint32_t* flags_next, const size_t n_next,
+                    size_t &n_post_left, std::vector<char> &keep){
+    keep.assign(n_windows, 0);
+    unsigned long long n_triggers_local = 0;
+
+    // context owed to the previous chunk
+    const size_t n_owed = std::min(n_post_left, n_windows);
+    mark(keep, 0, n_owed);
+    n_post_left -= n_owed;
+
+    for(size_t k = 0; k < n_windows; k++){
+        if((flags[k] & CH_MEASUREMENT_COMPLETE) == 0 || power[k] < threshold)
+            continue;
+        n_triggers_local++;
+        const size_t end = k + n_post + 1;
+        mark(keep, (k > n_pre) ? k - n_pre : 0, std::min(end, n_windows));
+        if(end > n_windows)
+            n_post_left = std::max(n_post_left, end - n_windows);
+    }
+
+    // triggers at the start of the next chunk
+    if(power_next != nullptr){
+        for(size_t j = 0; j < std::min(n_next, n_pre); j++){
+            if((flags_next[j] & CH_MEASUREMENT_COMPLETE) == 0 || power_next[j] < threshold)
+                continue;
+            mark(keep, (n_windows + j > n_pre) ? n_windows + j - n_pre : 0, n_windows);
+        }
+    }
+
+    n_windows_total += n_windows;
+    n_windows_kept += std::count(keep.begin(), keep.end(), 1);
+    n_triggers += n_triggers_local;
+}
+
+void show_debug_information_window_gate(){
+    std::cout << "--------------------------" << std::endl;
+    std::cout << "Window gate statistics:" << std::endl;
+    std::cout << "enabled: " << enabled << std::endl;
+    if(enabled){
+        std::cout << "threshold_db: " << threshold_db << std::endl;
+        std::cout << "n_pre: " << n_pre << std::endl;
+        std::cout << "n_post: " << n_post << std::endl;
+        std::cout << "power kernel: " << (use_avx2 ? "AVX2" : "scalar") << " (sc16), " << (use_avx ? "AVX" : "scalar") << " (fc32)" << std::endl;
+        std::cout << "n_windows_total: " << n_windows_total << std::endl;
+        std::cout << "n_windows_kept: " << n_windows_kept << std::endl;
+        std::cout << "n_triggers: " << n_triggers << std::endl;
+        if(n_windows_total > 0)
+            std::cout << "fraction kept: " << (double) n_windows_kept/n_windows_total << std::endl;
+    }
+    std::cout << "--------------------------" << std::endl;
+}
+
+static void mark(std::vector<char> &keep, const size_t begin, const size_t end){
+    for(size_t k = begin; k < end; k++)
+        keep[k] = 1;
+}
+}
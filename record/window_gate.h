@@ -0,0 +1,79 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHANNELSOUNDER_WINDOW_GATE_H
+#define CHANNELSOUNDER_WINDOW_GATE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace channelsounder
+{
+/*!
+ * Inits unit internally. Must be called before the first fifo is initialized.
+ * With the gate only windows around a trigger are saved, all other windows are marked CH_MEASUREMENT_DISCARDED and left out of the file.
+ *
+ * enabled_arg                  false to save every window
+ * threshold_db_arg             a complete window is a trigger if its power averaged over all channels is at least this, in dB relative to full scale
+ * n_pre_arg                    windows saved before each trigger
+ * n_post_arg                   windows saved after each trigger
+ * return                       1 on success and 0 on failure
+*/
+int init_window_gate(const bool enabled_arg, const float threshold_db_arg, const size_t n_pre_arg, const size_t n_post_arg);
+
+/*!
+ * return                       parameters set in init_window_gate()
+*/
+bool is_window_gate_enabled();
+float get_gate_threshold_db();
+size_t get_gate_pre();
+size_t get_gate_post();
+
+/*!
+ * Mean power of one window of native samples, a complex sample of magnitude full scale (32768 for sc16 and 1 for fc32) has power 1.
+ *
+ * window                       samples of one channel, real and imag interleaved
+ * n_bytes_per_item             4 for sc16 and 8 for fc32
+ * window_length                complex samples per window
+ * return                       mean of real^2 + imag^2 relative to full scale
+*/
+float window_power(const char* window, const size_t n_bytes_per_item, const size_t window_length);
+
+/*!
+ * Selects the windows of a chunk to be saved, each trigger keeps n_pre windows before and n_post windows after itself.
+ *
+ * power                        power of each window, see window_power()
+ * flags                        flags of each window, incomplete windows never trigger
+ * n_windows                    number of windows in the chunk
+ * power_next                   windows directly following the chunk, their triggers reach back into it, nullptr if unknown
+ * flags_next                   "
+ * n_next                       "
+ * n_post_left                  windows owed to triggers of the previous chunk, 0 if the previous chunk does not directly precede this one, updated for the next chunk
+ * keep                         set to n_windows entries, 1 for windows to be saved
+*/
+void select_windows(const float* power, const uint32_t* flags, const size_t n_windows,
+                    const float* power_next, const uint32_t* flags_next, const size_t n_next,
+                    size_t &n_post_left, std::vector<char> &keep);
+
+/*!
+ * Shows some stats of the gate, e.g. fraction of windows kept.
+*/
+void show_debug_information_window_gate();
+}
+
+#endif
@@ -0,0 +1,96 @@
+/*
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "window_gate.h"
+#include "ch_measurement_format.h"
+
+/***********************************************************************
+ * select_windows() on consecutive chunks must keep the same windows as
+ * a direct search for triggers over the whole recording: window i is
+ * kept if a complete window j >= i - n_post and j <= i + n_pre is a
+ * trigger. Chunks are at least n_pre windows long, as the fifo requires.
+ **********************************************************************/
+#define N_WINDOWS               2000
+#define TRIGGER_PROBABILITY     0.02
+#define INCOMPLETE_PROBABILITY  0.05
+
+static int check(const size_t n_pre, const size_t n_post, std::mt19937 &gen){
+    if (not channelsounder::init_window_gate(true, 0.0f, n_pre, n_post)) {
+        return 0;
+    }
+
+    // triggers are above 0 dB full scale, incomplete windows never trigger, even above the threshold
+    std::bernoulli_distribution trigger(TRIGGER_PROBABILITY), incomplete(INCOMPLETE_PROBABILITY);
+    std::vector<float> power(N_WINDOWS);
+    std::vector<uint32_t> flags(N_WINDOWS);
+    for(size_t k = 0; k < N_WINDOWS; k++){
+        power[k] = trigger(gen) ? 2.0f : 0.5f;
+        flags[k] = incomplete(gen) ? 0 : CH_MEASUREMENT_COMPLETE;
+    }
+
+    std::vector<char> expected(N_WINDOWS, 0);
+    for(size_t j = 0; j < N_WINDOWS; j++){
+        if(power[j] < 1.0f || flags[j] == 0)
+            continue;
+        for(size_t i = (j > n_pre) ? j - n_pre : 0; i <= std::min<size_t>(j + n_post, N_WINDOWS - 1); i++)
+            expected[i] = 1;
+    }
+
+    // chunks of random length, each sees the following chunk as look-ahead
+    std::uniform_int_distribution<size_t> chunk_length(std::max<size_t>(n_pre, 1), 3*n_pre + 5);
+    std::vector<size_t> starts(1, 0);
+    while(starts.back() < N_WINDOWS)
+        starts.push_back(std::min<size_t>(starts.back() + chunk_length(gen), N_WINDOWS));
+
+    std::vector<char> kept, keep;
+    size_t n_post_left = 0;
+    for(size_t c = 0; c + 1 < starts.size(); c++){
+        const size_t begin = starts[c];
+        const size_t n = starts[c + 1] - begin;
+        const size_t n_next = (c + 2 < starts.size()) ? starts[c + 2] - starts[c + 1] : 0;
+        channelsounder::select_windows(&power[begin], &flags[begin], n,
+                                       (n_next > 0) ? &power[begin + n] : nullptr, (n_next > 0) ? &flags[begin + n] : nullptr, n_next,
+                                       n_post_left, keep);
+        kept.insert(kept.end(), keep.begin(), keep.end());
+    }
+
+    if(kept != expected){
+        const size_t k = std::mismatch(kept.begin(), kept.end(), expected.begin()).first - kept.begin();
+        std::cerr << "n_pre " << n_pre << ", n_post " << n_post << ": window " << k << " is " << (kept[k] ? "kept" : "dropped")
+                  << " but should be " << (expected[k] ? "kept" : "dropped") << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+int main()
+{
+    std::mt19937 gen(1);
+    const size_t context[][2] = {{0, 0}, {1, 0}, {0, 1}, {3, 7}, {10, 10}, {25, 4}, {4, 60}};
+    for(size_t i = 0; i < sizeof(context)/sizeof(context[0]); i++){
+        if (not check(context[i][0], context[i][1], gen)) {
+            std::cerr << "FAILED" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "window gate keeps the same windows in chunks as over the whole recording" << std::endl;
+    return 0;
+}